@@ -1,10 +1,27 @@
 #include "ESP8266WiFi.h"
 
-#define MAX_SSID_LENGTH 32
-#define MAX_PASSWORD_LENGTH 64
-#define TMP_SEND_TX_BUFFER_LENGTH 20
-#define TMP_CONNECT_TX_BUFFER_LENGTH 200
-#define SOFT_AP_CLIENT_INFO_TOKEN_MAX_LENGTH (IP_ADDRESS_LENGTH + MAC_ADDRESS_LENGTH + 1)   // + 1 for line end
+#define MAX_SSID_LENGTH ESP8266_SSID_MAX_LENGTH
+#define MAX_PASSWORD_LENGTH ESP8266_PASSWORD_MAX_LENGTH
+#define MAX_SEND_DATA_LENGTH 2048   // AT+CIPSEND limit for normal transfer mode
+#define TRANSPARENT_PACKET_LENGTH 2048      // module sends packet when 2048 bytes received, or after ESP8266_TRANSPARENT_PACKET_GAP_MS silence
+#define TRANSPARENT_EXIT_SEQUENCE "+++"
+
+#define TRACE_MAGIC "ESPT"
+#define TRACE_FORMAT_VERSION 1
+#define TRACE_RECORD_HEADER_LENGTH 7    // u32 timestamp, u8 direction, u16 length, little endian
+#define TRACE_MAX_RECORD_LENGTH ((ESP8266_TRACE_BUFFER_SIZE / 2) - TRACE_RECORD_HEADER_LENGTH)
+
+#if defined(ESP8266_ENABLE_METRICS)
+#define METRICS_INCREMENT(wifi, counter) ((wifi)->metrics.counter++)
+#define METRICS_ADD(wifi, counter, value) ((wifi)->metrics.counter += (value))
+#define METRICS_START_SEND(wifi) ((wifi)->metrics.sendStartCycles = DWT->CYCCNT)
+#define METRICS_FINISH_SEND(wifi) recordSendLatency(wifi)
+#else   // compiled out, no cost
+#define METRICS_INCREMENT(wifi, counter)
+#define METRICS_ADD(wifi, counter, value)
+#define METRICS_START_SEND(wifi)
+#define METRICS_FINISH_SEND(wifi)
+#endif
 
 #define OK_STATUS            "\r\nOK\r\n"
 #define SEND_OK_STATUS       "\r\nSEND OK\r\n"
@@ -12,22 +29,266 @@
 #define CLOSED_STATUS        "CLOSED\r\n"
 #define ERROR_STATUS         "\r\nERROR\r\n"
 #define FAIL_STATUS          "\r\nFAIL\r\n"
+#define SEND_FAIL_STATUS     "SEND FAIL\r\n"
+#define BUSY_STATUS          "busy "     // "busy s..." or "busy p...", command is ignored
 #define NEW_LINE             "\r\n"
 
-static enum AccessPointParameter {
-    SECURITY, SSID, SIGNAL_STRENGTH
-} APParameter;
-
-static USART_DMA *USARTDmaPointer = NULL;
+#define RESPONSE_PATTERN_MAX_LENGTH 11
+#define PATTERN_BIT(pattern) (1U << (pattern))
+#define COMMAND_SUCCESS_PATTERNS (PATTERN_BIT(OK_PATTERN) | PATTERN_BIT(SEND_OK_PATTERN) | PATTERN_BIT(SEND_PROMPT_PATTERN))
+#define ERROR_PATTERNS           (PATTERN_BIT(ERROR_PATTERN) | PATTERN_BIT(FAIL_PATTERN))
+#define SEND_RETRY_PATTERNS      (PATTERN_BIT(SEND_FAIL_PATTERN) | PATTERN_BIT(BUSY_PATTERN))  // end chunk sends only, "busy p..." is followed by final status
+#define DATA_RECEIVED_STATUS_LENGTH 5
+#define OVERFLOW_KEPT_LENGTH(response) (((response)->bufferSize - 1) / 2)    // text head kept when response doesn't fit RX buffer
+#define SCAN_LINE_PREFIX_VALUE "+CWLAP:("
+#define SCAN_LINE_PREFIX_LENGTH 8
+#define JOINED_ACCESS_POINT_PREFIX "+CWJAP_CUR:\""
+#define NO_KNOWN_NETWORK -1
+#define NO_SERVER_CONNECTION -1
+#define SCAN_OUTPUT_MASK 0x1F     // encryption, ssid, signal strength, bssid, channel
+
+typedef enum ResponsePatternType {
+    OK_PATTERN,
+    SEND_OK_PATTERN,
+    SEND_PROMPT_PATTERN,
+    CLOSED_PATTERN,
+    ERROR_PATTERN,
+    FAIL_PATTERN,
+    SEND_FAIL_PATTERN,
+    BUSY_PATTERN
+} ResponsePatternType;
+
+typedef struct ResponsePattern {
+    const char *value;
+    uint8_t length;
+    uint8_t failure[RESPONSE_PATTERN_MAX_LENGTH];   // KMP failure function: longest proper border of each pattern prefix
+} ResponsePattern;
+
+static const ResponsePattern RESPONSE_PATTERNS[ESP8266_RESPONSE_PATTERN_COUNT] = {
+        [OK_PATTERN]            = {OK_STATUS,            6,  {0, 0, 0, 0, 1, 2}},
+        [SEND_OK_PATTERN]       = {SEND_OK_STATUS,       11, {0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2}},
+        [SEND_PROMPT_PATTERN]   = {">",                  1,  {0}},
+        [CLOSED_PATTERN]        = {CLOSED_STATUS,        8,  {0}},
+        [ERROR_PATTERN]         = {ERROR_STATUS,         9,  {0, 0, 0, 0, 0, 0, 0, 1, 2}},
+        [FAIL_PATTERN]          = {FAIL_STATUS,          8,  {0, 0, 0, 0, 0, 0, 1, 2}},
+        [SEND_FAIL_PATTERN]     = {SEND_FAIL_STATUS,     11, {0}},
+        [BUSY_PATTERN]          = {BUSY_STATUS,          5,  {0}},
+};
+
+typedef enum ATCommandType {
+    AT_HEALTH_CHECK,
+    AT_ECHO_OFF,
+    AT_RESTART,
+    AT_RESTORE,
+    AT_WIFI_MODE,
+    AT_CONNECTION_MODE,
+    AT_TRANSFER_MODE,
+    AT_DEEP_SLEEP,
+    AT_SLEEP,
+    AT_SCAN,
+    AT_SCAN_OPTIONS,
+    AT_JOIN_CURRENT,
+    AT_JOIN_DEFAULT,
+    AT_JOIN_QUERY,
+    AT_QUIT_ACCESS_POINT,
+    AT_CONNECTION_STATUS,
+    AT_SOCKET_START,
+    AT_SOCKET_SEND,
+    AT_SOCKET_CLOSE,
+    AT_SSL_BUFFER_SIZE,
+    AT_SERVER,
+    AT_SERVER_TIMEOUT,
+    AT_LOCAL_INFO,
+    AT_SOFT_AP_QUERY,
+    AT_SOFT_AP_CURRENT,
+    AT_SOFT_AP_DEFAULT,
+    AT_SOFT_AP_CLIENTS,
+    AT_SOFT_AP_IP,
+    AT_PING,
+    AT_COMMAND_COUNT
+} ATCommandType;
+
+typedef struct ATCommandDescriptor {
+    const char *value;  // command name, "=" and "," are added by argument emitters
+    uint8_t length;
+} ATCommandDescriptor;
+
+#define AT_COMMAND(value) {value, sizeof(value) - 1}
+
+static const ATCommandDescriptor AT_COMMANDS[AT_COMMAND_COUNT] = {
+        [AT_HEALTH_CHECK]       = AT_COMMAND("AT"),
+        [AT_ECHO_OFF]           = AT_COMMAND("ATE0"),
+        [AT_RESTART]            = AT_COMMAND("AT+RST"),
+        [AT_RESTORE]            = AT_COMMAND("AT+RESTORE"),
+        [AT_WIFI_MODE]          = AT_COMMAND("AT+CWMODE"),
+        [AT_CONNECTION_MODE]    = AT_COMMAND("AT+CIPMUX"),
+        [AT_TRANSFER_MODE]      = AT_COMMAND("AT+CIPMODE"),
+        [AT_DEEP_SLEEP]         = AT_COMMAND("AT+GSLP"),
+        [AT_SLEEP]              = AT_COMMAND("AT+SLEEP"),
+        [AT_SCAN]               = AT_COMMAND("AT+CWLAP"),
+        [AT_SCAN_OPTIONS]       = AT_COMMAND("AT+CWLAPOPT"),
+        [AT_JOIN_CURRENT]       = AT_COMMAND("AT+CWJAP_CUR"),
+        [AT_JOIN_DEFAULT]       = AT_COMMAND("AT+CWJAP_DEF"),
+        [AT_JOIN_QUERY]         = AT_COMMAND("AT+CWJAP_CUR?"),
+        [AT_QUIT_ACCESS_POINT]  = AT_COMMAND("AT+CWQAP"),
+        [AT_CONNECTION_STATUS]  = AT_COMMAND("AT+CIPSTATUS"),
+        [AT_SOCKET_START]       = AT_COMMAND("AT+CIPSTART"),
+        [AT_SOCKET_SEND]        = AT_COMMAND("AT+CIPSEND"),
+        [AT_SOCKET_CLOSE]       = AT_COMMAND("AT+CIPCLOSE"),
+        [AT_SSL_BUFFER_SIZE]    = AT_COMMAND("AT+CIPSSLSIZE"),
+        [AT_SERVER]             = AT_COMMAND("AT+CIPSERVER"),
+        [AT_SERVER_TIMEOUT]     = AT_COMMAND("AT+CIPSTO"),
+        [AT_LOCAL_INFO]         = AT_COMMAND("AT+CIFSR"),
+        [AT_SOFT_AP_QUERY]      = AT_COMMAND("AT+CWSAP?"),
+        [AT_SOFT_AP_CURRENT]    = AT_COMMAND("AT+CWSAP_CUR"),
+        [AT_SOFT_AP_DEFAULT]    = AT_COMMAND("AT+CWSAP_DEF"),
+        [AT_SOFT_AP_CLIENTS]    = AT_COMMAND("AT+CWLIF"),
+        [AT_SOFT_AP_IP]         = AT_COMMAND("AT+CIPAP"),
+        [AT_PING]               = AT_COMMAND("AT+PING"),
+};
+
+typedef struct CommandBuilder {     // bounded command writer, formats straight into DMA or queue slot buffer
+    char *buffer;
+    uint32_t capacity;      // without line end
+    uint32_t length;
+    uint8_t argumentCount;
+    bool isOverflow;
+} CommandBuilder;
+
+typedef struct NextChunk {  // double buffered producer payload
+    PayloadProducer producer;
+    void *context;
+    char *buffer;
+    uint32_t capacity;
+    uint32_t length;
+    bool isProduced;
+} NextChunk;
+
+typedef enum AccessPointParameter {
+    SECURITY, SSID, SIGNAL_STRENGTH, BSSID, CHANNEL
+} AccessPointParameter;
+
+extern inline bool isResponseStatusWaiting(ResponseStatus status);   // external definitions of header inline helpers, for calls that are not inlined
+extern inline bool isResponseStatusSuccess(ResponseStatus status);
+extern inline bool isResponseStatusError(ResponseStatus status);
+extern inline bool isResponseStatusTimeout(ResponseStatus status);
 
 static inline bool isSsidValid(char *ssid);
 static inline bool isPasswordValid(char *password);
 
-static void sendATCommand(WiFi *wifi, const char *ATCommandPattern, ...);
-static bool isResponseOK(char *responseBody, bool isServerResponse);
-static bool isResponseError(char *responseBody);
-static void setDMATransmitBufferAddress(USART_DMA *USARTDmaInstance, char *bufferPointer, uint32_t bufferSize);
-static void parseToAP(AccessPoint *accessPoint, char *buffer);
+static void setupWifiInstance(WiFi *wifiInstance);
+static void switchInitPhase(WiFi *wifi, InitPhase nextPhase, uint32_t currentMillis);
+static void sendInitCommand(WiFi *wifi, InitPhase phase);
+static CommandBuilder startATCommand(WiFi *wifi, ATCommandType type);
+static void sendATCommand(WiFi *wifi, CommandBuilder *command);
+static void sendPlainCommand(WiFi *wifi, ATCommandType type);
+static void sendNumberCommand(WiFi *wifi, ATCommandType type, uint32_t value);
+static void sendPayloadLength(WiFi *wifi, ConnectionID id, uint32_t length, bool isConnectionIdRequired);
+static CommandBuilder startQueuedCommand(WiFi *wifi, ATCommandType type);
+static bool enqueueATCommand(WiFi *wifi, CommandBuilder *command, CommandCallback callback, void *context);
+static bool commitQueuedCommand(WiFi *wifi, uint32_t length, CommandCallback callback, void *context);
+static CommandBuilder beginCommand(char *buffer, uint32_t capacity, ATCommandType type);
+static uint32_t finishCommand(CommandBuilder *command);
+static void appendSymbol(CommandBuilder *command, char symbol);
+static void appendSeparator(CommandBuilder *command);
+static void appendNumber(CommandBuilder *command, uint32_t value);
+static void appendQuoted(CommandBuilder *command, const char *value);
+static void appendSocketStart(CommandBuilder *command, WiFi *wifi, ConnectionID id, const SocketConfig *config);
+static void transmitATCommand(WiFi *wifi, char *command, uint32_t length);
+static void transmitQueuedCommand(WiFi *wifi);
+static void clearResponseESP8266(WiFi *wifi);
+static void startReceiveESP8266(WiFi *wifi);
+static void resetResponseMatcher(ResponseData *response);
+static ResponseStatus scanResponseESP8266(WiFi *wifi);
+static bool processReceivedSymbol(WiFi *wifi, char symbol);
+static void feedResponseMatcher(ResponseMatcher *matcher, char symbol);
+static bool feedIPDFramer(WiFi *wifi, char symbol);
+static void pushToReceiveQueue(ReceiveQueue *queue, char symbol);
+static void feedUrcLine(WiFi *wifi, char symbol);
+static void parseUrcLine(WiFi *wifi, const char *line, uint8_t length);
+static void dispatchUrc(WiFi *wifi, UrcType type, ConnectionID id, uint32_t dataLength);
+static void processPendingData(WiFi *wifi);
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+static void startRxRing(WiFi *wifi);
+static void updateRxRingHead(RxRing *ring, uint32_t position);
+static void consumeRxRing(WiFi *wifi);
+#endif
+static void transmitData(WiFi *wifi, char *data, uint32_t length);
+static void waitForTransmitComplete(WiFi *wifi);
+#if !defined(ESP8266_RX_CIRCULAR_MODE)
+static void armReceiveESP8266(WiFi *wifi, uint32_t offset);
+static void continueReceiveESP8266(WiFi *wifi);
+static uint32_t getReceivedLength(WiFi *wifi);
+#endif
+static ResponseStatus sendRequestData(WiFi *wifi, ConnectionID id, bool isConnectionIdRequired);
+static ResponseStatus transmitSegments(WiFi *wifi, ConnectionID id, const SendSegment *segments, uint8_t segmentCount, bool isServerResponseAwaited);
+static void transmitPayload(WiFi *wifi, const SendSegment *segments, uint8_t segmentCount, bool isServerResponseAwaited);
+static void completePendingSend(WiFi *wifi);
+static ResponseStatus sendChunk(WiFi *wifi, ConnectionID id, const char *data, uint32_t length, StreamSendReport *report, NextChunk *next);
+static ResponseStatus startChunk(WiFi *wifi, ConnectionID id, const char *data, uint32_t length, NextChunk *next);
+static ResponseStatus waitForChunkStatus(WiFi *wifi);
+static ResponseStatus waitForBusyRetry(WiFi *wifi, NextChunk *next, uint32_t retryAtMillis);
+static void produceNextChunk(NextChunk *next);
+static void finishSendReport(StreamSendReport *report, uint32_t startMillis);
+static void onServerSendPrompt(WiFi *wifi, ResponseStatus status, void *context);
+static void completeServerChunk(WiFi *wifi);
+static void startServerChunk(WiFi *wifi);
+static void abortServerChunk(WiFi *wifi);
+static APConnectionStatus getJoinStatus(WiFi *wifi, ResponseStatus status);
+static APConnectionStatus joinKnownNetwork(WiFi *wifi, KnownNetwork *network, bool isBssidRequired);
+static void cacheJoinedAccessPoint(WiFi *wifi, int8_t networkIndex);
+static bool parseJoinedAccessPoint(WiFi *wifi, int8_t networkIndex);
+static ScanAction updateKnownNetwork(WiFi *wifi, const AccessPoint *accessPoint, void *context);
+static int8_t findNextCandidate(KnownNetworkTable *table, bool *isTried);
+static uint8_t getSignalRank(int8_t signalStrength);
+static void parseSoftApClients(const char *responseBody, SoftApClientTable *table);
+static void copyQuotedValue(const char *responseBody, const char *prefix, char *value, uint32_t maxLength);
+static void diffSoftApClients(SoftApClientTable *table, const SoftAPClient *previousClients, uint8_t previousSize);
+static inline bool isSameSoftApClient(const SoftAPClient *client, const SoftAPClient *otherClient);
+static void startSupervisedJoin(WiFi *wifi, uint32_t currentMillis);
+static void startWakeWindow(WiFi *wifi);
+static void advanceWakeWindow(WiFi *wifi);
+static void finishWakeWindow(WiFi *wifi);
+static void enqueuePowerSend(WiFi *wifi);
+static void completePowerSend(WiFi *wifi);
+static bool enqueuePowerSleepMode(WiFi *wifi, SleepMode mode, CommandCallback callback);
+static void onPowerCommand(WiFi *wifi, ResponseStatus status, void *context);
+static void onPowerSslBuffer(WiFi *wifi, ResponseStatus status, void *context);
+static void onPowerConnect(WiFi *wifi, ResponseStatus status, void *context);
+static void onPowerSendPrompt(WiFi *wifi, ResponseStatus status, void *context);
+static void onPowerClose(WiFi *wifi, ResponseStatus status, void *context);
+static void onPowerSleep(WiFi *wifi, ResponseStatus status, void *context);
+static bool isLinkWorthKeeping(PowerScheduler *power);
+static void accountPowerState(WiFi *wifi, uint32_t currentMillis);
+static void startPingProbe(WiFi *wifi, uint32_t currentMillis);
+static void onPingProbe(WiFi *wifi, ResponseStatus status, void *context);
+static void recordPingSample(PingEngine *engine, int32_t roundTripMillis);
+static int32_t parsePingTime(const char *responseBody);
+static void startSupervisedEndpoint(WiFi *wifi, uint32_t currentMillis);
+static void onSupervisedJoin(WiFi *wifi, ResponseStatus status, void *context);
+static void onSupervisedJoinQuery(WiFi *wifi, ResponseStatus status, void *context);
+static bool enqueueSupervisedSocketStart(WiFi *wifi, SupervisedEndpoint *endpoint);
+static void onSupervisedSslBuffer(WiFi *wifi, ResponseStatus status, void *context);
+static void onSupervisedEndpoint(WiFi *wifi, ResponseStatus status, void *context);
+static void delaySupervisedEndpoint(LinkSupervisor *supervisor, SupervisedEndpoint *endpoint);
+static uint32_t getBackoffDelay(LinkSupervisor *supervisor, uint8_t attempt);
+static void feedScanParser(WiFi *wifi, char symbol);
+static void appendScanValue(ScanParser *parser, char symbol);
+static void commitScanField(ScanParser *parser);
+static void commitAccessPoint(WiFi *wifi);
+static ResponseStatus pollResponse(WiFi *wifi);
+static ResponseStatus getMatcherStatus(ResponseData *response);
+#if defined(ESP8266_ENABLE_TRACE)
+static void traceRecord(WiFi *wifi, TraceDirection direction, const char *data, uint32_t length);
+static void traceWrite(TraceRing *trace, uint32_t *position, const uint8_t *data, uint32_t length);
+static uint8_t traceReadByte(TraceRing *trace, uint32_t position);
+#endif
+#if defined(ESP8266_ENABLE_METRICS)
+static void recordCommandStart(WiFi *wifi, const char *command);
+static void recordResponseMetrics(WiFi *wifi, ResponseStatus status);
+static void recordRxLevel(WiFi *wifi, uint32_t pendingLength);
+static void recordSendLatency(WiFi *wifi);
+#endif
 
 
 WiFi *initWifiESP8266(USART_TypeDef *USARTx,
@@ -36,64 +297,204 @@ WiFi *initWifiESP8266(USART_TypeDef *USARTx,
                       uint32_t txStream,
                       uint32_t rxBufferSize,
                       uint32_t txBufferSize) {
-    USARTDmaPointer = initUSART_DMA(USARTx, DMAx, rxStream, txStream, rxBufferSize, txBufferSize);
-    ResponseData *response = malloc(sizeof(struct ResponseData));
-    RequestData *request = malloc(sizeof(struct RequestData));
-    WiFi *wifiInstance = malloc(sizeof(struct WiFi));
+    WiFi *wifiInstance = createWifiESP8266(USARTx, DMAx, rxStream, txStream, rxBufferSize, txBufferSize);
+    if (wifiInstance == NULL) return NULL;
+
+    InitPhase phase;
+    do {
+        phase = initStepESP8266(wifiInstance);
+    } while (phase != ESP8266_INIT_READY && phase != ESP8266_INIT_FAILED);
 
-    if (USARTDmaPointer == NULL || response == NULL || request == NULL || wifiInstance == NULL) {
+    if (phase == ESP8266_INIT_FAILED) {
         deleteESP8266(wifiInstance);
         return NULL;
     }
+    return wifiInstance;
+}
+
+WiFi *createWifiESP8266(USART_TypeDef *USARTx,
+                        DMA_TypeDef *DMAx,
+                        uint32_t rxStream,
+                        uint32_t txStream,
+                        uint32_t rxBufferSize,
+                        uint32_t txBufferSize) {
+    USART_DMA *USARTDma = initUSART_DMA(USARTx, DMAx, rxStream, txStream, rxBufferSize, txBufferSize);
+    ResponseData *response = ESP8266_MALLOC(sizeof(struct ResponseData));
+    RequestData *request = ESP8266_MALLOC(sizeof(struct RequestData));
+    WiFi *wifiInstance = ESP8266_MALLOC(sizeof(struct WiFi));
+
+    if (USARTDma == NULL || response == NULL || request == NULL || wifiInstance == NULL) {
+        if (USARTDma != NULL) {
+            deleteUSART_DMA(USARTDma);
+        }
+        ESP8266_FREE(response);
+        ESP8266_FREE(request);
+        ESP8266_FREE(wifiInstance);
+        return NULL;
+    }
+    wifiInstance->USARTDma = USARTDma;
     wifiInstance->response = response;
     wifiInstance->request = request;
+    wifiInstance->isStaticallyAllocated = false;
+    setupWifiInstance(wifiInstance);
+    return wifiInstance;
+}
 
-    wifiInstance->request->id = CONNECTION_ID_0;
-    wifiInstance->request->dataLength = 0;
-    wifiInstance->request->requestBody = USARTDmaPointer->txData->bufferPointer;
-    wifiInstance->request->bufferSize = USARTDmaPointer->txData->bufferSize;
+WiFi *initStaticWifiESP8266(WiFiStaticStorage *storage, USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream) {
+    WiFi *wifiInstance = createStaticWifiESP8266(storage, USARTx, DMAx, rxStream, txStream);
+    if (wifiInstance == NULL) return NULL;
 
-    wifiInstance->response->startTimeMillis = 0;
-    wifiInstance->response->isServerResponseAwaited = false;
-    wifiInstance->response->timeout = ESP8266_RESPONSE_DEFAULT_TIMEOUT_MS;
-    wifiInstance->response->responseBody = USARTDmaPointer->rxData->bufferPointer;
-    wifiInstance->response->bufferSize = USARTDmaPointer->rxData->bufferSize;
+    InitPhase phase;
+    do {
+        phase = initStepESP8266(wifiInstance);
+    } while (phase != ESP8266_INIT_READY && phase != ESP8266_INIT_FAILED);
+    return (phase == ESP8266_INIT_READY) ? wifiInstance : NULL;
+}
 
-    wifiInstance->isNeedToSaveCredentials = false;
-    wifiInstance->connectionMode = ESP8266_CONNECTION_SINGLE;
-    dwtDelayInit();
+WiFi *createStaticWifiESP8266(WiFiStaticStorage *storage, USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream) {
+    if (storage == NULL || USARTx == NULL || DMAx == NULL) return NULL;
+
+    memset(storage, 0, sizeof(struct WiFiStaticStorage));
+    storage->rxData = (USART_DMA_Data) {.stream = rxStream, .bufferPointer = storage->rxBuffer, .bufferSize = ESP8266_STATIC_RX_BUFFER_SIZE};
+    storage->txData = (USART_DMA_Data) {.stream = txStream, .bufferPointer = storage->txBuffer, .bufferSize = ESP8266_STATIC_TX_BUFFER_SIZE};
+    initStaticUSART_DMA(&storage->USARTDma, USARTx, DMAx, &storage->rxData, &storage->txData);   // registered for interrupt callbacks like heap transport
+    WiFi *wifiInstance = &storage->wifi;
+    wifiInstance->USARTDma = &storage->USARTDma;
+    wifiInstance->request = &storage->request;
+    wifiInstance->response = &storage->response;
+    wifiInstance->isStaticallyAllocated = true;
+    setupWifiInstance(wifiInstance);
+    return wifiInstance;
+}
 
-    delay_ms(100); // initial delay, waiting module startup
+void getMemoryFootprintESP8266(MemoryFootprint *footprint) {
+    memset(footprint, 0, sizeof(struct MemoryFootprint));
+    footprint->receiveQueues = sizeof(((WiFi *) 0)->receiveQueue);
+    footprint->commandQueue = sizeof(struct CommandQueue);
+    footprint->commandLane = sizeof(((WiFi *) 0)->commandLane);
+    footprint->urcDispatcher = sizeof(struct UrcDispatcher);
+    footprint->server = sizeof(struct ServerState);
+    footprint->knownNetworks = sizeof(struct KnownNetworkTable);
+    footprint->softApClients = sizeof(struct SoftApClientTable);
+    footprint->supervisor = sizeof(struct LinkSupervisor);
+    footprint->ping = sizeof(struct PingEngine);
+    footprint->power = sizeof(struct PowerScheduler);
+#if defined(ESP8266_ENABLE_METRICS)
+    footprint->metrics = sizeof(struct WiFiMetrics);
+#endif
+#if defined(ESP8266_ENABLE_TRACE)
+    footprint->trace = sizeof(struct TraceRing);
+#endif
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    footprint->rxRing = sizeof(struct RxRing);
+#endif
+    footprint->dmaBuffers = ESP8266_STATIC_RX_BUFFER_SIZE + ESP8266_STATIC_TX_BUFFER_SIZE;
+    footprint->staticStorage = sizeof(struct WiFiStaticStorage);
+    footprint->controlBlock = footprint->staticStorage - footprint->dmaBuffers - footprint->receiveQueues - footprint->commandQueue - footprint->commandLane
+                              - footprint->urcDispatcher - footprint->server - footprint->knownNetworks - footprint->softApClients
+                              - footprint->supervisor - footprint->ping - footprint->power - footprint->metrics - footprint->trace
+                              - footprint->rxRing;
+}
 
-    ResponseStatus status;
-    for (uint8_t i = 0; i < ESP8266_KEEPALIVE_ATTEMPT_COUNT; i++) {
-        status = healthCheckESP8266(wifiInstance);
-        if (isResponseStatusSuccess(status)) {
-            break;
-        }
-    }
+#if defined(ESP8266_ENABLE_METRICS)
+void getMetricsESP8266(WiFi *wifi, WiFiMetrics *snapshot) {
+    memcpy(snapshot, &wifi->metrics, sizeof(struct WiFiMetrics));
+}
 
-    if (isResponseStatusSuccess(status)) {
-        sendATCommand(wifiInstance, "ATE0");  // Disable echo (don’t send back received command)
-        status = waitForResponseESP8266(wifiInstance);
+void resetMetricsESP8266(WiFi *wifi) {
+    memset(&wifi->metrics, 0, sizeof(struct WiFiMetrics));
+    wifi->metrics.isCommandMeasured = true;    // command in flight, if any, started before reset
+}
+#endif
+
+#if defined(ESP8266_ENABLE_TRACE)
+void dumpTraceESP8266(WiFi *wifi, TraceWriter writer, void *context) {
+    TraceRing *trace = &wifi->trace;
+    uint32_t head = trace->head;    // records written after snapshot are not dumped
+    uint32_t tail = trace->tail;
+    uint32_t cyclesPerSecond = SystemCoreClock;
+    uint8_t header[] = {
+            TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3], TRACE_FORMAT_VERSION,
+            cyclesPerSecond, cyclesPerSecond >> 8, cyclesPerSecond >> 16, cyclesPerSecond >> 24    // timestamp resolution
+    };
+    writer((const char *) header, sizeof(header), context);
+
+    if (head < tail) {
+        writer(&trace->buffer[tail], ESP8266_TRACE_BUFFER_SIZE - tail, context);
+        writer(trace->buffer, head, context);
+    } else if (head > tail) {
+        writer(&trace->buffer[tail], head - tail, context);
     }
+}
 
-    if (isResponseStatusSuccess(status)) {
-        status = setWifiModeESP8266(wifiInstance, ESP8266_STATION_AND_ACCESS_POINT);
+void clearTraceESP8266(WiFi *wifi) {
+    memset(&wifi->trace, 0, sizeof(struct TraceRing));
+}
 
-        if (isResponseStatusSuccess(status)) {
-            status = setConnectionModeESP8266(wifiInstance, ESP8266_CONNECTION_SINGLE);
-        }
+ResponseStatus replayTraceESP8266(WiFi *wifi, const char *trace, uint32_t length) {
+    const uint8_t *data = (const uint8_t *) trace;
+    uint32_t position = 0;
+    if (length >= 9 && memcmp(data, TRACE_MAGIC, 4) == 0) {    // skip dump header
+        position = 9;
+    }
 
-        if (isResponseStatusSuccess(status)) {
-            status = setApplicationModeESP8266(wifiInstance, ESP8266_NORMAL);
+    while (position + TRACE_RECORD_HEADER_LENGTH <= length) {
+        uint8_t direction = data[position + 4];
+        uint32_t recordLength = data[position + 5] | (data[position + 6] << 8);
+        position += TRACE_RECORD_HEADER_LENGTH;
+        if (position + recordLength > length) break;   // truncated dump
+
+        if (direction == ESP8266_TRACE_RX) {    // captured traffic goes through same parser path as live data
+            for (uint32_t i = 0; i < recordLength; i++) {
+                processReceivedSymbol(wifi, (char) data[position + i]);
+            }
         }
+        position += recordLength;
     }
+    return getMatcherStatus(wifi->response);
+}
+#endif
 
-    if (!isResponseStatusSuccess(status)) {
-        deleteESP8266(wifiInstance);
+InitPhase initStepESP8266(WiFi *wifi) {
+    InitProgress *init = &wifi->init;
+    uint32_t currentMillis = currentMilliSeconds();
+
+    switch (init->phase) {
+        case ESP8266_INIT_READY:
+        case ESP8266_INIT_FAILED:
+            break;
+
+        case ESP8266_INIT_STARTUP:  // initial delay, waiting module startup
+            if ((currentMillis - init->phaseStartMillis) >= ESP8266_STARTUP_DELAY_MS) {
+                wifi->scan.isOptionSet = false;     // module may be power cycled since last scan
+                switchInitPhase(wifi, ESP8266_INIT_HEALTH_CHECK, currentMillis);
+            }
+            break;
+
+        default:
+            if (!init->isCommandSent) {
+                if ((int32_t) (currentMillis - init->retryAtMillis) >= 0) {   // retry backoff elapsed
+                    sendInitCommand(wifi, init->phase);
+                    init->isCommandSent = true;
+                }
+                break;
+            }
+
+            ResponseStatus status = readResponseESP8266(wifi);
+            if (isResponseStatusWaiting(status)) break;
+            init->isCommandSent = false;
+
+            if (isResponseStatusSuccess(status)) {
+                switchInitPhase(wifi, init->phase + 1, currentMillis);
+            } else if (++init->attempt >= ESP8266_KEEPALIVE_ATTEMPT_COUNT) {
+                switchInitPhase(wifi, ESP8266_INIT_FAILED, currentMillis);
+            } else {
+                METRICS_INCREMENT(wifi, retries);
+                init->retryAtMillis = currentMillis + (ESP8266_INIT_RETRY_BACKOFF_MS << (init->attempt - 1));
+            }
+            break;
     }
-    return wifiInstance;
+    return init->phase;
 }
 
 APConnectionStatus beginESP8266(WiFi *wifi, char *ssid, char *password) {
@@ -109,20 +510,33 @@ APConnectionStatus beginESP8266(WiFi *wifi, char *ssid, char *password) {
 }
 
 ResponseStatus readResponseESP8266(WiFi *wifi) {
+    ResponseStatus status = pollResponse(wifi);
+#if defined(ESP8266_ENABLE_METRICS)
+    recordResponseMetrics(wifi, status);
+#endif
+    return status;
+}
+
+static ResponseStatus pollResponse(WiFi *wifi) {
+    if (wifi->response->matcher.isCommandDropped) {
+        return ESP8266_RESPONSE_ERROR;
+    }
     if ((currentMilliSeconds() - wifi->response->startTimeMillis) >= wifi->response->timeout) {
         return ESP8266_RESPONSE_TIMEOUT;
     }
 
-    if (isTransferCompleteUSART_DMA(USARTDmaPointer->rxData)) {
-        if (isResponseOK(wifi->response->responseBody, wifi->response->isServerResponseAwaited)) {
-            return ESP8266_RESPONSE_SUCCESS;
-        } else if (isResponseError(wifi->response->responseBody)) {
-            return ESP8266_RESPONSE_ERROR;
-        } else {
-            receiveRxBufferUSART_DMA(USARTDmaPointer); // idle line and no data received, start receive data
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    return scanResponseESP8266(wifi);  // DMA is never stopped, parse only span received since last call
+#else
+    if (isTransferCompleteUSART_DMA(wifi->USARTDma->rxData)) {
+        ResponseStatus status = scanResponseESP8266(wifi);
+        if (!isResponseStatusWaiting(status)) {
+            return status;
         }
+        continueReceiveESP8266(wifi); // idle line before response end, receive rest after already scanned text
     }
     return ESP8266_RESPONSE_WAITING;
+#endif
 }
 
 ResponseStatus waitForResponseESP8266(WiFi *wifi) {
@@ -133,60 +547,124 @@ ResponseStatus waitForResponseESP8266(WiFi *wifi) {
     return status;
 }
 
+bool enqueueCommandESP8266(WiFi *wifi, CommandCallback callback, void *context, const char *ATCommand) {
+    CommandQueue *queue = &wifi->commandQueue;
+    size_t length = strlen(ATCommand);
+    if (queue->size == ESP8266_COMMAND_QUEUE_SIZE || length > ESP8266_COMMAND_MAX_LENGTH - 2) return false;  // command doesn't fit to slot with line end
+
+    QueuedCommand *command = &queue->commands[(queue->head + queue->size) % ESP8266_COMMAND_QUEUE_SIZE];
+    memcpy(command->command, ATCommand, length);
+    memcpy(&command->command[length], NEW_LINE, 2);
+    return commitQueuedCommand(wifi, length + 2, callback, context);
+}
+
+void setUrcHandlerESP8266(WiFi *wifi, UrcType type, UrcHandler handler, void *context) {
+    wifi->urc.handlers[type] = handler;
+    wifi->urc.contexts[type] = context;
+}
+
+void pollESP8266(WiFi *wifi) {
+    CommandQueue *queue = &wifi->commandQueue;
+    if (!queue->isInFlight) {
+        if (wifi->isSendPending) {  // collect datagram "SEND OK" without blocking
+            wifi->lastSendStatus = readResponseESP8266(wifi);
+            wifi->isSendPending = isResponseStatusWaiting(wifi->lastSendStatus);
+        } else {
+            processPendingData(wifi);   // no command awaited, still dispatch unsolicited result codes
+        }
+        if (queue->size > 0 && !wifi->isSendPending) {  // commands queued while payload was sent
+            transmitQueuedCommand(wifi);
+        }
+        return;
+    }
+
+    ResponseStatus status = readResponseESP8266(wifi);
+    if (isResponseStatusWaiting(status)) return;
+
+    QueuedCommand *command = &queue->commands[queue->head];
+    CommandCallback callback = command->callback;   // slot can be reused by callback, keep completion data
+    void *context = command->context;
+    wifi->response->timeout = queue->savedTimeout;
+    queue->isInFlight = false;
+    queue->head = (queue->head + 1) % ESP8266_COMMAND_QUEUE_SIZE;
+    queue->size--;
+
+    if (callback != NULL) {
+        callback(wifi, status, context);    // response body is valid only inside callback
+    }
+    if (queue->size > 0 && !queue->isInFlight && !wifi->isSendPending) {    // next command is already formatted, send it right away
+        transmitQueuedCommand(wifi);
+    }
+}
+
+void flushCommandQueueESP8266(WiFi *wifi) {
+    while (wifi->commandQueue.size > 0) {
+        pollESP8266(wifi);
+    }
+}
+
 void setResponseTimeout(WiFi *wifi, uint32_t responseTimeoutMs) {
     wifi->response->timeout = responseTimeoutMs;
 }
 
 ResponseStatus healthCheckESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT");
+    sendPlainCommand(wifi, AT_HEALTH_CHECK);
     return waitForResponseESP8266(wifi);
 }
 
 ResponseStatus restartWifiESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT+RST");
+    wifi->scan.isOptionSet = false;     // module forgets AT+CWLAPOPT after reset
+    sendPlainCommand(wifi, AT_RESTART);
     return waitForResponseESP8266(wifi);
 }
 
 ResponseStatus resetConfigurationESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT+RESTORE");
+    wifi->scan.isOptionSet = false;     // factory defaults, module restarts
+    sendPlainCommand(wifi, AT_RESTORE);
     return waitForResponseESP8266(wifi);
 }
 
 ResponseStatus setWifiModeESP8266(WiFi *wifi, WiFiMode wifiMod) {
-    sendATCommand(wifi, "AT+CWMODE=%d", wifiMod);
+    sendNumberCommand(wifi, AT_WIFI_MODE, wifiMod);
     return waitForResponseESP8266(wifi);
 }
 
 ResponseStatus setConnectionModeESP8266(WiFi *wifi, ConnectionMode connectionMode) {
-    sendATCommand(wifi, "AT+CIPMUX=%d", connectionMode);
+    sendNumberCommand(wifi, AT_CONNECTION_MODE, connectionMode);
     wifi->connectionMode = connectionMode;
     return waitForResponseESP8266(wifi);
 }
 
 ResponseStatus setApplicationModeESP8266(WiFi *wifi, TransferMode transferMode) {
-    sendATCommand(wifi, "AT+CIPMODE=%d", transferMode);
+    sendNumberCommand(wifi, AT_TRANSFER_MODE, transferMode);
+    return waitForResponseESP8266(wifi);
+}
+
+ResponseStatus enableDeepSleepModeESP8266(WiFi *wifi, uint32_t timeToSleepMs) {    // Hardware has to support deep-sleep wake up (Reset pin has to be High).
+    wifi->scan.isOptionSet = false;     // wake up from deep sleep is reset
+    sendNumberCommand(wifi, AT_DEEP_SLEEP, timeToSleepMs);
     return waitForResponseESP8266(wifi);
 }
 
-ResponseStatus enableDeepSleepModeESP8266(WiFi *wifi, uint16_t timeToSleepMs) {    // Hardware has to support deep-sleep wake up (Reset pin has to be High).
-    sendATCommand(wifi, "AT+GSLP=%d", timeToSleepMs);
+ResponseStatus setSleepModeESP8266(WiFi *wifi, SleepMode mode) {
+    sendNumberCommand(wifi, AT_SLEEP, mode);
     return waitForResponseESP8266(wifi);
 }
 
 void requestAvailableAccessPointsESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT+CWLAP");
+    sendPlainCommand(wifi, AT_SCAN);
 }
 
 void connectToAccessPointESP8266(WiFi *wifi, char *ssid, char *password) {
-    if (wifi->isNeedToSaveCredentials) {
-        sendATCommand(wifi, "AT+CWJAP_DEF=\"%s\",\"%s\"", ssid, password);// Connect ESP8266 to access point and save connection credentials
-    } else {
-        sendATCommand(wifi, "AT+CWJAP_CUR=\"%s\",\"%s\"", ssid, password);// Connect ESP8266 to access point and don't save connection credentials
-    }
+    // DEF saves connection credentials, CUR doesn't
+    CommandBuilder command = startATCommand(wifi, wifi->isNeedToSaveCredentials ? AT_JOIN_DEFAULT : AT_JOIN_CURRENT);
+    appendQuoted(&command, ssid);
+    appendQuoted(&command, password);
+    sendATCommand(wifi, &command);
 }
 
 ConnectionStatus getConnectionStatusESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT+CIPSTATUS");
+    sendPlainCommand(wifi, AT_CONNECTION_STATUS);
     ResponseStatus status = waitForResponseESP8266(wifi);
     if (isResponseStatusSuccess(status)) {
         if (strstr(wifi->response->responseBody, "STATUS:2")) {
@@ -203,7 +681,10 @@ ConnectionStatus getConnectionStatusESP8266(WiFi *wifi) {
 }
 
 APConnectionStatus getAccessPointConnectionStatusESP8266(WiFi *wifi) {
-    ResponseStatus status = readResponseESP8266(wifi);
+    return getJoinStatus(wifi, readResponseESP8266(wifi));
+}
+
+static APConnectionStatus getJoinStatus(WiFi *wifi, ResponseStatus status) {
     if (isResponseStatusSuccess(status)) {
         return ESP8266_WIFI_CONNECTED;
     } else if (isResponseStatusWaiting(status)) {
@@ -225,333 +706,2266 @@ APConnectionStatus getAccessPointConnectionStatusESP8266(WiFi *wifi) {
 }
 
 ResponseStatus disconnectFromAccessPointESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT+CWQAP");
+    sendPlainCommand(wifi, AT_QUIT_ACCESS_POINT);
     return waitForResponseESP8266(wifi);
 }
 
-ResponseStatus connectESP8266(WiFi *wifi, char *host, uint16_t port) {
-    char tmpBuffer[TMP_CONNECT_TX_BUFFER_LENGTH];   // create tmp buffer for command
-    uint32_t savedBufferSize = USARTDmaPointer->txData->bufferSize;
-    char *savedTxBuffer = USARTDmaPointer->txData->bufferPointer;
-    setDMATransmitBufferAddress(USARTDmaPointer, tmpBuffer, TMP_CONNECT_TX_BUFFER_LENGTH);  // set tmp buffer as dma address
+bool addKnownNetworkESP8266(WiFi *wifi, const char *ssid, const char *password) {
+    if (!isSsidValid((char *) ssid) || !isPasswordValid((char *) password)) return false;
+    KnownNetworkTable *table = &wifi->knownNetworks;
+    KnownNetwork *network = NULL;
+    for (uint8_t i = 0; i < table->size; i++) {
+        if (strcmp(table->networks[i].ssid, ssid) == 0) {
+            network = &table->networks[i];
+            break;
+        }
+    }
 
-    sendATCommand(wifi, "AT+CIPSTART=\"TCP\",\"%s\",%d", host, port);
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    setDMATransmitBufferAddress(USARTDmaPointer, savedTxBuffer, savedBufferSize);   // return previous buffer as dma address
-    return status;
+    if (network == NULL) {
+        if (table->size == ESP8266_KNOWN_NETWORK_COUNT) return false;
+        network = &table->networks[table->size++];
+        memset(network, 0, sizeof(struct KnownNetwork));
+        strcpy(network->ssid, ssid);
+    }
+    strcpy(network->password, password);
+    return true;
 }
 
-ResponseStatus multipleConnectESP8266(WiFi *wifi, ConnectionID id, char *host, char *port) {
-    char tmpBuffer[TMP_CONNECT_TX_BUFFER_LENGTH];   // create tmp buffer for command
-    uint32_t savedBufferSize = USARTDmaPointer->txData->bufferSize;
-    char *savedTxBuffer = USARTDmaPointer->txData->bufferPointer;
-    setDMATransmitBufferAddress(USARTDmaPointer, tmpBuffer, TMP_CONNECT_TX_BUFFER_LENGTH);  // set tmp buffer as dma address
-
-    sendATCommand(wifi, "AT+CIPSTART=\"%d\",\"TCP\",\"%s\",%s", id, host, port);
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    setDMATransmitBufferAddress(USARTDmaPointer, savedTxBuffer, savedBufferSize);   // return previous buffer as dma address
-    return status;
+void clearKnownNetworksESP8266(WiFi *wifi) {
+    memset(&wifi->knownNetworks, 0, sizeof(struct KnownNetworkTable));
+    wifi->knownNetworks.lastConnected = NO_KNOWN_NETWORK;
 }
 
-ResponseStatus checkForConnectionESP8266(WiFi *wifi) {
-    ResponseStatus status = readResponseESP8266(wifi);
-    if (isResponseStatusError(status)) {
-        if (strstr(wifi->response->responseBody, "ALREADY CONNECTED")) {
-            return ESP8266_RESPONSE_SUCCESS;
+APConnectionStatus connectKnownNetworkESP8266(WiFi *wifi) {
+    KnownNetworkTable *table = &wifi->knownNetworks;
+    if (table->size == 0) return ESP8266_NOT_FOUND_TARGET_AP;
+    APConnectionStatus connectionStatus = ESP8266_NOT_FOUND_TARGET_AP;
+#if defined(ESP8266_ENABLE_METRICS)
+    uint32_t startMillis = currentMilliSeconds();
+#endif
+
+    if (table->lastConnected != NO_KNOWN_NETWORK) {     // bssid qualified join, module doesn't select between access points
+        connectionStatus = joinKnownNetwork(wifi, &table->networks[table->lastConnected], true);
+        if (connectionStatus == ESP8266_WIFI_CONNECTED) {
+            METRICS_INCREMENT(wifi, fastJoins);
+            METRICS_ADD(wifi, fastJoinMillis, currentMilliSeconds() - startMillis);
+            return connectionStatus;
         }
+        METRICS_INCREMENT(wifi, fastJoinFailures);
+        table->lastConnected = NO_KNOWN_NETWORK;    // access point moved or gone, cache is stale
     }
-    return status;
+
+    for (uint8_t i = 0; i < table->size; i++) {
+        table->networks[i].isVisible = false;
+    }
+    scanAccessPointsESP8266(wifi, NULL, updateKnownNetwork, table);
+
+    bool isTried[ESP8266_KNOWN_NETWORK_COUNT] = {0};
+    int8_t candidate;
+    while ((candidate = findNextCandidate(table, isTried)) != NO_KNOWN_NETWORK) {
+        isTried[candidate] = true;
+        connectionStatus = joinKnownNetwork(wifi, &table->networks[candidate], false);
+        if (connectionStatus == ESP8266_WIFI_CONNECTED) {
+            METRICS_INCREMENT(wifi, fullJoins);
+            METRICS_ADD(wifi, fullJoinMillis, currentMilliSeconds() - startMillis);
+            cacheJoinedAccessPoint(wifi, candidate);
+            break;
+        }
+    }
+    return connectionStatus;
 }
 
-ResponseStatus sendESP8266(WiFi *wifi, char *data) {
-    uint32_t dataLength = strlen(data) + 2;
-    uint32_t savedBufferSize = USARTDmaPointer->txData->bufferSize;
-    sendATCommand(wifi, "AT+CIPSEND=%d", dataLength);    // provide uriPattern length before request
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    USARTDmaPointer->txData->bufferSize = dataLength;
-    if (isResponseStatusSuccess(status)) {
-        memset(USARTDmaPointer->rxData->bufferPointer, 0, USARTDmaPointer->rxData->bufferSize);
-        memset(USARTDmaPointer->txData->bufferPointer, 0, USARTDmaPointer->txData->bufferSize);
-        strcat(USARTDmaPointer->txData->bufferPointer, data);
-        strcat(USARTDmaPointer->txData->bufferPointer, NEW_LINE);
-        wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
-        wifi->response->isServerResponseAwaited = true;
-        transmitTxBufferUSART_DMA(USARTDmaPointer);
-        receiveRxBufferUSART_DMA(USARTDmaPointer);
-        status = ESP8266_RESPONSE_WAITING;
+static APConnectionStatus joinKnownNetwork(WiFi *wifi, KnownNetwork *network, bool isBssidRequired) {
+    CommandBuilder command = startATCommand(wifi, wifi->isNeedToSaveCredentials ? AT_JOIN_DEFAULT : AT_JOIN_CURRENT);
+    appendQuoted(&command, network->ssid);
+    appendQuoted(&command, network->password);
+    if (isBssidRequired) {
+        appendQuoted(&command, network->bssid);
     }
-    USARTDmaPointer->txData->bufferSize = savedBufferSize;
-    return status;
+    sendATCommand(wifi, &command);
+    return getJoinStatus(wifi, waitForResponseESP8266(wifi));
 }
 
-ResponseStatus sendRequestBodyESP8266(WiFi *wifi) {
-    char tmpBuffer[TMP_SEND_TX_BUFFER_LENGTH];   // create tmp buffer for command
-    uint32_t dataLength = (wifi->request->dataLength) > 0 ? (wifi->request->dataLength + 2) : (strlen(wifi->request->requestBody) + 2);
-    uint32_t savedBufferSize = USARTDmaPointer->txData->bufferSize;
-    char *savedTxBuffer = USARTDmaPointer->txData->bufferPointer;
-    setDMATransmitBufferAddress(USARTDmaPointer, tmpBuffer, TMP_SEND_TX_BUFFER_LENGTH);  // set tmp buffer as dma address
-    wifi->request->dataLength = 0;  // reset data length, preventing incorrect data transmit length for next request
-
-    sendATCommand(wifi, "AT+CIPSEND=%d", dataLength);
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    setDMATransmitBufferAddress(USARTDmaPointer, savedTxBuffer, dataLength);   // return previous buffer as dma address
-    if (isResponseStatusSuccess(status)) {
-        memset(USARTDmaPointer->rxData->bufferPointer, 0, USARTDmaPointer->rxData->bufferSize);
-        strcat(USARTDmaPointer->txData->bufferPointer, NEW_LINE);
-        wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
-        wifi->response->isServerResponseAwaited = true;
-        transmitTxBufferUSART_DMA(USARTDmaPointer);
-        receiveRxBufferUSART_DMA(USARTDmaPointer);
-        USARTDmaPointer->txData->bufferSize = savedBufferSize;
-        status = ESP8266_RESPONSE_WAITING;
+static void cacheJoinedAccessPoint(WiFi *wifi, int8_t networkIndex) {
+    sendPlainCommand(wifi, AT_JOIN_QUERY);
+    if (isResponseStatusSuccess(waitForResponseESP8266(wifi))) {
+        parseJoinedAccessPoint(wifi, networkIndex);
     }
-    USARTDmaPointer->txData->bufferSize = savedBufferSize;
-    return status;
 }
 
-ResponseStatus sendRequestBodyByIdESP8266(WiFi *wifi, ConnectionID id) {
-    char tmpBuffer[TMP_SEND_TX_BUFFER_LENGTH];
-    uint32_t dataLength = (wifi->request->dataLength) > 0 ? (wifi->request->dataLength + 2) : (strlen(wifi->request->requestBody) + 2);
-    uint32_t savedBufferSize = USARTDmaPointer->txData->bufferSize;
-    char *savedTxBuffer = USARTDmaPointer->txData->bufferPointer;
-    setDMATransmitBufferAddress(USARTDmaPointer, tmpBuffer, TMP_SEND_TX_BUFFER_LENGTH);
-    wifi->request->dataLength = 0;  // reset data length, preventing incorrect data transmit length for next request
-
-    sendATCommand(wifi, "AT+CIPSEND=%d,%d", id, dataLength);    // provide connection id and data length before request
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    setDMATransmitBufferAddress(USARTDmaPointer, savedTxBuffer, savedBufferSize);
-    if (isResponseStatusSuccess(status)) {
-        memset(USARTDmaPointer->rxData->bufferPointer, 0, USARTDmaPointer->rxData->bufferSize);
-        strcat(USARTDmaPointer->txData->bufferPointer, NEW_LINE);
-        wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
-        wifi->response->isServerResponseAwaited = true;
-        transmitTxBufferUSART_DMA(USARTDmaPointer);
-        receiveRxBufferUSART_DMA(USARTDmaPointer);
-        USARTDmaPointer->txData->bufferSize = savedBufferSize;
-        status = ESP8266_RESPONSE_WAITING;
+static bool parseJoinedAccessPoint(WiFi *wifi, int8_t networkIndex) {  // "+CWJAP_CUR:"<ssid>","<bssid>",<channel>,<rssi>"
+    KnownNetwork *network = &wifi->knownNetworks.networks[networkIndex];
+    char *ssidPointer = strstr(wifi->response->responseBody, JOINED_ACCESS_POINT_PREFIX);
+    if (ssidPointer == NULL) return false;
+    ssidPointer += strlen(JOINED_ACCESS_POINT_PREFIX);
+
+    uint8_t ssidLength = strlen(network->ssid);
+    char *bssidPointer = ssidPointer + ssidLength + 3;  // skip ssid and "," separator
+    if (strncmp(ssidPointer, network->ssid, ssidLength) != 0 || strncmp(&ssidPointer[ssidLength], "\",\"", 3) != 0) return false;
+    if (bssidPointer[MAC_ADDRESS_LENGTH] != '"') return false;
+
+    memcpy(network->bssid, bssidPointer, MAC_ADDRESS_LENGTH);
+    network->bssid[MAC_ADDRESS_LENGTH] = '\0';
+    network->channel = strtol(&bssidPointer[MAC_ADDRESS_LENGTH + 2], NULL, 10);
+    wifi->knownNetworks.lastConnected = networkIndex;
+    return true;
+}
+
+static ScanAction updateKnownNetwork(WiFi *wifi, const AccessPoint *accessPoint, void *context) {
+    (void) wifi;
+    KnownNetworkTable *table = context;
+    for (uint8_t i = 0; i < table->size; i++) {
+        KnownNetwork *network = &table->networks[i];
+        bool isStronger = !network->isVisible || accessPoint->signalStrength > network->signalStrength;
+        if (isStronger && strcmp(network->ssid, accessPoint->ssid) == 0) {  // keep strongest access point of network
+            network->isVisible = true;
+            network->signalStrength = accessPoint->signalStrength;
+            network->channel = accessPoint->channel;
+        }
     }
-    USARTDmaPointer->txData->bufferSize = savedBufferSize;
-    return status;
+    return ESP8266_SCAN_CONTINUE;
 }
 
-ResponseStatus closeConnectionESP8266(WiFi *wifi) {
-    if (wifi->connectionMode == ESP8266_CONNECTION_SINGLE) {
-        sendATCommand(wifi, "AT+CIPCLOSE");
-        return waitForResponseESP8266(wifi);
+static int8_t findNextCandidate(KnownNetworkTable *table, bool *isTried) {  // best signal class first, table order within same class
+    int8_t candidate = NO_KNOWN_NETWORK;
+    uint8_t candidateRank = UINT8_MAX;
+    for (uint8_t i = 0; i < table->size; i++) {
+        KnownNetwork *network = &table->networks[i];
+        if (!network->isVisible || isTried[i]) continue;
+
+        uint8_t rank = getSignalRank(network->signalStrength);
+        if (rank < candidateRank) {
+            candidate = i;
+            candidateRank = rank;
+        }
     }
-    return ESP8266_RESPONSE_ERROR;
+    return candidate;
 }
 
-ResponseStatus closeConnectionByIdESP8266(WiFi *wifi, ConnectionID id) {//  ID no. of connection to close, when id=5, all connections will be closed.
-    if (wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE) {
-        sendATCommand(wifi, "AT+CIPCLOSE=%d", id);
-        return waitForResponseESP8266(wifi);
+static uint8_t getSignalRank(int8_t signalStrength) {
+    static const SignalStrength thresholds[] = {
+            ESP8266_RSSI_30dBm, ESP8266_RSSI_50dBm, ESP8266_RSSI_60dBm, ESP8266_RSSI_67dBm,
+            ESP8266_RSSI_70dBm, ESP8266_RSSI_80dBm, ESP8266_RSSI_90dBm
+    };
+    uint8_t rank = 0;
+    while (rank < sizeof(thresholds) / sizeof(thresholds[0]) && -signalStrength > (int16_t) thresholds[rank]) {
+        rank++;
     }
-    return ESP8266_RESPONSE_ERROR;
+    return rank;
 }
 
-void getLocalInfoESP8266(WiFi *wifi, LocalInfo *localInfo) {
-    sendATCommand(wifi, "AT+CIFSR");
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    if (isResponseStatusSuccess(status)) {
-        char accessPointIP[IP_ADDRESS_LENGTH + 1] = {0};
-        char accessPointMAC[MAC_ADDRESS_LENGTH + 1] = {0};
-        char localIP[IP_ADDRESS_LENGTH + 1] = {0};
-        char localMAC[MAC_ADDRESS_LENGTH + 1] = {0};
+void startSupervisorESP8266(WiFi *wifi) {
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    supervisor->state = ESP8266_SUPERVISOR_BACKOFF;
+    supervisor->joinAttempt = 0;
+    supervisor->retryAtMillis = currentMilliSeconds();  // first attempt on next tick
+    supervisor->jitterSeed = DWT->CYCCNT | 1;   // devices started together should not retry in sync
+}
 
-        substringString("APIP,\"", "\"", wifi->response->responseBody, accessPointIP);
-        substringString("APMAC,\"", "\"", wifi->response->responseBody, accessPointMAC);
-        substringString("STAIP,\"", "\"", wifi->response->responseBody, localIP);
-        substringString("STAMAC,\"", "\"", wifi->response->responseBody, localMAC);
+void stopSupervisorESP8266(WiFi *wifi) {
+    wifi->supervisor.state = ESP8266_SUPERVISOR_STOPPED;   // pending command completes, no new attempts
+}
 
-        localInfo->accessPointIP = ipAddressFromString(accessPointIP);
-        localInfo->accessPointMAC = macAddressFromString(accessPointMAC);
-        localInfo->localIP = ipAddressFromString(localIP);
-        localInfo->localMAC = macAddressFromString(localMAC);
+bool superviseEndpointESP8266(WiFi *wifi, ConnectionID id, const SocketConfig *config) {
+    if (wifi->connectionMode == ESP8266_CONNECTION_SINGLE) {
+        id = CONNECTION_ID_0;
     }
+    if (id >= ESP8266_CONNECTION_COUNT || config == NULL) return false;
+    if (config->host == NULL || strlen(config->host) > ESP8266_HOST_MAX_LENGTH) return false;
+
+    SupervisedEndpoint *endpoint = &wifi->supervisor.endpoints[id];
+    strcpy(endpoint->host, config->host);
+    endpoint->config = *config;
+    endpoint->config.host = endpoint->host;
+    endpoint->attempt = 0;
+    endpoint->retryAtMillis = currentMilliSeconds();
+    endpoint->isRegistered = true;
+    return true;
 }
 
-AccessPointList getAvailableAccessPointsESP8266(WiFi *wifi) {
-    requestAvailableAccessPointsESP8266(wifi);
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    AccessPointList accessPointList = {0};
-
-    if (isResponseStatusSuccess(status)) {
-        Regex regex;
-        regexCompile(&regex, "(.+?)");
-
-        char *srcPointer = wifi->response->responseBody;;
-        for (int i = 0; i < ESP8266_AVAILABLE_ACCESS_POINT_COUNT; i++) {
-            Matcher matcher = regexMatch(&regex, srcPointer);
-            if (!matcher.isFound) break;
+void releaseEndpointESP8266(WiFi *wifi, ConnectionID id) {
+    if (id >= ESP8266_CONNECTION_COUNT) return;
+    wifi->supervisor.endpoints[id].isRegistered = false;
+}
 
-            char *valuePointer = &srcPointer[matcher.foundAtIndex + 1];
-            valuePointer[matcher.matchLength - 2] = '\0';
-            parseToAP(&accessPointList.accessPointArray[i], valuePointer);
-            srcPointer += matcher.matchLength + matcher.foundAtIndex;
-            accessPointList.size++;
+SupervisorState superviseESP8266(WiFi *wifi) {
+    pollESP8266(wifi);  // completes supervisor commands and updates link state from unsolicited result codes
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    if (supervisor->state == ESP8266_SUPERVISOR_STOPPED || supervisor->isCommandPending) return supervisor->state;
+
+    uint32_t currentMillis = currentMilliSeconds();
+    if (!wifi->link.hasIP) {
+        if (supervisor->state == ESP8266_SUPERVISOR_ONLINE) {     // access point lost, module drops sockets too
+            supervisor->state = ESP8266_SUPERVISOR_BACKOFF;
+            supervisor->joinAttempt = 0;
+            supervisor->retryAtMillis = currentMillis + getBackoffDelay(supervisor, 0);
+        } else if ((int32_t) (currentMillis - supervisor->retryAtMillis) >= 0) {
+            startSupervisedJoin(wifi, currentMillis);
         }
+        return supervisor->state;
     }
-    return accessPointList;
+
+    supervisor->state = ESP8266_SUPERVISOR_ONLINE;
+    startSupervisedEndpoint(wifi, currentMillis);
+    return supervisor->state;
 }
 
-ResponseStatus enableSoftApESP8266(WiFi *wifi, char *ssid, char *password, uint8_t channel, WifiEncryptionType encryption) {
-    sendATCommand(wifi, "AT+CWSAP?");
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    if (!isResponseStatusError(status)) return status;
+static void startSupervisedJoin(WiFi *wifi, uint32_t currentMillis) {
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    KnownNetworkTable *table = &wifi->knownNetworks;
+    if (table->size == 0) return;
+
+    bool isBssidRequired = table->lastConnected != NO_KNOWN_NETWORK && supervisor->joinAttempt == 0;   // cached bssid only on first attempt
+    KnownNetwork *network = isBssidRequired
+            ? &table->networks[table->lastConnected]
+            : &table->networks[supervisor->nextNetwork % table->size];   // no scan here, known networks are tried in turn
+    CommandBuilder command = startQueuedCommand(wifi, wifi->isNeedToSaveCredentials ? AT_JOIN_DEFAULT : AT_JOIN_CURRENT);
+    appendQuoted(&command, network->ssid);
+    appendQuoted(&command, network->password);
+    if (isBssidRequired) {
+        appendQuoted(&command, network->bssid);
+    }
+    bool isStarted = enqueueATCommand(wifi, &command, onSupervisedJoin, network);
 
-    if (isSsidValid(ssid) && isPasswordValid(password)) {
-        if (wifi->isNeedToSaveCredentials) {
-            sendATCommand(wifi, "AT+CWSAP_DEF=\"%s\",\"%s\",%d,%d", ssid, password, channel, encryption);
-        } else {
-            sendATCommand(wifi, "AT+CWSAP_CUR=\"%s\",\"%s\",%d,%d", ssid, password, channel, encryption);
-        }
-        return waitForResponseESP8266(wifi);
+    if (isStarted) {
+        supervisor->isCommandPending = true;
+        supervisor->state = ESP8266_SUPERVISOR_JOINING;
+    } else {
+        supervisor->retryAtMillis = currentMillis + ESP8266_SUPERVISOR_BACKOFF_MIN_MS;    // queue is busy with application commands
     }
-    return ESP8266_RESPONSE_ERROR;
 }
 
-ResponseStatus enableOpenSoftApESP8266(WiFi *wifi, char *ssid, uint8_t channel) {
-    if (isSsidValid(ssid)) {
-        if (wifi->isNeedToSaveCredentials) {
-            sendATCommand(wifi, "AT+CWSAP_DEF=\"%s\",\"\",%d,%d", ssid, channel, ESP8266_ENCRYPTION_OPEN);
+static void startSupervisedEndpoint(WiFi *wifi, uint32_t currentMillis) {
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    for (uint8_t i = 0; i < ESP8266_CONNECTION_COUNT; i++) {
+        ConnectionID id = (supervisor->nextEndpoint + i) % ESP8266_CONNECTION_COUNT;
+        SupervisedEndpoint *endpoint = &supervisor->endpoints[id];
+        bool isOpen = wifi->link.openSockets & (1U << id);
+        if (!endpoint->isRegistered || isOpen || (int32_t) (currentMillis - endpoint->retryAtMillis) < 0) continue;
+
+        if (endpoint->config.type == ESP8266_SOCKET_SSL && endpoint->config.sslBufferSize > 0) {  // socket is started after buffer size is accepted
+            CommandBuilder command = startQueuedCommand(wifi, AT_SSL_BUFFER_SIZE);
+            appendNumber(&command, endpoint->config.sslBufferSize);
+            supervisor->isCommandPending = enqueueATCommand(wifi, &command, onSupervisedSslBuffer, endpoint);
         } else {
-            sendATCommand(wifi, "AT+CWSAP_CUR=\"%s\",\"\",%d,%d", ssid, channel, ESP8266_ENCRYPTION_OPEN);
+            supervisor->isCommandPending = enqueueSupervisedSocketStart(wifi, endpoint);
         }
-        return waitForResponseESP8266(wifi);
+        if (!supervisor->isCommandPending) {
+            endpoint->retryAtMillis = currentMillis + ESP8266_SUPERVISOR_BACKOFF_MIN_MS;    // queue is busy with application commands
+        }
+        supervisor->nextEndpoint = (id + 1) % ESP8266_CONNECTION_COUNT;
+        return;     // single endpoint per tick
     }
-    return ESP8266_RESPONSE_ERROR;
 }
 
-uint8_t numberOfConnectedClientsESP8266(WiFi *wifi) {
-    sendATCommand(wifi, "AT+CWLIF");
-    ResponseStatus status = waitForResponseESP8266(wifi);
-    uint8_t clientCount = 0;
+static bool enqueueSupervisedSocketStart(WiFi *wifi, SupervisedEndpoint *endpoint) {
+    ConnectionID id = endpoint - wifi->supervisor.endpoints;
+    CommandBuilder command = startQueuedCommand(wifi, AT_SOCKET_START);   // host length is checked on register, always fits slot
+    appendSocketStart(&command, wifi, id, &endpoint->config);
+    return enqueueATCommand(wifi, &command, onSupervisedEndpoint, endpoint);
+}
+
+static void onSupervisedJoin(WiFi *wifi, ResponseStatus status, void *context) {
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    KnownNetwork *network = context;
+    supervisor->isCommandPending = false;
 
     if (isResponseStatusSuccess(status)) {
-        char buffer[SOFT_AP_CLIENT_INFO_TOKEN_MAX_LENGTH];
-        memset(buffer, 0, SOFT_AP_CLIENT_INFO_TOKEN_MAX_LENGTH);
-        char *tmpSourcePointer = wifi->response->responseBody;
+        wifi->link.isAccessPointConnected = true;   // "WIFI GOT IP" is reported before "OK", mark in case it was missed
+        wifi->link.hasIP = true;
+        supervisor->joinAttempt = 0;
+        supervisor->joinCount++;
+        int8_t networkIndex = network - wifi->knownNetworks.networks;
+        CommandBuilder command = startQueuedCommand(wifi, AT_JOIN_QUERY);
+        supervisor->isCommandPending = enqueueATCommand(wifi, &command, onSupervisedJoinQuery, (void *) (intptr_t) networkIndex);
+        return;
+    }
 
-        while (substringString("", "\r\n", tmpSourcePointer, buffer)) {
-            tmpSourcePointer += strlen(buffer) + 2;
-            clientCount++;
-            memset(buffer, 0, SOFT_AP_CLIENT_INFO_TOKEN_MAX_LENGTH);
-        }
+    bool isFastJoin = supervisor->joinAttempt == 0 && wifi->knownNetworks.lastConnected != NO_KNOWN_NETWORK;
+    if (isFastJoin) {
+        METRICS_INCREMENT(wifi, fastJoinFailures);
+    }
+    supervisor->nextNetwork++;
+    supervisor->retryAtMillis = currentMilliSeconds() + getBackoffDelay(supervisor, supervisor->joinAttempt);
+    if (supervisor->joinAttempt < UINT8_MAX) {
+        supervisor->joinAttempt++;
+    }
+    if (supervisor->state == ESP8266_SUPERVISOR_JOINING) {
+        supervisor->state = ESP8266_SUPERVISOR_BACKOFF;
     }
-    return clientCount;
 }
 
-SoftAPClient getSoftApClientInfo(WiFi *wifi, uint8_t clientNumber) {
-    char buffer[SOFT_AP_CLIENT_INFO_TOKEN_MAX_LENGTH] = {0};
-    char *tmpSourcePointer = wifi->response->responseBody;
-    SoftAPClient softApClient;
-
-    for (uint8_t i = 0; (i <= clientNumber); i++) {
-        memset(buffer, 0, SOFT_AP_CLIENT_INFO_TOKEN_MAX_LENGTH);
-        substringString("", "\r\n", tmpSourcePointer, buffer);
-        tmpSourcePointer += strlen(buffer) + 2;
-    }
-    char *ipToken = strtok(buffer, ",");
-    char *macToken = strtok(NULL, ",");
-    softApClient.clientIP = ipAddressFromString(ipToken);
-    softApClient.clientMac = macAddressFromString(macToken);
-    return softApClient;
+static void onSupervisedJoinQuery(WiFi *wifi, ResponseStatus status, void *context) {
+    wifi->supervisor.isCommandPending = false;
+    if (isResponseStatusSuccess(status)) {
+        parseJoinedAccessPoint(wifi, (int8_t) (intptr_t) context);    // cache bssid for next fast rejoin
+    }
 }
 
-void setSoftApIP(WiFi *wifi, char *ipAddress) {
-    if (isIPv4AddressValid(ipAddress)) {
-        sendATCommand(wifi, "AT+CIPAP=\"%s\"", ipAddress);
+static void onSupervisedSslBuffer(WiFi *wifi, ResponseStatus status, void *context) {
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    SupervisedEndpoint *endpoint = context;
+    supervisor->isCommandPending = false;
+
+    if (isResponseStatusError(status)) {    // socket would start with default buffer and fail handshake
+        delaySupervisedEndpoint(supervisor, endpoint);
+        return;
+    }
+    supervisor->isCommandPending = enqueueSupervisedSocketStart(wifi, endpoint);
+    if (!supervisor->isCommandPending) {
+        endpoint->retryAtMillis = currentMilliSeconds() + ESP8266_SUPERVISOR_BACKOFF_MIN_MS;
     }
 }
 
-void pingPacketESP8266(WiFi *wifi, char *host) {
-    sendATCommand(wifi, "AT+PING=\"%s\"", host);
+static void onSupervisedEndpoint(WiFi *wifi, ResponseStatus status, void *context) {
+    LinkSupervisor *supervisor = &wifi->supervisor;
+    SupervisedEndpoint *endpoint = context;
+    ConnectionID id = endpoint - supervisor->endpoints;
+    supervisor->isCommandPending = false;
+
+    if (isResponseStatusSuccess(status) || wifi->response->matcher.isAlreadyConnected) {
+        wifi->link.openSockets |= (1U << id);
+        endpoint->attempt = 0;
+        supervisor->reopenCount++;
+        return;
+    }
+    delaySupervisedEndpoint(supervisor, endpoint);
 }
 
-int32_t getPacketPingTimeESP8266() {
-    char buffer[10] = { [0 ... 10 - 1] = 0 };
-    if (substringString("+", NEW_LINE, USARTDmaPointer->rxData->bufferPointer, buffer)) {
-        return strtol(USARTDmaPointer->rxData->bufferPointer, NULL, 10);
+static void delaySupervisedEndpoint(LinkSupervisor *supervisor, SupervisedEndpoint *endpoint) {
+    endpoint->retryAtMillis = currentMilliSeconds() + getBackoffDelay(supervisor, endpoint->attempt);
+    if (endpoint->attempt < UINT8_MAX) {
+        endpoint->attempt++;
     }
-    return ESP8266_PING_PACKET_TIMEOUT_VALUE;
 }
 
-void deleteESP8266(WiFi *wifi) {
-    if (wifi != NULL) {// no need to free every pointer in struct, it will be deallocated at USART side
-        deleteUSART_DMA(USARTDmaPointer);
-        free(wifi->response);
-        free(wifi->request);
-        free(wifi);
+static uint32_t getBackoffDelay(LinkSupervisor *supervisor, uint8_t attempt) {   // half of delay is fixed, other half is random
+    uint32_t delay = ESP8266_SUPERVISOR_BACKOFF_MAX_MS;
+    if (attempt < 16 && (ESP8266_SUPERVISOR_BACKOFF_MIN_MS << attempt) < ESP8266_SUPERVISOR_BACKOFF_MAX_MS) {
+        delay = ESP8266_SUPERVISOR_BACKOFF_MIN_MS << attempt;
     }
+
+    uint32_t seed = supervisor->jitterSeed;     // xorshift32
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    supervisor->jitterSeed = seed;
+    return (delay / 2) + (seed % (delay / 2 + 1));
 }
 
-static inline bool isSsidValid(char *ssid) {
-    return (ssid != NULL && strlen(ssid) < MAX_SSID_LENGTH);
+ResponseStatus connectESP8266(WiFi *wifi, char *host, uint16_t port) {
+    SocketConfig config = {.type = ESP8266_SOCKET_TCP, .host = host, .port = port};
+    return connectSocketESP8266(wifi, CONNECTION_ID_0, &config);
 }
 
-static inline bool isPasswordValid(char *password) {
-    return (password != NULL && strlen(password) < MAX_PASSWORD_LENGTH);
+ResponseStatus multipleConnectESP8266(WiFi *wifi, ConnectionID id, char *host, char *port) {
+    SocketConfig config = {.type = ESP8266_SOCKET_TCP, .host = host, .port = strtol(port, NULL, 10)};
+    return connectSocketESP8266(wifi, id, &config);
 }
 
-static void sendATCommand(WiFi *wifi, const char *ATCommandPattern, ...) {    // sendRequestBodyESP8266 AT command to ESP8266
-    memset(USARTDmaPointer->txData->bufferPointer, 0, USARTDmaPointer->txData->bufferSize);
-    va_list valist;
-    va_start(valist, ATCommandPattern);
-    vsprintf(USARTDmaPointer->txData->bufferPointer, ATCommandPattern, valist);
-    va_end(valist);
+ResponseStatus connectSocketESP8266(WiFi *wifi, ConnectionID id, const SocketConfig *config) {
+    ResponseStatus status = ESP8266_RESPONSE_SUCCESS;
+    if (config->type == ESP8266_SOCKET_SSL && config->sslBufferSize > 0) {
+        sendNumberCommand(wifi, AT_SSL_BUFFER_SIZE, config->sslBufferSize);
+        status = waitForResponseESP8266(wifi);
+    }
+    if (isResponseStatusSuccess(status)) {
+        CommandBuilder command = startATCommand(wifi, AT_SOCKET_START);
+        appendSocketStart(&command, wifi, id, config);
+        sendATCommand(wifi, &command);
+        status = waitForResponseESP8266(wifi);
+    }
+    return status;
+}
 
-    strcat(USARTDmaPointer->txData->bufferPointer, NEW_LINE);  // ESP8266 expects <CR><LF> or CarriageReturn and LineFeed at the end of each command
-    memset(USARTDmaPointer->rxData->bufferPointer, 0, USARTDmaPointer->rxData->bufferSize);
-    wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
-    wifi->response->isServerResponseAwaited = false;
-    receiveRxBufferUSART_DMA(USARTDmaPointer);
-    transmitUSART_DMA(USARTDmaPointer, USARTDmaPointer->txData->bufferPointer, strlen(USARTDmaPointer->txData->bufferPointer));
+static void appendSocketStart(CommandBuilder *command, WiFi *wifi, ConnectionID id, const SocketConfig *config) {
+    static const char *const SOCKET_TYPE_NAMES[] = {
+            [ESP8266_SOCKET_TCP] = "TCP",
+            [ESP8266_SOCKET_UDP] = "UDP",
+            [ESP8266_SOCKET_SSL] = "SSL"
+    };
+    if (wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE) {
+        appendNumber(command, id);
+    }
+    appendQuoted(command, SOCKET_TYPE_NAMES[config->type]);
+    appendQuoted(command, config->host);
+    appendNumber(command, config->port);
+
+    if (config->type == ESP8266_SOCKET_UDP) {
+        if (config->localPort > 0 || config->udpMode != ESP8266_UDP_REMOTE_FIXED) {
+            appendNumber(command, config->localPort);
+            appendNumber(command, config->udpMode);
+        }
+    } else if (config->keepAliveSeconds > 0) {
+        appendNumber(command, config->keepAliveSeconds);
+    }
 }
 
-static bool isResponseOK(char *responseBody, bool isServerResponse) {
-    if (isServerResponse) {
-        return strstr(responseBody, CLOSED_STATUS) || strstr(responseBody, DATA_RECEIVED_STATUS);
+ResponseStatus checkForConnectionESP8266(WiFi *wifi) {
+    ResponseStatus status = readResponseESP8266(wifi);
+    if (isResponseStatusError(status)) {
+        if (wifi->response->matcher.isAlreadyConnected) {
+            return ESP8266_RESPONSE_SUCCESS;
+        }
     }
-    return strstr(responseBody, OK_STATUS) || strstr(responseBody, SEND_OK_STATUS)  || strstr(responseBody, ">");
+    return status;
 }
 
-static bool isResponseError(char *responseBody) {    // find for "error" or "fail" response status
-    return strstr(responseBody, ERROR_STATUS) || strstr(responseBody, FAIL_STATUS);
+ResponseStatus sendESP8266(WiFi *wifi, char *data) {
+    SendSegment segments[] = {
+            {data, strlen(data)},   // text data, for binary payload use sendDataESP8266()
+            {NEW_LINE, 2}
+    };
+    return sendVectorESP8266(wifi, CONNECTION_ID_0, segments, 2);
 }
 
-static void setDMATransmitBufferAddress(USART_DMA *USARTDmaInstance, char *bufferPointer, uint32_t bufferSize) {
-    USARTDmaPointer->txData->bufferSize = bufferSize;
-    USARTDmaPointer->txData->bufferPointer = bufferPointer;
+ResponseStatus sendDataESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length) {
+    SendSegment segment = {data, length};
+    return sendVectorESP8266(wifi, id, &segment, 1);
+}
 
-    LL_DMA_DisableStream(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream);
-    uint32_t dataRegisterAddress = LL_USART_DMA_GetRegAddr(USARTDmaInstance->USARTx);
-    uint32_t txDataTransferDirection = LL_DMA_GetDataTransferDirection(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream);
-    LL_DMA_ConfigAddresses(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream, (uint32_t) bufferPointer, dataRegisterAddress, txDataTransferDirection);
-    enableDMAStream(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream);
-    LL_USART_EnableDMAReq_TX(USARTDmaInstance->USARTx);
-    LL_USART_EnableDMAReq_RX(USARTDmaInstance->USARTx);
+ResponseStatus sendRequestBodyESP8266(WiFi *wifi) {
+    return sendRequestData(wifi, CONNECTION_ID_0, false);
 }
 
-static void parseToAP(AccessPoint *accessPoint, char *buffer) {
-    char *source = buffer;
-    char *parameterValue;
-    APParameter = SECURITY;
+ResponseStatus sendRequestBodyByIdESP8266(WiFi *wifi, ConnectionID id) {
+    return sendRequestData(wifi, id, true);
+}
 
-    while ((APParameter < SIGNAL_STRENGTH + 1) && (parameterValue = splitStringReentrant(source, ",", &source))) {
-        switch (APParameter) {
-            case SECURITY:
-                accessPoint->encryption = atoi(parameterValue);
-                break;
-            case SSID:
-                accessPoint->ssid = parameterValue;
-                break;
-            case SIGNAL_STRENGTH:
-                accessPoint->signalStrength = atoi(parameterValue);
-                break;
-            default:
-                break;
+ResponseStatus sendVectorESP8266(WiFi *wifi, ConnectionID id, const SendSegment *segments, uint8_t segmentCount) {
+    return transmitSegments(wifi, id, segments, segmentCount, true);
+}
+
+ResponseStatus sendLargeESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length, StreamSendReport *report) {
+    StreamSendReport localReport;
+    report = (report != NULL) ? report : &localReport;
+    memset(report, 0, sizeof(StreamSendReport));
+    uint32_t startMillis = currentMilliSeconds();
+
+    ResponseStatus status = ESP8266_RESPONSE_SUCCESS;
+    while (length > 0 && isResponseStatusSuccess(status)) {    // chunks are sent straight from caller memory
+        uint32_t chunkLength = (length < MAX_SEND_DATA_LENGTH) ? length : MAX_SEND_DATA_LENGTH;
+        status = sendChunk(wifi, id, data, chunkLength, report, NULL);
+        data += chunkLength;
+        length -= chunkLength;
+    }
+    finishSendReport(report, startMillis);
+    return status;
+}
+
+ResponseStatus sendStreamESP8266(WiFi *wifi, ConnectionID id, PayloadProducer producer, void *context,
+                                 char *workBuffer, uint32_t workBufferLength, StreamSendReport *report) {
+    StreamSendReport localReport;
+    report = (report != NULL) ? report : &localReport;
+    memset(report, 0, sizeof(StreamSendReport));
+    uint32_t startMillis = currentMilliSeconds();
+
+    uint32_t chunkCapacity = workBufferLength / 2;
+    if (chunkCapacity > MAX_SEND_DATA_LENGTH) {
+        chunkCapacity = MAX_SEND_DATA_LENGTH;
+    }
+    if (chunkCapacity == 0) return ESP8266_RESPONSE_ERROR;
+
+    char *currentBuffer = workBuffer;
+    uint32_t currentLength = producer(currentBuffer, chunkCapacity, context);
+    NextChunk next = {.producer = producer, .context = context, .buffer = &workBuffer[chunkCapacity], .capacity = chunkCapacity};
+
+    ResponseStatus status = ESP8266_RESPONSE_SUCCESS;
+    while (currentLength > 0 && isResponseStatusSuccess(status)) {
+        next.isProduced = false;
+        status = sendChunk(wifi, id, currentBuffer, currentLength, report, &next);
+        if (!next.isProduced) {     // chunk failed before transmit
+            break;
+        }
+
+        char *sentBuffer = currentBuffer;    // swap buffers, sent one is filled while next is transmitted
+        currentBuffer = next.buffer;
+        currentLength = next.length;
+        next.buffer = sentBuffer;
+    }
+    finishSendReport(report, startMillis);
+    return status;
+}
+
+static ResponseStatus sendChunk(WiFi *wifi, ConnectionID id, const char *data, uint32_t length, StreamSendReport *report, NextChunk *next) {
+    ResponseStatus status;
+    for (uint8_t attempt = 0;; attempt++) {
+        status = startChunk(wifi, id, data, length, next);
+        if (isResponseStatusWaiting(status)) {
+            produceNextChunk(next);     // fill next buffer during DMA transfer and module send
+            status = waitForChunkStatus(wifi);
+        }
+
+        bool isRetryable = wifi->response->matcher.matchedPatterns & SEND_RETRY_PATTERNS;
+        if (isResponseStatusSuccess(status) || !isRetryable || attempt == ESP8266_SEND_RETRY_COUNT) break;
+        report->retransmits++;
+    }
+
+    if (isResponseStatusSuccess(status)) {
+        report->bytesSent += length;
+        report->chunks++;
+    }
+    return status;
+}
+
+static ResponseStatus startChunk(WiFi *wifi, ConnectionID id, const char *data, uint32_t length, NextChunk *next) {
+    uint32_t busyDelay = ESP8266_BUSY_RETRY_DELAY_MS;
+    for (uint8_t attempt = 0;; attempt++) {
+        sendPayloadLength(wifi, id, length, wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE);
+        ResponseStatus status = waitForChunkStatus(wifi);
+        bool isBusy = wifi->response->matcher.matchedPatterns & PATTERN_BIT(BUSY_PATTERN);
+        if (isBusy && attempt < ESP8266_SEND_RETRY_COUNT) {    // module is still sending previous data
+            status = waitForBusyRetry(wifi, next, currentMilliSeconds() + busyDelay);
+            busyDelay *= 2;
+        }
+        if (isResponseStatusSuccess(status)) {
+            SendSegment chunk = {.data = data, .length = length};
+            transmitPayload(wifi, &chunk, 1, false);
+            return ESP8266_RESPONSE_WAITING;
         }
-        APParameter++;
+        if (!isBusy || attempt == ESP8266_SEND_RETRY_COUNT) return status;
     }
-}
\ No newline at end of file
+}
+
+static ResponseStatus waitForChunkStatus(WiFi *wifi) {
+    ResponseStatus status;
+    do {
+        status = readResponseESP8266(wifi);
+    } while (isResponseStatusWaiting(status) && !(wifi->response->matcher.matchedPatterns & SEND_RETRY_PATTERNS));
+    return isResponseStatusWaiting(status) ? ESP8266_RESPONSE_ERROR : status;  // chunk is retried without waiting for final status
+}
+
+static ResponseStatus waitForBusyRetry(WiFi *wifi, NextChunk *next, uint32_t retryAtMillis) {
+    ResponseStatus status;
+    do {
+        produceNextChunk(next);
+        status = readResponseESP8266(wifi);    // command can still be taken late with prompt
+    } while (!isResponseStatusSuccess(status) && (int32_t) (currentMilliSeconds() - retryAtMillis) < 0);
+    return status;
+}
+
+static void produceNextChunk(NextChunk *next) {
+    if (next != NULL && !next->isProduced) {
+        next->length = next->producer(next->buffer, next->capacity, next->context);
+        next->isProduced = true;
+    }
+}
+
+static void finishSendReport(StreamSendReport *report, uint32_t startMillis) {
+    report->elapsedMillis = currentMilliSeconds() - startMillis;
+    if (report->elapsedMillis > 0) {
+        report->bytesPerSecond = ((uint64_t) report->bytesSent * 1000) / report->elapsedMillis;
+    }
+}
+
+ResponseStatus sendDatagramESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length) {
+    SendSegment segment = {.data = data, .length = length};
+    ResponseStatus status = transmitSegments(wifi, id, &segment, 1, false);
+    if (isResponseStatusWaiting(status)) {  // module reports "SEND OK" on its own, application doesn't wait for it
+        wifi->isSendPending = true;
+        return ESP8266_RESPONSE_SUCCESS;
+    }
+    return status;
+}
+
+static ResponseStatus transmitSegments(WiFi *wifi, ConnectionID id, const SendSegment *segments, uint8_t segmentCount, bool isServerResponseAwaited) {
+    uint32_t dataLength = 0;
+    for (uint8_t i = 0; i < segmentCount; i++) {
+        dataLength += segments[i].length;
+    }
+    if (dataLength == 0 || dataLength > MAX_SEND_DATA_LENGTH) return ESP8266_RESPONSE_ERROR;
+
+    sendPayloadLength(wifi, id, dataLength, wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    if (isResponseStatusSuccess(status)) {
+        transmitPayload(wifi, segments, segmentCount, isServerResponseAwaited);
+        status = ESP8266_RESPONSE_WAITING;
+    }
+    return status;
+}
+
+static void transmitPayload(WiFi *wifi, const SendSegment *segments, uint8_t segmentCount, bool isServerResponseAwaited) {    // after ">" prompt
+    clearResponseESP8266(wifi);
+    wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
+    wifi->response->isServerResponseAwaited = isServerResponseAwaited;
+    startReceiveESP8266(wifi);
+    METRICS_FINISH_SEND(wifi);
+    for (uint8_t i = 0; i < segmentCount; i++) {    // stream each segment straight from caller memory, no copy to TX buffer
+        if (segments[i].length == 0) continue;
+        transmitData(wifi, (char *) segments[i].data, segments[i].length);
+    }
+}
+
+ResponseStatus startServerESP8266(WiFi *wifi, uint16_t port, uint16_t timeoutSeconds) {
+    if (wifi->connectionMode != ESP8266_CONNECTION_MULTIPLE) return ESP8266_RESPONSE_ERROR;    // module accepts server only with AT+CIPMUX=1
+    CommandBuilder command = startATCommand(wifi, AT_SERVER);
+    appendNumber(&command, 1);
+    appendNumber(&command, port);
+    sendATCommand(wifi, &command);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    if (!isResponseStatusSuccess(status)) return status;
+
+    ServerState *server = &wifi->server;
+    memset(server, 0, sizeof(struct ServerState));
+    server->sendingId = NO_SERVER_CONNECTION;
+    server->port = port;
+    server->isListening = true;
+    sendNumberCommand(wifi, AT_SERVER_TIMEOUT, timeoutSeconds);  // idle connections are closed by module
+    return waitForResponseESP8266(wifi);
+}
+
+ResponseStatus stopServerESP8266(WiFi *wifi) {
+    uint32_t startMillis = currentMilliSeconds();
+    while (wifi->server.sendingId != NO_SERVER_CONNECTION) {    // started send continues until response timeout
+        if (currentMilliSeconds() - startMillis >= wifi->response->timeout) {
+            abortServerChunk(wifi);
+            break;
+        }
+        serveESP8266(wifi);
+    }
+    sendNumberCommand(wifi, AT_SERVER, 0);
+    wifi->server.isListening = false;
+    return waitForResponseESP8266(wifi);
+}
+
+bool writeServerConnectionESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length) {
+    if (id >= ESP8266_CONNECTION_COUNT) return false;
+    ServerConnection *connection = &wifi->server.connections[id];
+    if (connection->remainingLength > 0 || !(wifi->link.openSockets & (1U << id))) return false;
+    connection->data = data;
+    connection->remainingLength = length;
+    return true;
+}
+
+uint32_t pendingServerDataESP8266(WiFi *wifi, ConnectionID id) {
+    if (id >= ESP8266_CONNECTION_COUNT) return 0;
+    return wifi->server.connections[id].remainingLength;
+}
+
+void closeServerConnectionESP8266(WiFi *wifi, ConnectionID id) {
+    if (id >= ESP8266_CONNECTION_COUNT) return;
+    wifi->server.connections[id].isCloseRequested = true;
+}
+
+void serveESP8266(WiFi *wifi) {
+    pollESP8266(wifi);
+    ServerState *server = &wifi->server;
+    if (server->sendingId != NO_SERVER_CONNECTION) {
+        if (server->isPromptAwaited || wifi->isSendPending) return;
+        completeServerChunk(wifi);
+    }
+    startServerChunk(wifi);
+}
+
+static void startServerChunk(WiFi *wifi) {
+    ServerState *server = &wifi->server;
+    for (uint8_t i = 0; i < ESP8266_CONNECTION_COUNT; i++) {    // next connection after last served one, no connection can starve others
+        ConnectionID id = (server->nextId + i) % ESP8266_CONNECTION_COUNT;
+        ServerConnection *connection = &server->connections[id];
+        if (connection->remainingLength > 0) {
+            uint16_t chunkLength = (connection->remainingLength < ESP8266_SERVER_CHUNK_LENGTH) ? connection->remainingLength : ESP8266_SERVER_CHUNK_LENGTH;
+            METRICS_START_SEND(wifi);
+            CommandBuilder command = startQueuedCommand(wifi, AT_SOCKET_SEND);
+            appendNumber(&command, id);
+            appendNumber(&command, chunkLength);
+            if (!enqueueATCommand(wifi, &command, onServerSendPrompt, NULL)) return;
+            server->sendingId = id;
+            server->chunkLength = chunkLength;
+            server->isPromptAwaited = true;
+        } else if (connection->isCloseRequested) {
+            CommandBuilder command = startQueuedCommand(wifi, AT_SOCKET_CLOSE);
+            appendNumber(&command, id);
+            if (!enqueueATCommand(wifi, &command, NULL, NULL)) return;
+            connection->isCloseRequested = false;
+        } else {
+            continue;
+        }
+        server->nextId = (id + 1) % ESP8266_CONNECTION_COUNT;
+        return;
+    }
+}
+
+static void onServerSendPrompt(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) context;
+    ServerState *server = &wifi->server;
+    server->isPromptAwaited = false;
+    if (server->sendingId == NO_SERVER_CONNECTION) return;    // chunk was aborted, caller buffer may be gone
+    if (!isResponseStatusSuccess(status)) {     // connection closed before prompt
+        wifi->lastSendStatus = status;
+        return;
+    }
+
+    ServerConnection *connection = &server->connections[server->sendingId];
+    SendSegment chunk = {.data = connection->data, .length = server->chunkLength};
+    transmitPayload(wifi, &chunk, 1, false);
+    wifi->isSendPending = true;     // "SEND OK" is collected by pollESP8266()
+}
+
+static void completeServerChunk(WiFi *wifi) {
+    ServerState *server = &wifi->server;
+    ServerConnection *connection = &server->connections[server->sendingId];
+    if (isResponseStatusSuccess(wifi->lastSendStatus)) {
+        connection->data += server->chunkLength;
+        connection->remainingLength -= server->chunkLength;
+    } else {
+        connection->remainingLength = 0;    // connection is gone, drop rest of data
+    }
+    server->sendingId = NO_SERVER_CONNECTION;
+}
+
+static void abortServerChunk(WiFi *wifi) {  // module doesn't answer, rest of data is dropped
+    ServerState *server = &wifi->server;
+    server->connections[server->sendingId].remainingLength = 0;
+    server->sendingId = NO_SERVER_CONNECTION;
+    server->isPromptAwaited = false;
+    wifi->isSendPending = false;
+    wifi->lastSendStatus = ESP8266_RESPONSE_TIMEOUT;
+}
+
+uint32_t availableDataByIdESP8266(WiFi *wifi, ConnectionID id) {
+    if (id >= ESP8266_CONNECTION_COUNT) return 0;
+    ReceiveQueue *queue = &wifi->receiveQueue[id];
+    uint32_t head = queue->head;
+    return (head >= queue->tail) ? (head - queue->tail) : (ESP8266_RECEIVE_QUEUE_SIZE - queue->tail + head);
+}
+
+uint32_t readDataByIdESP8266(WiFi *wifi, ConnectionID id, char *buffer, uint32_t length) {
+    if (id >= ESP8266_CONNECTION_COUNT) return 0;
+    ReceiveQueue *queue = &wifi->receiveQueue[id];
+    uint32_t available = availableDataByIdESP8266(wifi, id);
+    uint32_t copyLength = (length < available) ? length : available;
+
+    uint32_t firstPartLength = ESP8266_RECEIVE_QUEUE_SIZE - queue->tail;   // copy up to buffer end, then wrap around
+    if (firstPartLength > copyLength) {
+        firstPartLength = copyLength;
+    }
+    memcpy(buffer, &queue->buffer[queue->tail], firstPartLength);
+    memcpy(&buffer[firstPartLength], queue->buffer, copyLength - firstPartLength);
+    queue->tail = (queue->tail + copyLength) % ESP8266_RECEIVE_QUEUE_SIZE;
+    return copyLength;
+}
+
+ResponseStatus beginTransparentStreamESP8266(WiFi *wifi) {
+    if (wifi->connectionMode != ESP8266_CONNECTION_SINGLE) return ESP8266_RESPONSE_ERROR;  // transparent transmission supports only single connection
+    ResponseStatus status = setApplicationModeESP8266(wifi, ESP8266_TRANSPARENT);
+    if (isResponseStatusSuccess(status)) {
+        sendPlainCommand(wifi, AT_SOCKET_SEND);    // no length, module waits for data until "+++"
+        status = waitForResponseESP8266(wifi);
+    }
+
+    if (isResponseStatusSuccess(status)) {
+        memset(&wifi->stream, 0, sizeof(struct TransparentStream));
+        wifi->stream.isActive = true;
+        wifi->stream.startTimeMillis = currentMilliSeconds();
+    }
+    return status;
+}
+
+uint32_t writeTransparentStreamESP8266(WiFi *wifi, const char *data, uint32_t length) {
+    TransparentStream *stream = &wifi->stream;
+    if (!stream->isActive || length == 0 || !isTransferCompleteUSART_DMA(wifi->USARTDma->txData)) return 0;
+
+    if (stream->packetLength == TRANSPARENT_PACKET_LENGTH) {   // full packet written, keep line silent until module sends it
+        if (!stream->isPacketGapStarted) {
+            stream->packetGapStartMillis = currentMilliSeconds();
+            stream->isPacketGapStarted = true;
+        }
+        if ((currentMilliSeconds() - stream->packetGapStartMillis) < ESP8266_TRANSPARENT_PACKET_GAP_MS) return 0;
+        stream->packetLength = 0;
+        stream->isPacketGapStarted = false;
+    }
+
+    uint32_t chunkLength = TRANSPARENT_PACKET_LENGTH - stream->packetLength;
+    if (chunkLength > length) {
+        chunkLength = length;
+    }
+    transmitData(wifi, (char *) data, chunkLength);
+    stream->packetLength += chunkLength;
+    stream->bytesWritten += chunkLength;
+    return chunkLength;
+}
+
+ResponseStatus endTransparentStreamESP8266(WiFi *wifi) {
+    static char exitSequence[] = TRANSPARENT_EXIT_SEQUENCE;
+    if (!wifi->stream.isActive) return ESP8266_RESPONSE_ERROR;
+
+    waitForTransmitComplete(wifi);
+    delay_ms(ESP8266_TRANSPARENT_PACKET_GAP_MS);   // "+++" should be received by module as separate packet
+    transmitData(wifi, exitSequence, strlen(exitSequence));
+    waitForTransmitComplete(wifi);
+    delay_ms(ESP8266_TRANSPARENT_EXIT_GUARD_MS);   // exit is blocking, module doesn't take commands before it
+    wifi->stream.isActive = false;
+    return setApplicationModeESP8266(wifi, ESP8266_NORMAL);
+}
+
+ResponseStatus closeConnectionESP8266(WiFi *wifi) {
+    if (wifi->connectionMode == ESP8266_CONNECTION_SINGLE) {
+        sendPlainCommand(wifi, AT_SOCKET_CLOSE);
+        return waitForResponseESP8266(wifi);
+    }
+    return ESP8266_RESPONSE_ERROR;
+}
+
+ResponseStatus closeConnectionByIdESP8266(WiFi *wifi, ConnectionID id) {//  ID no. of connection to close, when id=5, all connections will be closed.
+    if (wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE) {
+        sendNumberCommand(wifi, AT_SOCKET_CLOSE, id);
+        return waitForResponseESP8266(wifi);
+    }
+    return ESP8266_RESPONSE_ERROR;
+}
+
+void getLocalInfoESP8266(WiFi *wifi, LocalInfo *localInfo) {
+    sendPlainCommand(wifi, AT_LOCAL_INFO);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    if (isResponseStatusSuccess(status)) {
+        char accessPointIP[IP_ADDRESS_LENGTH + 1] = {0};
+        char accessPointMAC[MAC_ADDRESS_LENGTH + 1] = {0};
+        char localIP[IP_ADDRESS_LENGTH + 1] = {0};
+        char localMAC[MAC_ADDRESS_LENGTH + 1] = {0};
+
+        copyQuotedValue(wifi->response->responseBody, "APIP,\"", accessPointIP, IP_ADDRESS_LENGTH);
+        copyQuotedValue(wifi->response->responseBody, "APMAC,\"", accessPointMAC, MAC_ADDRESS_LENGTH);
+        copyQuotedValue(wifi->response->responseBody, "STAIP,\"", localIP, IP_ADDRESS_LENGTH);
+        copyQuotedValue(wifi->response->responseBody, "STAMAC,\"", localMAC, MAC_ADDRESS_LENGTH);
+
+        localInfo->accessPointIP = ipAddressFromString(accessPointIP);
+        localInfo->accessPointMAC = macAddressFromString(accessPointMAC);
+        localInfo->localIP = ipAddressFromString(localIP);
+        localInfo->localMAC = macAddressFromString(localMAC);
+    }
+}
+
+AccessPointList getAvailableAccessPointsESP8266(WiFi *wifi) {
+    AccessPointList accessPointList = {0};
+    scanAccessPointsESP8266(wifi, &accessPointList, NULL, NULL);
+    return accessPointList;
+}
+
+ResponseStatus scanAccessPointsESP8266(WiFi *wifi, AccessPointList *list, AccessPointCallback callback, void *context) {
+    ScanParser *parser = &wifi->scan;
+    if (!parser->isOptionSet) {     // strongest first and only parsed fields, shorter response
+        CommandBuilder command = startATCommand(wifi, AT_SCAN_OPTIONS);
+        appendNumber(&command, 1);
+        appendNumber(&command, SCAN_OUTPUT_MASK);
+        sendATCommand(wifi, &command);
+        parser->isOptionSet = isResponseStatusSuccess(waitForResponseESP8266(wifi));
+    }
+
+    parser->isStopped = false;
+    parser->lineState = SCAN_LINE_PREFIX;
+    parser->prefixLength = 0;
+    parser->list = list;
+    parser->callback = callback;
+    parser->context = context;
+    parser->isActive = true;    // entries are parsed as they arrive, response body is not modified
+
+    requestAvailableAccessPointsESP8266(wifi);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    parser->isActive = false;
+    return status;
+}
+
+ResponseStatus enableSoftApESP8266(WiFi *wifi, char *ssid, char *password, uint8_t channel, WifiEncryptionType encryption) {
+    sendPlainCommand(wifi, AT_SOFT_AP_QUERY);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    if (!isResponseStatusError(status)) return status;
+
+    if (isSsidValid(ssid) && isPasswordValid(password)) {
+        CommandBuilder command = startATCommand(wifi, wifi->isNeedToSaveCredentials ? AT_SOFT_AP_DEFAULT : AT_SOFT_AP_CURRENT);
+        appendQuoted(&command, ssid);
+        appendQuoted(&command, password);
+        appendNumber(&command, channel);
+        appendNumber(&command, encryption);
+        sendATCommand(wifi, &command);
+        return waitForResponseESP8266(wifi);
+    }
+    return ESP8266_RESPONSE_ERROR;
+}
+
+ResponseStatus enableOpenSoftApESP8266(WiFi *wifi, char *ssid, uint8_t channel) {
+    if (isSsidValid(ssid)) {
+        CommandBuilder command = startATCommand(wifi, wifi->isNeedToSaveCredentials ? AT_SOFT_AP_DEFAULT : AT_SOFT_AP_CURRENT);
+        appendQuoted(&command, ssid);
+        appendQuoted(&command, "");     // no password
+        appendNumber(&command, channel);
+        appendNumber(&command, ESP8266_ENCRYPTION_OPEN);
+        sendATCommand(wifi, &command);
+        return waitForResponseESP8266(wifi);
+    }
+    return ESP8266_RESPONSE_ERROR;
+}
+
+ResponseStatus refreshSoftApClientsESP8266(WiFi *wifi) {
+    sendPlainCommand(wifi, AT_SOFT_AP_CLIENTS);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    if (!isResponseStatusSuccess(status)) return status;    // previous snapshot is kept
+
+    SoftApClientTable *table = &wifi->softApClients;
+    SoftAPClient previousClients[ESP8266_SOFT_AP_CLIENT_COUNT];
+    uint8_t previousSize = table->size;
+    memcpy(previousClients, table->clients, previousSize * sizeof(struct SoftAPClient));
+    parseSoftApClients(wifi->response->responseBody, table);
+    diffSoftApClients(table, previousClients, previousSize);
+    return status;
+}
+
+uint8_t numberOfConnectedClientsESP8266(WiFi *wifi) {
+    if (!isResponseStatusSuccess(refreshSoftApClientsESP8266(wifi))) return 0;
+    return wifi->softApClients.size;
+}
+
+SoftAPClient getSoftApClientInfo(WiFi *wifi, uint8_t clientNumber) {
+    SoftAPClient softApClient = {0};
+    if (clientNumber < wifi->softApClients.size) {
+        softApClient = wifi->softApClients.clients[clientNumber];
+    }
+    return softApClient;
+}
+
+static void copyQuotedValue(const char *responseBody, const char *prefix, char *value, uint32_t maxLength) {  // text after prefix up to closing quote, empty if prefix not found
+    const char *start = strstr(responseBody, prefix);
+    if (start == NULL) return;
+    start += strlen(prefix);
+    uint32_t length = 0;
+    while (length < maxLength && start[length] != '"' && start[length] != '\0') {
+        value[length] = start[length];
+        length++;
+    }
+    value[length] = '\0';
+}
+
+static void parseSoftApClients(const char *responseBody, SoftApClientTable *table) {    // "<ip>,<mac>" line per station, single pass
+    table->size = 0;
+    table->isTruncated = false;
+    const char *linePointer = responseBody;
+    const char *lineEnd;
+    while ((lineEnd = strstr(linePointer, NEW_LINE)) != NULL) {
+        const char *separator = memchr(linePointer, ',', lineEnd - linePointer);
+        uint32_t ipLength = (separator != NULL) ? separator - linePointer : 0;
+        uint32_t macLength = (separator != NULL) ? lineEnd - separator - 1 : 0;
+
+        if (ipLength > 0 && ipLength <= IP_ADDRESS_LENGTH && macLength == MAC_ADDRESS_LENGTH) {     // status lines are skipped
+            if (table->size == ESP8266_SOFT_AP_CLIENT_COUNT) {
+                table->isTruncated = true;
+                return;
+            }
+            char ipAddress[IP_ADDRESS_LENGTH + 1];
+            char macAddress[MAC_ADDRESS_LENGTH + 1];
+            memcpy(ipAddress, linePointer, ipLength);
+            ipAddress[ipLength] = '\0';
+            memcpy(macAddress, separator + 1, MAC_ADDRESS_LENGTH);
+            macAddress[MAC_ADDRESS_LENGTH] = '\0';
+
+            SoftAPClient *client = &table->clients[table->size++];
+            client->clientIP = ipAddressFromString(ipAddress);
+            client->clientMac = macAddressFromString(macAddress);
+        }
+        linePointer = lineEnd + 2;
+    }
+}
+
+static void diffSoftApClients(SoftApClientTable *table, const SoftAPClient *previousClients, uint8_t previousSize) {
+    bool isStillConnected[ESP8266_SOFT_AP_CLIENT_COUNT] = {0};
+    table->joinedMask = 0;
+    for (uint8_t i = 0; i < table->size; i++) {
+        bool isKnown = false;
+        for (uint8_t j = 0; j < previousSize; j++) {   // both tables are bounded by capacity, cost doesn't grow with response
+            if (!isStillConnected[j] && isSameSoftApClient(&table->clients[i], &previousClients[j])) {
+                isStillConnected[j] = true;
+                isKnown = true;
+                break;
+            }
+        }
+        if (!isKnown) {
+            table->joinedMask |= (1U << i);
+        }
+    }
+
+    table->leftCount = 0;
+    for (uint8_t j = 0; j < previousSize; j++) {
+        if (!isStillConnected[j]) {
+            table->leftClients[table->leftCount++] = previousClients[j];
+        }
+    }
+}
+
+static inline bool isSameSoftApClient(const SoftAPClient *client, const SoftAPClient *otherClient) {  // station is identified by MAC, IP can be reassigned
+    return memcmp(&client->clientMac, &otherClient->clientMac, sizeof(struct MACAddress)) == 0;
+}
+
+void setSoftApIP(WiFi *wifi, char *ipAddress) {
+    if (isIPv4AddressValid(ipAddress)) {
+        CommandBuilder command = startATCommand(wifi, AT_SOFT_AP_IP);
+        appendQuoted(&command, ipAddress);
+        sendATCommand(wifi, &command);
+    }
+}
+
+void pingPacketESP8266(WiFi *wifi, char *host) {
+    CommandBuilder command = startATCommand(wifi, AT_PING);
+    appendQuoted(&command, host);
+    sendATCommand(wifi, &command);
+}
+
+int32_t getPacketPingTimeESP8266(WiFi *wifi) {
+    return parsePingTime(wifi->response->responseBody);
+}
+
+bool startPowerSchedulerESP8266(WiFi *wifi, SleepMode mode, uint32_t wakeIntervalMillis, ConnectionID id, const SocketConfig *endpoint) {
+    if (endpoint == NULL || wifi->power.isActive) return false;
+    if (mode == ESP8266_SLEEP_LIGHT) return false;  // driver has no wake up GPIO, module wouldn't take wake window commands
+    if (endpoint->host == NULL || strlen(endpoint->host) > ESP8266_HOST_MAX_LENGTH) return false;
+    if (wifi->connectionMode == ESP8266_CONNECTION_SINGLE) {
+        id = CONNECTION_ID_0;
+    } else if (id >= ESP8266_CONNECTION_COUNT) {
+        return false;
+    }
+    ResponseStatus status = setSleepModeESP8266(wifi, mode);
+    if (!isResponseStatusSuccess(status)) return false;
+
+    PowerScheduler *power = &wifi->power;
+    memset(power, 0, sizeof(struct PowerScheduler));
+    strcpy(power->host, endpoint->host);
+    power->endpoint = *endpoint;
+    power->endpoint.host = power->host;
+    power->id = id;
+    power->mode = mode;
+    power->wakeIntervalMillis = wakeIntervalMillis;
+    power->stateStartMillis = currentMilliSeconds();
+    power->nextWakeMillis = power->stateStartMillis + wakeIntervalMillis;
+    power->isSleeping = (mode != ESP8266_SLEEP_DISABLED);
+    power->isActive = true;
+    return true;
+}
+
+void stopPowerSchedulerESP8266(WiFi *wifi) {
+    PowerScheduler *power = &wifi->power;
+    if (!power->isActive) return;
+    flushCommandQueueESP8266(wifi);     // window command after ">" prompt still sends payload from batch
+    accountPowerState(wifi, currentMilliSeconds());
+    power->isActive = false;
+    power->isSleeping = false;
+    power->isCommandPending = false;
+    power->step = ESP8266_POWER_WINDOW_IDLE;
+    power->batchSize = 0;
+    power->sendingCount = 0;
+    setSleepModeESP8266(wifi, ESP8266_SLEEP_DISABLED);
+}
+
+bool queuePowerSendESP8266(WiFi *wifi, const char *data, uint32_t length) {
+    PowerScheduler *power = &wifi->power;
+    if (!power->isActive || power->batchSize == ESP8266_POWER_BATCH_SIZE || data == NULL || length == 0 || length > MAX_SEND_DATA_LENGTH) return false;
+    power->batch[power->batchSize].data = data;
+    power->batch[power->batchSize].length = length;
+    power->batchSize++;
+    return true;
+}
+
+void schedulePowerESP8266(WiFi *wifi) {
+    pollESP8266(wifi);  // received data and link changes are still dispatched while module sleeps
+    PowerScheduler *power = &wifi->power;
+    if (!power->isActive || power->isCommandPending || wifi->isSendPending) return;    // previous window command or "SEND OK" is awaited
+
+    if (power->step == ESP8266_POWER_WINDOW_IDLE) {
+        uint32_t currentMillis = currentMilliSeconds();
+        bool isWakeTime = (int32_t) (currentMillis - power->nextWakeMillis) >= 0;
+        if (isWakeTime && power->batchSize == 0) {
+            power->nextWakeMillis = currentMillis + power->wakeIntervalMillis;    // nothing to send, don't wake up for next first send
+            return;
+        }
+        if (!isWakeTime && power->batchSize < ESP8266_POWER_BATCH_SIZE) return;
+        startWakeWindow(wifi);
+    }
+
+    PowerWindowStep step;
+    do {    // steps without module command run right away, full queue leaves step for next tick
+        step = power->step;
+        advanceWakeWindow(wifi);
+    } while (!power->isCommandPending && power->step != step && power->step != ESP8266_POWER_WINDOW_IDLE);
+}
+
+PowerReport getPowerReportESP8266(WiFi *wifi) {
+    PowerScheduler *power = &wifi->power;
+    if (power->isActive) {
+        accountPowerState(wifi, currentMilliSeconds());
+    }
+
+    PowerReport *report = &power->report;
+    uint64_t elapsedMillis = (uint64_t) report->awakeMillis + report->sleepMillis;
+    if (elapsedMillis > 0) {
+        uint64_t radioOnMillis = report->awakeMillis
+                + ((uint64_t) report->sleepMillis * ESP8266_POWER_SLEEP_DUTY_PERMILLE) / 1000
+                + ((uint64_t) report->warmSleepMillis * ESP8266_POWER_IDLE_LINK_PERMILLE) / 1000;
+        report->radioOnMillisPerHour = (radioOnMillis * 3600000) / elapsedMillis;
+    }
+    return *report;
+}
+
+static void startWakeWindow(WiFi *wifi) {
+    PowerScheduler *power = &wifi->power;
+    uint32_t wakeMillis = currentMilliSeconds();
+    accountPowerState(wifi, wakeMillis);
+    if (power->report.wakeups > 0) {
+        uint32_t gapMillis = wakeMillis - power->lastWakeMillis;
+        power->windowGapMillis = (power->windowGapMillis == 0) ? gapMillis : (power->windowGapMillis * 3 + gapMillis) / 4;
+    }
+    power->lastWakeMillis = wakeMillis;
+    power->report.wakeups++;
+    power->isSleeping = false;
+    power->step = ESP8266_POWER_WINDOW_WAKE;
+}
+
+static void advanceWakeWindow(WiFi *wifi) {     // queues at most one command, its callback records result for next step
+    PowerScheduler *power = &wifi->power;
+    switch (power->step) {
+        case ESP8266_POWER_WINDOW_WAKE:
+            if (power->mode == ESP8266_SLEEP_DISABLED) {
+                power->step = ESP8266_POWER_WINDOW_CONNECT;
+            } else if (enqueuePowerSleepMode(wifi, ESP8266_SLEEP_DISABLED, onPowerCommand)) {  // full radio for window, sends are not delayed until next beacon
+                power->step = ESP8266_POWER_WINDOW_CONNECT;
+            }
+            return;
+        case ESP8266_POWER_WINDOW_CONNECT:
+            if (wifi->link.openSockets & (1U << power->id)) {
+                power->report.warmWindows++;
+                power->step = ESP8266_POWER_WINDOW_SEND;
+                return;
+            }
+            power->connectStartMillis = currentMilliSeconds();
+            if (power->endpoint.type == ESP8266_SOCKET_SSL && power->endpoint.sslBufferSize > 0) {
+                CommandBuilder command = startQueuedCommand(wifi, AT_SSL_BUFFER_SIZE);
+                appendNumber(&command, power->endpoint.sslBufferSize);
+                power->isCommandPending = enqueueATCommand(wifi, &command, onPowerSslBuffer, NULL);
+                if (!power->isCommandPending) return;
+            }
+            power->step = ESP8266_POWER_WINDOW_OPEN;
+            return;
+        case ESP8266_POWER_WINDOW_OPEN: {
+            CommandBuilder command = startQueuedCommand(wifi, AT_SOCKET_START);     // host length is checked on start, always fits slot
+            appendSocketStart(&command, wifi, power->id, &power->endpoint);
+            power->isCommandPending = enqueueATCommand(wifi, &command, onPowerConnect, NULL);
+            if (power->isCommandPending) {
+                power->step = ESP8266_POWER_WINDOW_SEND;
+            }
+            return;
+        }
+        case ESP8266_POWER_WINDOW_SEND:
+            if (power->sendingCount > 0) {
+                completePowerSend(wifi);
+            }
+            if (power->step == ESP8266_POWER_WINDOW_SEND) {
+                enqueuePowerSend(wifi);
+            }
+            return;
+        case ESP8266_POWER_WINDOW_CLOSE: {
+            if (isLinkWorthKeeping(power)) {
+                power->step = ESP8266_POWER_WINDOW_SLEEP;
+                return;
+            }
+            CommandBuilder command = startQueuedCommand(wifi, AT_SOCKET_CLOSE);
+            if (wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE) {
+                appendNumber(&command, power->id);
+            }
+            power->isCommandPending = enqueueATCommand(wifi, &command, onPowerClose, NULL);
+            if (power->isCommandPending) {
+                power->step = ESP8266_POWER_WINDOW_SLEEP;
+            }
+            return;
+        }
+        case ESP8266_POWER_WINDOW_SLEEP:
+            if (power->mode == ESP8266_SLEEP_DISABLED) {
+                finishWakeWindow(wifi);
+            } else {
+                enqueuePowerSleepMode(wifi, power->mode, onPowerSleep);
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+static void finishWakeWindow(WiFi *wifi) {
+    PowerScheduler *power = &wifi->power;
+    uint32_t currentMillis = currentMilliSeconds();
+    accountPowerState(wifi, currentMillis);
+    power->isSleeping = (power->mode != ESP8266_SLEEP_DISABLED);
+    power->step = ESP8266_POWER_WINDOW_IDLE;
+    power->nextWakeMillis = currentMillis + power->wakeIntervalMillis;
+}
+
+static void enqueuePowerSend(WiFi *wifi) {
+    PowerScheduler *power = &wifi->power;
+    if (power->batchSize == 0) {
+        power->step = ESP8266_POWER_WINDOW_CLOSE;
+        return;
+    }
+
+    uint8_t segmentCount = 1;
+    uint32_t length = power->batch[0].length;
+    if (power->endpoint.type != ESP8266_SOCKET_UDP) {  // stream socket, small sends share one AT+CIPSEND, datagrams keep boundaries
+        while (segmentCount < power->batchSize && length + power->batch[segmentCount].length <= MAX_SEND_DATA_LENGTH) {
+            length += power->batch[segmentCount].length;
+            segmentCount++;
+        }
+    }
+
+    METRICS_START_SEND(wifi);
+    CommandBuilder command = startQueuedCommand(wifi, AT_SOCKET_SEND);
+    if (wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE) {
+        appendNumber(&command, power->id);
+    }
+    appendNumber(&command, length);
+    power->isCommandPending = enqueueATCommand(wifi, &command, onPowerSendPrompt, NULL);
+    if (power->isCommandPending) {
+        power->sendingCount = segmentCount;
+    }
+}
+
+static void completePowerSend(WiFi *wifi) {
+    PowerScheduler *power = &wifi->power;
+    if (isResponseStatusSuccess(wifi->lastSendStatus)) {
+        power->report.batchedSends += power->sendingCount;
+        power->batchSize -= power->sendingCount;
+        memmove(power->batch, &power->batch[power->sendingCount], power->batchSize * sizeof(struct SendSegment));
+    } else {
+        power->step = ESP8266_POWER_WINDOW_CLOSE;   // unsent data is kept for next window
+    }
+    power->sendingCount = 0;
+}
+
+static bool enqueuePowerSleepMode(WiFi *wifi, SleepMode mode, CommandCallback callback) {
+    CommandBuilder command = startQueuedCommand(wifi, AT_SLEEP);
+    appendNumber(&command, mode);
+    wifi->power.isCommandPending = enqueueATCommand(wifi, &command, callback, NULL);
+    return wifi->power.isCommandPending;
+}
+
+static void onPowerCommand(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) status;
+    (void) context;
+    wifi->power.isCommandPending = false;
+}
+
+static void onPowerSslBuffer(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) context;
+    PowerScheduler *power = &wifi->power;
+    power->isCommandPending = false;
+    if (isResponseStatusError(status)) {    // socket would start with default buffer and fail handshake
+        power->step = ESP8266_POWER_WINDOW_SLEEP;
+    }
+}
+
+static void onPowerConnect(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) context;
+    PowerScheduler *power = &wifi->power;
+    power->isCommandPending = false;
+    if (!isResponseStatusSuccess(status) && !wifi->response->matcher.isAlreadyConnected) {  // "ALREADY CONNECTED" means close was missed
+        power->step = ESP8266_POWER_WINDOW_SLEEP;   // unsent data is kept for next window
+        return;
+    }
+
+    uint32_t connectMillis = currentMilliSeconds() - power->connectStartMillis;
+    power->reconnectMillis = (power->reconnectMillis == 0) ? connectMillis : (power->reconnectMillis * 3 + connectMillis) / 4;
+    power->report.reconnects++;
+    wifi->link.openSockets |= (1U << power->id);
+}
+
+static void onPowerSendPrompt(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) context;
+    PowerScheduler *power = &wifi->power;
+    power->isCommandPending = false;
+    if (!isResponseStatusSuccess(status)) {     // socket closed before prompt
+        wifi->lastSendStatus = status;
+        return;
+    }
+    transmitPayload(wifi, power->batch, power->sendingCount, false);
+    wifi->isSendPending = true;     // "SEND OK" is collected by pollESP8266(), radio goes back to sleep only after it
+}
+
+static void onPowerClose(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) context;
+    wifi->power.isCommandPending = false;
+    if (isResponseStatusSuccess(status)) {
+        wifi->link.openSockets &= ~(1U << wifi->power.id);
+    }
+}
+
+static void onPowerSleep(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) status;
+    (void) context;
+    wifi->power.isCommandPending = false;
+    finishWakeWindow(wifi);
+}
+
+static bool isLinkWorthKeeping(PowerScheduler *power) {  // idle socket costs radio time until next window, reopen costs connect time
+    if (power->reconnectMillis == 0) return true;   // socket was never reopened, no cost measured
+    uint32_t idleMillis = (power->windowGapMillis > 0) ? power->windowGapMillis : power->wakeIntervalMillis;
+    uint64_t idleCostMillis = ((uint64_t) idleMillis * ESP8266_POWER_IDLE_LINK_PERMILLE) / 1000;
+    return idleCostMillis < power->reconnectMillis;
+}
+
+static void accountPowerState(WiFi *wifi, uint32_t currentMillis) {
+    PowerScheduler *power = &wifi->power;
+    uint32_t elapsedMillis = currentMillis - power->stateStartMillis;
+    power->stateStartMillis = currentMillis;
+    if (!power->isSleeping) {
+        power->report.awakeMillis += elapsedMillis;
+        return;
+    }
+    power->report.sleepMillis += elapsedMillis;
+    if (wifi->link.openSockets & (1U << power->id)) {
+        power->report.warmSleepMillis += elapsedMillis;
+    }
+}
+
+bool startPingESP8266(WiFi *wifi, const char *host, uint16_t probeCount, uint16_t intervalMillis) {
+    PingEngine *engine = &wifi->ping;
+    if (engine->isActive || host == NULL || strlen(host) > ESP8266_HOST_MAX_LENGTH || probeCount == 0) return false;
+
+    bool isProbePending = engine->isProbePending;   // probe of stopped ping can still be in queue
+    uint16_t generation = engine->generation + 1;
+    memset(engine, 0, sizeof(struct PingEngine));
+    engine->generation = generation;
+    strcpy(engine->host, host);
+    engine->probeCount = probeCount;
+    engine->intervalMillis = intervalMillis;
+    engine->nextProbeMillis = currentMilliSeconds();
+    engine->previousMillis = ESP8266_PING_PACKET_TIMEOUT_VALUE;
+    engine->statistics.lastMillis = ESP8266_PING_PACKET_TIMEOUT_VALUE;
+    engine->isProbePending = isProbePending;
+    engine->isActive = true;
+    return true;
+}
+
+void stopPingESP8266(WiFi *wifi) {
+    wifi->ping.isActive = false;
+}
+
+bool pollPingESP8266(WiFi *wifi) {
+    pollESP8266(wifi);
+    PingEngine *engine = &wifi->ping;
+    if (!engine->isActive) return engine->statistics.isComplete;
+
+    uint32_t currentMillis = currentMilliSeconds();
+    if (!engine->isProbePending && engine->statistics.sent < engine->probeCount && (int32_t) (currentMillis - engine->nextProbeMillis) >= 0) {
+        startPingProbe(wifi, currentMillis);
+    }
+    return false;
+}
+
+PingStatistics getPingStatisticsESP8266(WiFi *wifi) {
+    return wifi->ping.statistics;
+}
+
+static void startPingProbe(WiFi *wifi, uint32_t currentMillis) {
+    PingEngine *engine = &wifi->ping;
+    CommandBuilder command = startQueuedCommand(wifi, AT_PING);
+    appendQuoted(&command, engine->host);
+    if (!enqueueATCommand(wifi, &command, onPingProbe, (void *) (uintptr_t) engine->generation)) return;   // queue is full, retry on next poll
+
+    engine->isProbePending = true;
+    engine->statistics.sent++;
+    engine->nextProbeMillis = currentMillis + engine->intervalMillis;   // interval between probe starts
+}
+
+static void onPingProbe(WiFi *wifi, ResponseStatus status, void *context) {
+    PingEngine *engine = &wifi->ping;
+    engine->isProbePending = false;
+    if (!engine->isActive || (uint16_t) (uintptr_t) context != engine->generation) return;  // stopped while probe was in flight
+
+    int32_t roundTripMillis = isResponseStatusSuccess(status) ? parsePingTime(wifi->response->responseBody) : ESP8266_PING_PACKET_TIMEOUT_VALUE;
+    recordPingSample(engine, roundTripMillis);
+    if (engine->statistics.received + engine->statistics.lost == engine->probeCount) {
+        engine->statistics.isComplete = true;
+        engine->isActive = false;
+    }
+}
+
+static void recordPingSample(PingEngine *engine, int32_t roundTripMillis) {
+    PingStatistics *statistics = &engine->statistics;
+    statistics->lastMillis = roundTripMillis;
+    if (roundTripMillis == ESP8266_PING_PACKET_TIMEOUT_VALUE) {
+        statistics->lost++;
+    } else {
+        uint32_t sample = roundTripMillis;
+        if (statistics->received == 0 || sample < statistics->minMillis) {
+            statistics->minMillis = sample;
+        }
+        if (sample > statistics->maxMillis) {
+            statistics->maxMillis = sample;
+        }
+        statistics->received++;
+        engine->totalMillis += sample;
+        statistics->avgMillis = engine->totalMillis / statistics->received;
+
+        if (engine->previousMillis != ESP8266_PING_PACKET_TIMEOUT_VALUE) {   // lost probes are skipped, delta is between received ones
+            int32_t delta = roundTripMillis - engine->previousMillis;
+            engine->totalDeltaMillis += (delta < 0) ? -delta : delta;
+            statistics->jitterMillis = engine->totalDeltaMillis / (statistics->received - 1);
+        }
+        engine->previousMillis = roundTripMillis;
+    }
+    statistics->lossPercent = (statistics->lost * 100U) / (statistics->received + statistics->lost);
+}
+
+static int32_t parsePingTime(const char *responseBody) {   // "+<time>" or "+PING:<time>", "+timeout" when host doesn't reply
+    for (const char *tokenPointer = strchr(responseBody, '+'); tokenPointer != NULL; tokenPointer = strchr(tokenPointer + 1, '+')) {
+        const char *timePointer = tokenPointer + 1;
+        if (strncmp(timePointer, "PING:", 5) == 0) {
+            timePointer += 5;
+        }
+        if (*timePointer >= '0' && *timePointer <= '9') {
+            return strtol(timePointer, NULL, 10);   // parse extracted token, not whole buffer
+        }
+    }
+    return ESP8266_PING_PACKET_TIMEOUT_VALUE;
+}
+
+void deleteESP8266(WiFi *wifi) {
+    if (wifi == NULL) return;
+    if (wifi->isStaticallyAllocated) {  // storage can be reused, transport is no longer reached from interrupts
+        releaseUSART_DMA(wifi->USARTDma);
+        return;
+    }
+    deleteUSART_DMA(wifi->USARTDma);    // no need to free every pointer in struct, it will be deallocated at USART side
+    ESP8266_FREE(wifi->response);
+    ESP8266_FREE(wifi->request);
+    ESP8266_FREE(wifi);
+}
+
+static inline bool isSsidValid(char *ssid) {
+    return (ssid != NULL && strlen(ssid) < MAX_SSID_LENGTH);
+}
+
+static inline bool isPasswordValid(char *password) {
+    return (password != NULL && strlen(password) < MAX_PASSWORD_LENGTH);
+}
+
+static void setupWifiInstance(WiFi *wifiInstance) {
+    wifiInstance->request->id = CONNECTION_ID_0;
+    wifiInstance->request->dataLength = 0;
+    wifiInstance->request->isBinary = false;
+    wifiInstance->request->requestBody = wifiInstance->USARTDma->txData->bufferPointer;
+    wifiInstance->request->bufferSize = wifiInstance->USARTDma->txData->bufferSize;
+
+    wifiInstance->response->startTimeMillis = 0;
+    wifiInstance->response->isServerResponseAwaited = false;
+    wifiInstance->response->responseBody = wifiInstance->USARTDma->rxData->bufferPointer;
+    wifiInstance->response->bufferSize = wifiInstance->USARTDma->rxData->bufferSize;
+    wifiInstance->response->responseLength = 0;
+    resetResponseMatcher(wifiInstance->response);
+
+    wifiInstance->isNeedToSaveCredentials = false;
+    wifiInstance->connectionMode = ESP8266_CONNECTION_SINGLE;
+    memset(&wifiInstance->framer, 0, sizeof(struct IPDFramer));
+    memset(wifiInstance->receiveQueue, 0, sizeof(wifiInstance->receiveQueue));
+    memset(&wifiInstance->stream, 0, sizeof(struct TransparentStream));
+    wifiInstance->isSendPending = false;
+    wifiInstance->lastSendStatus = ESP8266_RESPONSE_SUCCESS;
+    memset(&wifiInstance->server, 0, sizeof(struct ServerState));
+    wifiInstance->server.sendingId = NO_SERVER_CONNECTION;
+    memset(&wifiInstance->commandQueue, 0, sizeof(struct CommandQueue));
+    memset(&wifiInstance->urc, 0, sizeof(struct UrcDispatcher));
+    memset(&wifiInstance->link, 0, sizeof(struct LinkState));
+    memset(&wifiInstance->scan, 0, sizeof(struct ScanParser));
+    clearKnownNetworksESP8266(wifiInstance);
+    memset(&wifiInstance->supervisor, 0, sizeof(struct LinkSupervisor));
+#if defined(ESP8266_ENABLE_METRICS)
+    resetMetricsESP8266(wifiInstance);
+#endif
+#if defined(ESP8266_ENABLE_TRACE)
+    clearTraceESP8266(wifiInstance);
+#endif
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    startRxRing(wifiInstance);
+#else
+    startReceiveESP8266(wifiInstance);  // received length is counted from first arm
+#endif
+    dwtDelayInit();
+
+    memset(&wifiInstance->init, 0, sizeof(struct InitProgress));
+    wifiInstance->init.phase = ESP8266_INIT_STARTUP;
+    wifiInstance->init.phaseStartMillis = currentMilliSeconds();
+    wifiInstance->response->timeout = ESP8266_INIT_STEP_TIMEOUT_MS;
+}
+
+static void switchInitPhase(WiFi *wifi, InitPhase nextPhase, uint32_t currentMillis) {
+    InitProgress *init = &wifi->init;
+    init->phaseTimeMillis[init->phase] = currentMillis - init->phaseStartMillis;   // time spent, including retries
+    init->phase = nextPhase;
+    init->phaseStartMillis = currentMillis;
+    init->retryAtMillis = currentMillis;
+    init->attempt = 0;
+
+    if (nextPhase == ESP8266_INIT_READY || nextPhase == ESP8266_INIT_FAILED) {
+        wifi->response->timeout = ESP8266_RESPONSE_DEFAULT_TIMEOUT_MS;
+    }
+}
+
+static void sendInitCommand(WiFi *wifi, InitPhase phase) {
+    switch (phase) {
+        case ESP8266_INIT_HEALTH_CHECK:
+            sendPlainCommand(wifi, AT_HEALTH_CHECK);
+            break;
+        case ESP8266_INIT_ECHO_OFF:
+            sendPlainCommand(wifi, AT_ECHO_OFF);  // Disable echo (don’t send back received command)
+            break;
+        case ESP8266_INIT_WIFI_MODE:
+            sendNumberCommand(wifi, AT_WIFI_MODE, ESP8266_STATION_AND_ACCESS_POINT);
+            break;
+        case ESP8266_INIT_CONNECTION_MODE:
+            sendNumberCommand(wifi, AT_CONNECTION_MODE, ESP8266_CONNECTION_SINGLE);
+            wifi->connectionMode = ESP8266_CONNECTION_SINGLE;
+            break;
+        case ESP8266_INIT_TRANSFER_MODE:
+            sendNumberCommand(wifi, AT_TRANSFER_MODE, ESP8266_NORMAL);
+            break;
+        default:
+            break;
+    }
+}
+
+static CommandBuilder startATCommand(WiFi *wifi, ATCommandType type) {
+    flushCommandQueueESP8266(wifi);   // blocking command should not interleave with queued ones
+    return beginCommand(wifi->commandLane, ESP8266_COMMAND_MAX_LENGTH, type);  // TX buffer keeps request body, DMA stream is never reconfigured
+}
+
+static void sendATCommand(WiFi *wifi, CommandBuilder *command) {    // send built command to ESP8266
+    uint32_t length = finishCommand(command);
+    if (length == 0) {  // truncated command is never transmitted, waiter gets error without timeout
+        completePendingSend(wifi);
+        clearResponseESP8266(wifi);
+        wifi->response->matcher.isCommandDropped = true;
+        return;
+    }
+    transmitATCommand(wifi, command->buffer, length);
+}
+
+static void sendPlainCommand(WiFi *wifi, ATCommandType type) {
+    CommandBuilder command = startATCommand(wifi, type);
+    sendATCommand(wifi, &command);
+}
+
+static void sendNumberCommand(WiFi *wifi, ATCommandType type, uint32_t value) {
+    CommandBuilder command = startATCommand(wifi, type);
+    appendNumber(&command, value);
+    sendATCommand(wifi, &command);
+}
+
+static void sendPayloadLength(WiFi *wifi, ConnectionID id, uint32_t length, bool isConnectionIdRequired) {
+    METRICS_START_SEND(wifi);
+    CommandBuilder command = startATCommand(wifi, AT_SOCKET_SEND);
+    if (isConnectionIdRequired) {
+        appendNumber(&command, id);
+    }
+    appendNumber(&command, length);
+    sendATCommand(wifi, &command);
+}
+
+static CommandBuilder startQueuedCommand(WiFi *wifi, ATCommandType type) {  // built in place, slot is taken only by enqueueATCommand()
+    CommandQueue *queue = &wifi->commandQueue;
+    if (queue->size == ESP8266_COMMAND_QUEUE_SIZE) {
+        return (CommandBuilder) {.isOverflow = true};
+    }
+    QueuedCommand *slot = &queue->commands[(queue->head + queue->size) % ESP8266_COMMAND_QUEUE_SIZE];
+    return beginCommand(slot->command, ESP8266_COMMAND_MAX_LENGTH, type);
+}
+
+static bool enqueueATCommand(WiFi *wifi, CommandBuilder *command, CommandCallback callback, void *context) {
+    uint32_t length = finishCommand(command);
+    return length > 0 && commitQueuedCommand(wifi, length, callback, context);
+}
+
+static bool commitQueuedCommand(WiFi *wifi, uint32_t length, CommandCallback callback, void *context) {
+    CommandQueue *queue = &wifi->commandQueue;
+    QueuedCommand *command = &queue->commands[(queue->head + queue->size) % ESP8266_COMMAND_QUEUE_SIZE];
+    command->length = length;
+    command->timeout = wifi->response->timeout;
+    command->callback = callback;
+    command->context = context;
+    queue->size++;
+
+    if (!queue->isInFlight && !wifi->isSendPending) {   // line is free, send immediately, otherwise pollESP8266() sends it after "SEND OK"
+        transmitQueuedCommand(wifi);
+    }
+    return true;
+}
+
+static CommandBuilder beginCommand(char *buffer, uint32_t capacity, ATCommandType type) {
+    const ATCommandDescriptor *descriptor = &AT_COMMANDS[type];
+    CommandBuilder command = {.buffer = buffer};
+    if (capacity < descriptor->length + 2U) {    // no space for name with line end
+        command.isOverflow = true;
+        return command;
+    }
+    command.capacity = capacity - 2;
+    memcpy(buffer, descriptor->value, descriptor->length);
+    command.length = descriptor->length;
+    return command;
+}
+
+static uint32_t finishCommand(CommandBuilder *command) {     // ESP8266 expects <CR><LF> at the end of each command
+    if (command->isOverflow) return 0;
+    memcpy(&command->buffer[command->length], NEW_LINE, 2);   // space is reserved by beginCommand()
+    return command->length + 2;
+}
+
+static void appendSymbol(CommandBuilder *command, char symbol) {
+    if (command->length < command->capacity) {
+        command->buffer[command->length++] = symbol;
+    } else {
+        command->isOverflow = true;
+    }
+}
+
+static void appendSeparator(CommandBuilder *command) {
+    appendSymbol(command, (command->argumentCount == 0) ? '=' : ',');
+    command->argumentCount++;
+}
+
+static void appendNumber(CommandBuilder *command, uint32_t value) {
+    char digits[10];    // UINT32_MAX has 10 digits
+    uint8_t digitCount = 0;
+    do {
+        digits[digitCount++] = (char) ('0' + (value % 10));
+        value /= 10;
+    } while (value > 0);
+
+    appendSeparator(command);
+    while (digitCount > 0) {
+        appendSymbol(command, digits[--digitCount]);
+    }
+}
+
+static void appendQuoted(CommandBuilder *command, const char *value) {  // ssid, password and host from user can contain any printable symbol
+    appendSeparator(command);
+    appendSymbol(command, '"');
+    for (; *value != '\0'; value++) {
+        if (*value == '"' || *value == ',' || *value == '\\') {
+            appendSymbol(command, '\\');
+        }
+        appendSymbol(command, *value);
+    }
+    appendSymbol(command, '"');
+}
+
+static void transmitATCommand(WiFi *wifi, char *command, uint32_t length) {
+    completePendingSend(wifi);  // module is busy until previous datagram is sent, queued commands never wait here
+#if defined(ESP8266_ENABLE_METRICS)
+    recordCommandStart(wifi, command);
+#endif
+    clearResponseESP8266(wifi);
+    wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
+    wifi->response->isServerResponseAwaited = false;
+    startReceiveESP8266(wifi);
+    transmitData(wifi, command, length);
+}
+
+static void transmitQueuedCommand(WiFi *wifi) {   // command is sent by DMA straight from queue slot
+    CommandQueue *queue = &wifi->commandQueue;
+    QueuedCommand *command = &queue->commands[queue->head];
+    queue->savedTimeout = wifi->response->timeout;
+    wifi->response->timeout = command->timeout;
+    queue->isInFlight = true;
+    transmitATCommand(wifi, command->command, command->length);
+}
+
+static void completePendingSend(WiFi *wifi) {
+    if (wifi->isSendPending) {
+        wifi->lastSendStatus = waitForResponseESP8266(wifi);
+        wifi->isSendPending = false;
+    }
+}
+
+static void clearResponseESP8266(WiFi *wifi) {
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    consumeRxRing(wifi);    // route pending unsolicited data before dropping previous response text
+#endif
+    wifi->response->responseBody[0] = '\0';    // text is terminated after each scan, old bytes past it are never read
+    wifi->response->responseLength = 0;
+    resetResponseMatcher(wifi->response);
+}
+
+static void startReceiveESP8266(WiFi *wifi) {
+#if defined(ESP8266_RX_CIRCULAR_MODE)   // circular reception is started once at init and runs continuously
+    (void) wifi;
+#else
+    armReceiveESP8266(wifi, 0);
+#endif
+}
+
+static void processPendingData(WiFi *wifi) {
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    consumeRxRing(wifi);
+#else
+    if (isTransferCompleteUSART_DMA(wifi->USARTDma->rxData)) {
+        scanResponseESP8266(wifi);
+        continueReceiveESP8266(wifi);
+    }
+#endif
+}
+
+static void resetResponseMatcher(ResponseData *response) {
+    memset(&response->matcher, 0, sizeof(struct ResponseMatcher));
+}
+
+static ResponseStatus scanResponseESP8266(WiFi *wifi) {    // pass only newly arrived bytes through matcher and +IPD framer
+    ResponseData *response = wifi->response;
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    consumeRxRing(wifi);
+#else
+    ResponseMatcher *matcher = &response->matcher;
+    uint32_t receivedLength = getReceivedLength(wifi);  // DMA write position, zero bytes are valid data
+#if defined(ESP8266_ENABLE_METRICS)
+    recordRxLevel(wifi, receivedLength);
+#endif
+#if defined(ESP8266_ENABLE_TRACE)
+    if (receivedLength > matcher->scannedLength) {
+        traceRecord(wifi, ESP8266_TRACE_RX, &response->responseBody[matcher->scannedLength], receivedLength - matcher->scannedLength);
+    }
+#endif
+    while (matcher->scannedLength < receivedLength) {
+        processReceivedSymbol(wifi, response->responseBody[matcher->scannedLength]);
+        matcher->scannedLength++;
+    }
+    response->responseLength = matcher->isOverflowed ? OVERFLOW_KEPT_LENGTH(response) : receivedLength;  // scanned overflow bytes aren't text
+    response->responseBody[response->responseLength] = '\0';    // last buffer byte is never written by DMA
+#endif
+    return getMatcherStatus(response);
+}
+
+static ResponseStatus getMatcherStatus(ResponseData *response) {
+    ResponseMatcher *matcher = &response->matcher;
+    bool isSuccess = response->isServerResponseAwaited
+            ? (matcher->isFrameReceived || (matcher->matchedPatterns & PATTERN_BIT(CLOSED_PATTERN)))
+            : (matcher->matchedPatterns & COMMAND_SUCCESS_PATTERNS);
+    if (isSuccess) {
+        return ESP8266_RESPONSE_SUCCESS;
+    } else if (matcher->matchedPatterns & ERROR_PATTERNS) {    // "error" or "fail" response status
+        return ESP8266_RESPONSE_ERROR;
+    }
+    return ESP8266_RESPONSE_WAITING;
+}
+
+static bool processReceivedSymbol(WiFi *wifi, char symbol) {    // returns true when symbol is frame payload
+    METRICS_INCREMENT(wifi, rxBytes);
+    if (feedIPDFramer(wifi, symbol)) {  // payload bytes are routed to receive queue and never treated as status
+        wifi->urc.lineLength = 0;       // frame header is not a line, next line starts after payload
+        return true;
+    }
+    feedResponseMatcher(&wifi->response->matcher, symbol);
+    feedUrcLine(wifi, symbol);
+    if (wifi->scan.isActive) {
+        feedScanParser(wifi, symbol);
+    }
+    return false;
+}
+
+static void feedScanParser(WiFi *wifi, char symbol) {
+    ScanParser *parser = &wifi->scan;
+    if (symbol == '\n') {   // next entry
+        parser->lineState = SCAN_LINE_PREFIX;
+        parser->prefixLength = 0;
+        return;
+    }
+
+    switch (parser->lineState) {
+        case SCAN_LINE_PREFIX:
+            if (symbol != SCAN_LINE_PREFIX_VALUE[parser->prefixLength]) {
+                parser->lineState = SCAN_LINE_SKIP;
+            } else if (++parser->prefixLength == SCAN_LINE_PREFIX_LENGTH) {
+                parser->lineState = parser->isStopped ? SCAN_LINE_SKIP : SCAN_LINE_FIELDS;
+                parser->field = SECURITY;
+                parser->isQuoted = false;
+                parser->isEscaped = false;
+                parser->ssidLength = 0;
+                parser->valueLength = 0;
+                memset(&parser->accessPoint, 0, sizeof(struct AccessPoint));
+            }
+            break;
+
+        case SCAN_LINE_FIELDS:
+            if (parser->isEscaped) {
+                appendScanValue(parser, symbol);
+                parser->isEscaped = false;
+            } else if (parser->isQuoted) {
+                if (symbol == '\\') {
+                    parser->isEscaped = true;   // escaped quote or comma in ssid
+                } else if (symbol == '"') {
+                    parser->isQuoted = false;
+                } else {
+                    appendScanValue(parser, symbol);
+                }
+            } else if (symbol == '"') {
+                parser->isQuoted = true;
+            } else if (symbol == ',') {
+                commitScanField(parser);
+                parser->field++;
+            } else if (symbol == ')') {
+                commitScanField(parser);
+                commitAccessPoint(wifi);
+                parser->lineState = SCAN_LINE_SKIP;
+            } else {
+                appendScanValue(parser, symbol);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void appendScanValue(ScanParser *parser, char symbol) {
+    if (parser->field == SSID) {
+        if (parser->ssidLength < ESP8266_SSID_MAX_LENGTH) {
+            parser->accessPoint.ssid[parser->ssidLength++] = symbol;
+        }
+    } else if (parser->valueLength < sizeof(parser->value) - 1) {
+        parser->value[parser->valueLength++] = symbol;
+    }
+}
+
+static void commitScanField(ScanParser *parser) {
+    parser->value[parser->valueLength] = '\0';
+    AccessPoint *accessPoint = &parser->accessPoint;
+    switch (parser->field) {
+        case SECURITY:
+            accessPoint->encryption = atoi(parser->value);
+            break;
+        case SIGNAL_STRENGTH:
+            accessPoint->signalStrength = atoi(parser->value);
+            break;
+        case BSSID:
+            accessPoint->bssid = macAddressFromString(parser->value);
+            break;
+        case CHANNEL:
+            accessPoint->channel = atoi(parser->value);
+            break;
+        default:    // ssid is copied directly, extra fields from firmware without AT+CWLAPOPT are skipped
+            break;
+    }
+    parser->valueLength = 0;
+}
+
+static void commitAccessPoint(WiFi *wifi) {
+    ScanParser *parser = &wifi->scan;
+    parser->accessPoint.ssid[parser->ssidLength] = '\0';
+    AccessPointList *list = parser->list;
+    if (list != NULL && list->size < ESP8266_AVAILABLE_ACCESS_POINT_COUNT) {
+        list->accessPointArray[list->size++] = parser->accessPoint;
+    }
+
+    if (parser->callback != NULL && parser->callback(wifi, &parser->accessPoint, parser->context) == ESP8266_SCAN_STOP) {
+        parser->isStopped = true;   // module can't abort scan, remaining entries are skipped until final status
+    }
+}
+
+static void feedUrcLine(WiFi *wifi, char symbol) {
+    UrcDispatcher *urc = &wifi->urc;
+    if (symbol == '\n') {
+        if (!urc->isLineOverflow && urc->lineLength > 0 && urc->line[urc->lineLength - 1] == '\r') {
+            urc->line[urc->lineLength - 1] = '\0';
+            parseUrcLine(wifi, urc->line, urc->lineLength - 1);
+        }
+        urc->lineLength = 0;
+        urc->isLineOverflow = false;
+    } else if (urc->lineLength < ESP8266_LINE_BUFFER_LENGTH - 1) {
+        urc->line[urc->lineLength++] = symbol;
+    } else {
+        urc->isLineOverflow = true;    // too long for any result code, skip until line end
+    }
+}
+
+static void parseUrcLine(WiFi *wifi, const char *line, uint8_t length) {
+    ConnectionID id = CONNECTION_ID_0;
+    bool isIdPrefixed = length > 2 && line[1] == ',' && line[0] >= '0' && line[0] < '0' + ESP8266_CONNECTION_COUNT;
+    if (isIdPrefixed) {    // "<id>,CONNECT" or "<id>,CLOSED" for multiple connections
+        id = line[0] - '0';
+        line += 2;
+    }
+
+    if (strcmp(line, "CONNECT") == 0) {
+        dispatchUrc(wifi, ESP8266_URC_SOCKET_CONNECTED, id, 0);
+    } else if (strcmp(line, "CLOSED") == 0) {
+        dispatchUrc(wifi, ESP8266_URC_SOCKET_CLOSED, id, 0);
+    } else if (isIdPrefixed) {
+        return;
+    } else if (strcmp(line, "WIFI CONNECTED") == 0) {
+        dispatchUrc(wifi, ESP8266_URC_WIFI_CONNECTED, id, 0);
+    } else if (strcmp(line, "WIFI GOT IP") == 0) {
+        dispatchUrc(wifi, ESP8266_URC_WIFI_GOT_IP, id, 0);
+    } else if (strcmp(line, "WIFI DISCONNECT") == 0) {
+        dispatchUrc(wifi, ESP8266_URC_WIFI_DISCONNECTED, id, 0);
+    } else if (strcmp(line, "ALREADY CONNECTED") == 0) {
+        wifi->response->matcher.isAlreadyConnected = true;     // result of current socket start, not dispatched
+    }
+}
+
+static void dispatchUrc(WiFi *wifi, UrcType type, ConnectionID id, uint32_t dataLength) {
+    LinkState *link = &wifi->link;
+    switch (type) {
+        case ESP8266_URC_WIFI_CONNECTED:
+            link->isAccessPointConnected = true;
+            break;
+        case ESP8266_URC_WIFI_GOT_IP:
+            link->isAccessPointConnected = true;
+            link->hasIP = true;
+            break;
+        case ESP8266_URC_WIFI_DISCONNECTED:    // module drops all sockets with AP
+            link->isAccessPointConnected = false;
+            link->hasIP = false;
+            link->openSockets = 0;
+            break;
+        case ESP8266_URC_SOCKET_CONNECTED:
+            link->openSockets |= (1U << id);
+            break;
+        case ESP8266_URC_SOCKET_CLOSED:
+            link->openSockets &= ~(1U << id);
+            if (wifi->server.sendingId != (int8_t) id) {    // chunk in flight is released by its send status
+                wifi->server.connections[id].remainingLength = 0;
+            }
+            wifi->server.connections[id].isCloseRequested = false;
+            break;
+        default:
+            break;
+    }
+
+    UrcHandler handler = wifi->urc.handlers[type];
+    if (handler != NULL) {
+        UrcEvent event = {.type = type, .id = id, .dataLength = dataLength};
+        handler(wifi, &event, wifi->urc.contexts[type]);
+    }
+}
+
+static void feedResponseMatcher(ResponseMatcher *matcher, char symbol) {
+    for (uint8_t i = 0; i < ESP8266_RESPONSE_PATTERN_COUNT; i++) {
+        const ResponsePattern *pattern = &RESPONSE_PATTERNS[i];
+        uint8_t state = matcher->patternState[i];
+        while (state > 0 && pattern->value[state] != symbol) {
+            state = pattern->failure[state - 1];
+        }
+
+        if (pattern->value[state] == symbol) {
+            state++;
+        }
+
+        if (state == pattern->length) {
+            matcher->matchedPatterns |= PATTERN_BIT(i);
+            state = pattern->failure[state - 1];
+        }
+        matcher->patternState[i] = state;
+    }
+}
+
+static bool feedIPDFramer(WiFi *wifi, char symbol) {   // returns true when symbol is consumed as frame payload
+    IPDFramer *framer = &wifi->framer;
+    switch (framer->state) {
+        case IPD_FRAME_PREFIX:
+            if (symbol == DATA_RECEIVED_STATUS[framer->prefixLength]) {
+                framer->prefixLength++;
+            } else {
+                framer->prefixLength = (symbol == DATA_RECEIVED_STATUS[0]) ? 1 : 0;
+            }
+
+            if (framer->prefixLength == DATA_RECEIVED_STATUS_LENGTH) {
+                framer->prefixLength = 0;
+                framer->id = CONNECTION_ID_0;
+                framer->remainingLength = 0;
+                framer->state = (wifi->connectionMode == ESP8266_CONNECTION_MULTIPLE) ? IPD_FRAME_ID : IPD_FRAME_LENGTH;
+            }
+            return false;
+
+        case IPD_FRAME_ID:
+            if (symbol >= '0' && symbol < '0' + ESP8266_CONNECTION_COUNT) {
+                framer->id = symbol - '0';
+            } else {
+                framer->state = (symbol == ',') ? IPD_FRAME_LENGTH : IPD_FRAME_PREFIX;
+            }
+            return false;
+
+        case IPD_FRAME_LENGTH:
+            if (symbol >= '0' && symbol <= '9') {
+                framer->remainingLength = (framer->remainingLength * 10) + (symbol - '0');
+                framer->frameLength = framer->remainingLength;
+            } else if (symbol == ',') {
+                framer->state = IPD_FRAME_REMOTE_INFO;
+            } else {
+                framer->state = (symbol == ':' && framer->remainingLength > 0) ? IPD_FRAME_PAYLOAD : IPD_FRAME_PREFIX;
+            }
+            return false;
+
+        case IPD_FRAME_REMOTE_INFO:
+            if (symbol == ':') {
+                framer->state = (framer->remainingLength > 0) ? IPD_FRAME_PAYLOAD : IPD_FRAME_PREFIX;
+            }
+            return false;
+
+        case IPD_FRAME_PAYLOAD:
+            pushToReceiveQueue(&wifi->receiveQueue[framer->id], symbol);
+            framer->remainingLength--;
+            if (framer->remainingLength == 0) {
+                framer->state = IPD_FRAME_PREFIX;
+                wifi->response->matcher.isFrameReceived = true;
+                dispatchUrc(wifi, ESP8266_URC_DATA_RECEIVED, framer->id, framer->frameLength);
+            }
+            return true;
+    }
+    return false;
+}
+
+static void pushToReceiveQueue(ReceiveQueue *queue, char symbol) {
+    uint32_t nextHead = (queue->head + 1) % ESP8266_RECEIVE_QUEUE_SIZE;
+    if (nextHead == queue->tail) {  // queue is full, keep already received data
+        queue->droppedBytes++;
+        return;
+    }
+    queue->buffer[queue->head] = symbol;
+    queue->head = nextHead;
+}
+
+static ResponseStatus sendRequestData(WiFi *wifi, ConnectionID id, bool isConnectionIdRequired) {
+    RequestData *request = wifi->request;
+    uint32_t dataLength = request->dataLength;
+    request->dataLength = 0;  // reset data length, preventing incorrect data transmit length for next request
+    if (dataLength == 0) {
+        if (request->isBinary) return ESP8266_RESPONSE_ERROR;  // binary body can't be measured, length should be provided
+        dataLength = strlen(request->requestBody);
+    }
+
+    if (!request->isBinary) {   // text body is terminated with line end
+        if (dataLength + 2 > request->bufferSize) return ESP8266_RESPONSE_ERROR;
+        memcpy(&request->requestBody[dataLength], NEW_LINE, 2);
+        dataLength += 2;
+    }
+    if (dataLength > request->bufferSize || dataLength > MAX_SEND_DATA_LENGTH) return ESP8266_RESPONSE_ERROR;
+
+    sendPayloadLength(wifi, id, dataLength, isConnectionIdRequired);   // provide connection id and data length before request, body stays in TX buffer
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    if (isResponseStatusSuccess(status)) {
+        clearResponseESP8266(wifi);
+        wifi->response->startTimeMillis = currentMilliSeconds();   // command start time
+        wifi->response->isServerResponseAwaited = true;
+        startReceiveESP8266(wifi);
+        METRICS_FINISH_SEND(wifi);
+        transmitData(wifi, request->requestBody, dataLength);   // exact length, body may contain zero bytes
+        status = ESP8266_RESPONSE_WAITING;
+    }
+    return status;
+}
+
+#if !defined(ESP8266_RX_CIRCULAR_MODE)
+static void armReceiveESP8266(WiFi *wifi, uint32_t offset) {  // DMA writes from offset up to last buffer byte, which is kept for terminator
+    DMA_TypeDef *DMAx = wifi->USARTDma->DMAx;
+    uint32_t stream = wifi->USARTDma->rxData->stream;
+    LL_DMA_DisableStream(DMAx, stream);
+    wifi->USARTDma->rxData->isTransferComplete = false;
+    LL_DMA_SetMemoryAddress(DMAx, stream, (uint32_t) (uintptr_t) &wifi->response->responseBody[offset]);
+    LL_DMA_SetDataLength(DMAx, stream, wifi->response->bufferSize - 1 - offset);
+    enableDMAStream(DMAx, stream);
+}
+
+static void continueReceiveESP8266(WiFi *wifi) {
+    ResponseData *response = wifi->response;
+    uint32_t receivedLength = getReceivedLength(wifi);
+    if (receivedLength >= response->bufferSize - 1) {  // buffer is full, rest of response is scanned in second half
+        response->matcher.isOverflowed = true;
+        response->matcher.scannedLength = OVERFLOW_KEPT_LENGTH(response);
+        receivedLength = OVERFLOW_KEPT_LENGTH(response);
+    }
+    armReceiveESP8266(wifi, receivedLength);
+}
+
+static uint32_t getReceivedLength(WiFi *wifi) {     // absolute text length, same for any arm offset
+    uint32_t remainingLength = LL_DMA_GetDataLength(wifi->USARTDma->DMAx, wifi->USARTDma->rxData->stream);
+    return (wifi->response->bufferSize - 1) - remainingLength;
+}
+#endif
+
+static void transmitData(WiFi *wifi, char *data, uint32_t length) {
+    waitForTransmitComplete(wifi);  // TX stream takes next transfer only after previous one, answer can arrive before command has left
+    METRICS_ADD(wifi, txBytes, length);
+#if defined(ESP8266_ENABLE_TRACE)
+    traceRecord(wifi, ESP8266_TRACE_TX, data, length);
+#endif
+    transmitUSART_DMA(wifi->USARTDma, data, length);
+}
+
+static void waitForTransmitComplete(WiFi *wifi) {
+    while (!isTransferCompleteUSART_DMA(wifi->USARTDma->txData));
+}
+
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+void rxEventCallbackESP8266(WiFi *wifi) {
+    if (LL_USART_IsActiveFlag_IDLE(wifi->USARTDma->USARTx)) {
+        LL_USART_ClearFlag_IDLE(wifi->USARTDma->USARTx);
+    }
+    uint32_t remaining = LL_DMA_GetDataLength(wifi->USARTDma->DMAx, wifi->USARTDma->rxData->stream);
+    updateRxRingHead(&wifi->rxRing, ESP8266_RX_RING_SIZE - remaining);
+}
+
+static void startRxRing(WiFi *wifi) {
+    memset(&wifi->rxRing, 0, sizeof(struct RxRing));
+    DMA_TypeDef *DMAx = wifi->USARTDma->DMAx;
+    uint32_t stream = wifi->USARTDma->rxData->stream;
+
+    LL_DMA_DisableStream(DMAx, stream);
+    LL_DMA_SetMode(DMAx, stream, LL_DMA_MODE_CIRCULAR);
+    uint32_t dataRegisterAddress = LL_USART_DMA_GetRegAddr(wifi->USARTDma->USARTx);
+    LL_DMA_ConfigAddresses(DMAx, stream, dataRegisterAddress, (uint32_t) (uintptr_t) wifi->rxRing.buffer, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetDataLength(DMAx, stream, ESP8266_RX_RING_SIZE);
+    LL_DMA_EnableIT_HT(DMAx, stream);
+    LL_DMA_EnableIT_TC(DMAx, stream);
+    enableDMAStream(DMAx, stream);
+    LL_USART_EnableDMAReq_RX(wifi->USARTDma->USARTx);
+    LL_USART_EnableIT_IDLE(wifi->USARTDma->USARTx);
+}
+
+static void updateRxRingHead(RxRing *ring, uint32_t position) {   // called from interrupt context only
+    if (position >= ESP8266_RX_RING_SIZE) {    // data counter reloaded after full transfer
+        position = 0;
+    }
+    uint32_t head = ring->head;
+    uint32_t receivedLength = (position >= head) ? (position - head) : (ESP8266_RX_RING_SIZE - head + position);
+    ring->receivedBytes += receivedLength;
+    ring->head = position;
+}
+
+static void consumeRxRing(WiFi *wifi) {
+    RxRing *ring = &wifi->rxRing;
+    uint32_t head = ring->head;     // snapshot, DMA keeps writing while span is parsed
+    if ((ring->receivedBytes - ring->consumedBytes) >= ESP8266_RX_RING_SIZE) {    // DMA lapped parser, unread data is overwritten
+        ring->overrunCount++;
+        ring->tail = head;
+        ring->consumedBytes = ring->receivedBytes;
+        memset(&wifi->framer, 0, sizeof(struct IPDFramer));     // lost span can end partial frame, line or status, parsing restarts at next one
+        memset(wifi->response->matcher.patternState, 0, sizeof(wifi->response->matcher.patternState));
+        wifi->urc.lineLength = 0;
+        return;
+    }
+
+#if defined(ESP8266_ENABLE_METRICS)
+    recordRxLevel(wifi, ring->receivedBytes - ring->consumedBytes);
+#endif
+#if defined(ESP8266_ENABLE_TRACE)
+    if (head < ring->tail) {   // span wraps around ring end
+        traceRecord(wifi, ESP8266_TRACE_RX, &ring->buffer[ring->tail], ESP8266_RX_RING_SIZE - ring->tail);
+        traceRecord(wifi, ESP8266_TRACE_RX, ring->buffer, head);
+    } else if (head > ring->tail) {
+        traceRecord(wifi, ESP8266_TRACE_RX, &ring->buffer[ring->tail], head - ring->tail);
+    }
+#endif
+    ResponseData *response = wifi->response;
+    while (ring->tail != head) {
+        char symbol = ring->buffer[ring->tail];
+        ring->tail = (ring->tail + 1) % ESP8266_RX_RING_SIZE;
+        ring->consumedBytes++;
+
+        if (processReceivedSymbol(wifi, symbol)) continue;
+        if (response->responseLength < response->bufferSize - 1) {  // keep response text for command parsers
+            response->responseBody[response->responseLength++] = symbol;
+            response->responseBody[response->responseLength] = '\0';
+        } else {
+            response->matcher.isOverflowed = true;
+        }
+    }
+}
+#endif
+
+#if defined(ESP8266_ENABLE_TRACE)
+static void traceRecord(WiFi *wifi, TraceDirection direction, const char *data, uint32_t length) {
+    TraceRing *trace = &wifi->trace;
+    if (length > TRACE_MAX_RECORD_LENGTH) {    // keep beginning of large chunk, enough for protocol analysis
+        length = TRACE_MAX_RECORD_LENGTH;
+    }
+
+    uint32_t recordLength = TRACE_RECORD_HEADER_LENGTH + length;
+    uint32_t usedLength = (trace->head + ESP8266_TRACE_BUFFER_SIZE - trace->tail) % ESP8266_TRACE_BUFFER_SIZE;
+    while ((ESP8266_TRACE_BUFFER_SIZE - 1 - usedLength) < recordLength) {   // drop oldest records, latest traffic is most valuable
+        uint32_t oldestLength = traceReadByte(trace, trace->tail + 5) | (traceReadByte(trace, trace->tail + 6) << 8);
+        uint32_t droppedLength = TRACE_RECORD_HEADER_LENGTH + oldestLength;
+        trace->tail = (trace->tail + droppedLength) % ESP8266_TRACE_BUFFER_SIZE;
+        usedLength -= droppedLength;
+        trace->droppedRecords++;
+    }
+
+    uint32_t timestamp = DWT->CYCCNT;
+    uint8_t header[TRACE_RECORD_HEADER_LENGTH] = {
+            timestamp, timestamp >> 8, timestamp >> 16, timestamp >> 24, direction, length, length >> 8
+    };
+    uint32_t position = trace->head;
+    traceWrite(trace, &position, header, TRACE_RECORD_HEADER_LENGTH);
+    traceWrite(trace, &position, (const uint8_t *) data, length);
+    trace->head = position;     // publish complete record
+}
+
+static void traceWrite(TraceRing *trace, uint32_t *position, const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        trace->buffer[*position] = (char) data[i];
+        *position = (*position + 1) % ESP8266_TRACE_BUFFER_SIZE;
+    }
+}
+
+static uint8_t traceReadByte(TraceRing *trace, uint32_t position) {
+    return (uint8_t) trace->buffer[position % ESP8266_TRACE_BUFFER_SIZE];
+}
+#endif
+
+#if defined(ESP8266_ENABLE_METRICS)
+static void recordCommandStart(WiFi *wifi, const char *command) {
+    static const char *const COMMAND_PREFIXES[ESP8266_COMMAND_TYPE_COUNT] = {
+            [ESP8266_COMMAND_SEND] = "AT+CIPSEND",
+            [ESP8266_COMMAND_CONNECT] = "AT+CIPSTART",
+            [ESP8266_COMMAND_STATUS] = "AT+CIPSTATUS",
+            [ESP8266_COMMAND_JOIN] = "AT+CWJAP",
+            [ESP8266_COMMAND_SCAN] = "AT+CWLAP",
+            [ESP8266_COMMAND_PING] = "AT+PING",
+    };
+    WiFiMetrics *metrics = &wifi->metrics;
+    metrics->commandType = ESP8266_COMMAND_OTHER;
+    for (uint8_t i = 0; i < ESP8266_COMMAND_TYPE_COUNT; i++) {
+        if (COMMAND_PREFIXES[i] != NULL && strncmp(command, COMMAND_PREFIXES[i], strlen(COMMAND_PREFIXES[i])) == 0) {
+            metrics->commandType = i;
+            break;
+        }
+    }
+    metrics->commandStartCycles = DWT->CYCCNT;
+    metrics->isCommandMeasured = false;
+}
+
+static void recordResponseMetrics(WiFi *wifi, ResponseStatus status) {
+    WiFiMetrics *metrics = &wifi->metrics;
+    metrics->polls++;
+    if (isResponseStatusWaiting(status) || metrics->isCommandMeasured) return;
+
+    uint32_t cycles = DWT->CYCCNT - metrics->commandStartCycles;
+    LatencyHistogram *histogram = &metrics->latency[metrics->commandType];
+    histogram->buckets[31 - __builtin_clz(cycles | 1)]++;  // log2 bucket
+    histogram->count++;
+    if (cycles > histogram->maxCycles) {
+        histogram->maxCycles = cycles;
+    }
+
+    if (isResponseStatusTimeout(status)) {
+        metrics->timeouts++;
+    } else if (isResponseStatusError(status)) {
+        metrics->errors++;
+    }
+    metrics->isCommandMeasured = true;    // following server response is not part of command latency
+}
+
+static void recordRxLevel(WiFi *wifi, uint32_t pendingLength) {
+    if (pendingLength > wifi->metrics.rxHighWaterMark) {
+        wifi->metrics.rxHighWaterMark = pendingLength;
+    }
+}
+
+static void recordSendLatency(WiFi *wifi) {  // send call to payload DMA start, includes "AT+CIPSEND" round trip
+    WiFiMetrics *metrics = &wifi->metrics;
+    uint32_t cycles = DWT->CYCCNT - metrics->sendStartCycles;
+    metrics->sends++;
+    metrics->sendCycles += cycles;
+    if (cycles > metrics->maxSendCycles) {
+        metrics->maxSendCycles = cycles;
+    }
+}
+#endif
\ No newline at end of file
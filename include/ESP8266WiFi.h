@@ -1,16 +1,109 @@
 #pragma once
 
-#include <stdarg.h>
 #include "USART_DMA.h"
 #include "DWT_Delay.h"
 #include "IPAddress.h"
 #include "MACAddress.h"
-#include "Regex.h"
 
 #define ESP8266_RESPONSE_DEFAULT_TIMEOUT_MS	 15000
 #define ESP8266_KEEPALIVE_ATTEMPT_COUNT	     3
 #define ESP8266_PING_PACKET_TIMEOUT_VALUE   -1
 #define ESP8266_AVAILABLE_ACCESS_POINT_COUNT 20
+#define ESP8266_RESPONSE_PATTERN_COUNT       8
+#define ESP8266_STARTUP_DELAY_MS             100
+#define ESP8266_INIT_STEP_TIMEOUT_MS         1000   // response timeout for each initialization command
+#define ESP8266_INIT_RETRY_BACKOFF_MS        100    // doubled after each failed attempt
+#define ESP8266_CONNECTION_COUNT             5
+#define ESP8266_SEND_RETRY_COUNT             3      // chunk retransmits after "SEND FAIL" or "busy s..."
+#define ESP8266_BUSY_RETRY_DELAY_MS          20     // doubled after each busy response
+#define ESP8266_SSID_MAX_LENGTH              32
+#define ESP8266_PASSWORD_MAX_LENGTH          64
+
+#ifndef ESP8266_RECEIVE_QUEUE_SIZE
+#define ESP8266_RECEIVE_QUEUE_SIZE           512    // +IPD payload buffer per connection
+#endif
+
+#ifndef ESP8266_LINE_BUFFER_LENGTH
+#define ESP8266_LINE_BUFFER_LENGTH           32     // longest unsolicited result code line
+#endif
+
+#ifndef ESP8266_KNOWN_NETWORK_COUNT
+#define ESP8266_KNOWN_NETWORK_COUNT          4      // networks remembered for reconnect
+#endif
+
+#ifndef ESP8266_SOFT_AP_CLIENT_COUNT
+#define ESP8266_SOFT_AP_CLIENT_COUNT         8      // soft AP stations kept in client table
+#endif
+
+#ifndef ESP8266_POWER_BATCH_SIZE
+#define ESP8266_POWER_BATCH_SIZE             8      // application sends collected for one wake window
+#endif
+
+#ifndef ESP8266_POWER_SLEEP_DUTY_PERMILLE
+#define ESP8266_POWER_SLEEP_DUTY_PERMILLE    30     // estimated radio on share in light/modem sleep, DTIM beacon listening
+#endif
+
+#ifndef ESP8266_POWER_IDLE_LINK_PERMILLE
+#define ESP8266_POWER_IDLE_LINK_PERMILLE     2      // estimated extra radio on share to keep idle socket open
+#endif
+
+#ifndef ESP8266_HOST_MAX_LENGTH
+#define ESP8266_HOST_MAX_LENGTH              64     // supervised endpoint host name or IP
+#endif
+
+#define ESP8266_SUPERVISOR_BACKOFF_MIN_MS    1000   // first retry delay, doubled after each failed attempt
+#define ESP8266_SUPERVISOR_BACKOFF_MAX_MS    60000
+
+#ifndef ESP8266_SERVER_CHUNK_LENGTH
+#define ESP8266_SERVER_CHUNK_LENGTH          512    // max bytes sent per connection turn, smaller is fairer
+#endif
+
+#ifndef ESP8266_TRANSPARENT_PACKET_GAP_MS
+#define ESP8266_TRANSPARENT_PACKET_GAP_MS    20     // module sends passthrough packet after this silence, also kept before "+++"
+#endif
+
+#ifndef ESP8266_TRANSPARENT_EXIT_GUARD_MS
+#define ESP8266_TRANSPARENT_EXIT_GUARD_MS    1000   // module ignores commands for this time after "+++"
+#endif
+
+#ifndef ESP8266_COMMAND_QUEUE_SIZE
+#define ESP8266_COMMAND_QUEUE_SIZE           4      // pipelined non-blocking commands
+#endif
+
+#ifndef ESP8266_STATIC_RX_BUFFER_SIZE
+#define ESP8266_STATIC_RX_BUFFER_SIZE        2048   // static instance RX DMA buffer, only response text in circular mode
+#endif
+
+#ifndef ESP8266_STATIC_TX_BUFFER_SIZE
+#define ESP8266_STATIC_TX_BUFFER_SIZE        1024   // static instance TX DMA buffer
+#endif
+
+#ifndef ESP8266_MALLOC
+#define ESP8266_MALLOC                       malloc // heap of createWifiESP8266(), static instance doesn't use it
+#endif
+
+#ifndef ESP8266_FREE
+#define ESP8266_FREE                         free
+#endif
+
+#ifndef ESP8266_COMMAND_MAX_LENGTH
+#define ESP8266_COMMAND_MAX_LENGTH           160    // queued command length including line end, fits join with bssid
+#endif
+
+// #define ESP8266_ENABLE_METRICS      // per command latency histograms and counters, zero cost when not defined
+#define ESP8266_LATENCY_BUCKET_COUNT         32     // log2 buckets of DWT cycles
+
+// #define ESP8266_ENABLE_TRACE        // timestamped TX/RX capture for offline replay
+#if defined(ESP8266_ENABLE_TRACE) && !defined(ESP8266_TRACE_BUFFER_SIZE)
+#define ESP8266_TRACE_BUFFER_SIZE            2048
+#endif
+
+// #define ESP8266_RX_CIRCULAR_MODE    // continuously running circular RX DMA instead of restart per response
+#if defined(ESP8266_RX_CIRCULAR_MODE) && !defined(ESP8266_RX_RING_SIZE)
+#define ESP8266_RX_RING_SIZE                 1024
+#endif
+
+#define ESP8266_STATIC_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1]   // C99 build time check, array size is negative when condition fails
 
 typedef enum ESP8266ResponseStatus {
 	ESP8266_RESPONSE_SUCCESS,
@@ -19,6 +112,27 @@ typedef enum ESP8266ResponseStatus {
 	ESP8266_RESPONSE_TIMEOUT
 } ResponseStatus;
 
+typedef enum ESP8266InitPhase {
+    ESP8266_INIT_STARTUP,           // module boot delay
+    ESP8266_INIT_HEALTH_CHECK,
+    ESP8266_INIT_ECHO_OFF,
+    ESP8266_INIT_WIFI_MODE,
+    ESP8266_INIT_CONNECTION_MODE,
+    ESP8266_INIT_TRANSFER_MODE,
+    ESP8266_INIT_READY,
+    ESP8266_INIT_FAILED
+} InitPhase;
+
+typedef enum ESP8266UrcType {   // unsolicited result codes
+    ESP8266_URC_WIFI_CONNECTED,
+    ESP8266_URC_WIFI_GOT_IP,
+    ESP8266_URC_WIFI_DISCONNECTED,
+    ESP8266_URC_SOCKET_CONNECTED,   // "<id>,CONNECT"
+    ESP8266_URC_SOCKET_CLOSED,      // "<id>,CLOSED"
+    ESP8266_URC_DATA_RECEIVED,      // complete "+IPD" frame
+    ESP8266_URC_TYPE_COUNT
+} UrcType;
+
 typedef enum ESP8266ConnectionStatus {
 	ESP8266_CONNECTED_TO_AP,
 	ESP8266_CREATED_TRANSMISSION,
@@ -83,8 +197,10 @@ typedef enum SignalStrength {
 
 typedef struct AccessPoint {
     WifiEncryptionType encryption;
-    char *ssid;
+    char ssid[ESP8266_SSID_MAX_LENGTH + 1];    // copied, stays valid after next command
     int8_t signalStrength;
+    MACAddress bssid;
+    uint8_t channel;
 } AccessPoint;
 
 typedef struct AccessPointList {
@@ -92,11 +208,54 @@ typedef struct AccessPointList {
     uint8_t size;
 } AccessPointList;
 
+typedef enum ESP8266ScanAction {
+    ESP8266_SCAN_CONTINUE,
+    ESP8266_SCAN_STOP       // ignore rest of scan result
+} ScanAction;
+
+struct WiFi;
+typedef ScanAction (*AccessPointCallback)(struct WiFi *wifi, const AccessPoint *accessPoint, void *context);
+
+typedef enum ESP8266ScanLineState {
+    SCAN_LINE_PREFIX,       // "+CWLAP:("
+    SCAN_LINE_FIELDS,
+    SCAN_LINE_SKIP          // other line or entry already parsed
+} ScanLineState;
+
+typedef struct ScanParser {     // streaming "+CWLAP:(<ecn>,"<ssid>",<rssi>,"<mac>",<channel>...)" parser
+    bool isActive;
+    bool isStopped;
+    bool isOptionSet;       // AT+CWLAPOPT sent, entries are sorted by signal strength
+    ScanLineState lineState;
+    uint8_t prefixLength;
+    uint8_t field;
+    bool isQuoted;
+    bool isEscaped;
+    uint8_t ssidLength;
+    char value[MAC_ADDRESS_LENGTH + 1];
+    uint8_t valueLength;
+    AccessPoint accessPoint;
+    AccessPointList *list;
+    AccessPointCallback callback;
+    void *context;
+} ScanParser;
+
 typedef struct SoftAPClient {
     IPAddress clientIP;
     MACAddress clientMac;
 } SoftAPClient;
 
+typedef struct SoftApClientTable {  // AT+CWLIF snapshot, compared with previous one on each refresh
+    SoftAPClient clients[ESP8266_SOFT_AP_CLIENT_COUNT];
+    uint8_t size;
+    uint8_t joinedMask;             // bit per clients[] index, station wasn't in previous snapshot
+    SoftAPClient leftClients[ESP8266_SOFT_AP_CLIENT_COUNT];    // stations from previous snapshot that are gone
+    uint8_t leftCount;
+    bool isTruncated;               // more stations connected than table capacity
+} SoftApClientTable;
+
+ESP8266_STATIC_ASSERT(ESP8266_SOFT_AP_CLIENT_COUNT <= 8, esp8266SoftApClientCountExceedsJoinedMask);
+
 typedef struct LocalInfo {
     IPAddress accessPointIP;
     MACAddress accessPointMAC;
@@ -104,35 +263,455 @@ typedef struct LocalInfo {
     MACAddress localMAC;
 } LocalInfo;
 
+typedef struct ResponseMatcher {    // incremental response status matcher, keeps state between RX events
+    uint32_t scannedLength;         // response bytes already passed through matcher
+    uint8_t patternState[ESP8266_RESPONSE_PATTERN_COUNT];  // matched prefix length for each status pattern
+    uint8_t matchedPatterns;        // bit set of fully matched status patterns
+    bool isFrameReceived;           // complete +IPD frame received since last command
+    bool isCommandDropped;          // command didn't fit TX buffer and wasn't transmitted
+    bool isAlreadyConnected;        // "ALREADY CONNECTED" line, socket start failed because socket is open
+    bool isOverflowed;              // response didn't fit RX buffer, text head is kept and rest is only scanned
+} ResponseMatcher;
+
 typedef struct ResponseData {
 	uint32_t startTimeMillis;
 	bool isServerResponseAwaited;
     uint32_t timeout;
 	uint32_t bufferSize;
+	uint32_t responseLength;    // received response text length, excluding +IPD payload in circular mode
 	char *responseBody;
+	ResponseMatcher matcher;
 } ResponseData;
 
 typedef struct RequestData {
     ConnectionID id;    // used for multiple connections
-    uint32_t dataLength;
+    uint32_t dataLength;    // required for binary body, otherwise optional
+    bool isBinary;          // send exactly dataLength bytes without line end
     uint32_t bufferSize;
     char *requestBody;
 } RequestData;
 
+typedef enum IPDFrameState {
+    IPD_FRAME_PREFIX,       // waiting for "+IPD,"
+    IPD_FRAME_ID,           // "<id>," present only for multiple connections
+    IPD_FRAME_LENGTH,       // "<len>:" or "<len>,"
+    IPD_FRAME_REMOTE_INFO,  // optional ",<ip>,<port>" when AT+CIPDINFO=1
+    IPD_FRAME_PAYLOAD
+} IPDFrameState;
+
+typedef struct IPDFramer {  // length driven "+IPD,[<id>,]<len>:<data>" parser, keeps state between RX events
+    IPDFrameState state;
+    uint8_t prefixLength;
+    ConnectionID id;
+    uint32_t frameLength;
+    uint32_t remainingLength;
+} IPDFramer;
+
+typedef struct ReceiveQueue {   // per connection ring buffer with received payload
+    uint32_t head;
+    uint32_t tail;
+    uint32_t droppedBytes;      // payload lost because queue was full
+    char buffer[ESP8266_RECEIVE_QUEUE_SIZE];
+} ReceiveQueue;
+
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+typedef struct RxRing {     // circular DMA RX buffer, head is updated from interrupts and tail by parser
+    volatile uint32_t head;
+    uint32_t tail;
+    volatile uint32_t receivedBytes;    // total bytes written by DMA, used for overrun detection
+    uint32_t consumedBytes;
+    uint32_t overrunCount;
+    char buffer[ESP8266_RX_RING_SIZE];
+} RxRing;
+#endif
+
+typedef struct SendSegment {    // part of request sent without copying, may contain any binary data
+    const char *data;
+    uint32_t length;
+} SendSegment;
+
+typedef uint32_t (*PayloadProducer)(char *buffer, uint32_t length, void *context);  // returns number of written bytes, 0 - end of payload
+
+typedef struct StreamSendReport {
+    uint32_t bytesSent;
+    uint32_t chunks;
+    uint32_t retransmits;
+    uint32_t elapsedMillis;
+    uint32_t bytesPerSecond;        // sustained throughput including prompt and "SEND OK" waits
+} StreamSendReport;
+
+typedef struct TransparentStream {  // passthrough transmission session state
+    bool isActive;
+    bool isPacketGapStarted;
+    uint32_t packetLength;          // bytes written since last packet gap
+    uint32_t packetGapStartMillis;
+    uint32_t startTimeMillis;
+    uint32_t bytesWritten;          // total streamed bytes, used for throughput measurement
+} TransparentStream;
+
+typedef struct KnownNetwork {
+    char ssid[ESP8266_SSID_MAX_LENGTH + 1];
+    char password[ESP8266_PASSWORD_MAX_LENGTH + 1];
+    char bssid[MAC_ADDRESS_LENGTH + 1];     // last successful join, used for fast rejoin
+    uint8_t channel;
+    int8_t signalStrength;                  // from last scan
+    bool isVisible;                         // found by last scan
+} KnownNetwork;
+
+typedef struct KnownNetworkTable {
+    KnownNetwork networks[ESP8266_KNOWN_NETWORK_COUNT];   // in order of preference
+    uint8_t size;
+    int8_t lastConnected;                   // index of network with cached bssid, -1 if none
+} KnownNetworkTable;
+
+typedef void (*CommandCallback)(struct WiFi *wifi, ResponseStatus status, void *context);
+
+typedef struct UrcEvent {
+    UrcType type;
+    ConnectionID id;        // socket events and received data
+    uint32_t dataLength;    // received frame length, data is available in connection receive queue
+} UrcEvent;
+
+typedef void (*UrcHandler)(struct WiFi *wifi, const UrcEvent *event, void *context);
+
+typedef struct UrcDispatcher {
+    char line[ESP8266_LINE_BUFFER_LENGTH];
+    uint8_t lineLength;
+    bool isLineOverflow;
+    UrcHandler handlers[ESP8266_URC_TYPE_COUNT];
+    void *contexts[ESP8266_URC_TYPE_COUNT];
+} UrcDispatcher;
+
+typedef struct LinkState {  // tracked from unsolicited result codes, no polling commands needed
+    bool isAccessPointConnected;
+    bool hasIP;
+    uint8_t openSockets;    // bit set by ConnectionID
+} LinkState;
+
+typedef struct QueuedCommand {
+    char command[ESP8266_COMMAND_MAX_LENGTH];   // formatted command with line end, ready for transmit
+    uint16_t length;
+    uint32_t timeout;
+    CommandCallback callback;
+    void *context;
+} QueuedCommand;
+
+typedef struct CommandQueue {
+    QueuedCommand commands[ESP8266_COMMAND_QUEUE_SIZE];
+    uint8_t head;           // command in flight or next to send
+    uint8_t size;
+    bool isInFlight;
+    uint32_t savedTimeout;  // response timeout restored after queued command completion
+} CommandQueue;
+
+typedef enum ESP8266SocketType {
+    ESP8266_SOCKET_TCP,
+    ESP8266_SOCKET_UDP,
+    ESP8266_SOCKET_SSL
+} SocketType;
+
+typedef enum ESP8266UdpMode {
+    ESP8266_UDP_REMOTE_FIXED         = 0,
+    ESP8266_UDP_REMOTE_CHANGE_ONCE   = 1,   // remote changes to sender of first received datagram
+    ESP8266_UDP_REMOTE_CHANGE_ALWAYS = 2
+} UdpMode;
+
+typedef struct SocketConfig {
+    SocketType type;
+    const char *host;
+    uint16_t port;
+    uint16_t keepAliveSeconds;      // TCP and SSL, 0 - disabled
+    uint16_t localPort;             // UDP, 0 - assigned by module
+    UdpMode udpMode;
+    uint16_t sslBufferSize;         // SSL, 2048 - 4096, 0 - module default
+} SocketConfig;
+
+typedef struct ServerConnection {
+    const char *data;               // caller buffer, must stay valid until sent
+    uint32_t remainingLength;
+    bool isCloseRequested;          // close after pending data is sent
+} ServerConnection;
+
+typedef struct ServerState {        // CIPSERVER connections, sends are scheduled round robin
+    bool isListening;
+    uint16_t port;
+    bool isPromptAwaited;
+    int8_t sendingId;               // connection with chunk in flight, -1 if none
+    uint16_t chunkLength;
+    uint8_t nextId;
+    ServerConnection connections[ESP8266_CONNECTION_COUNT];
+} ServerState;
+
+typedef enum ESP8266SupervisorState {
+    ESP8266_SUPERVISOR_STOPPED,
+    ESP8266_SUPERVISOR_BACKOFF,     // waiting before next join attempt
+    ESP8266_SUPERVISOR_JOINING,     // join command in flight
+    ESP8266_SUPERVISOR_ONLINE       // access point joined, endpoints are reopened as they close
+} SupervisorState;
+
+typedef struct SupervisedEndpoint {
+    bool isRegistered;
+    char host[ESP8266_HOST_MAX_LENGTH + 1];
+    SocketConfig config;            // host points to copy above
+    uint8_t attempt;
+    uint32_t retryAtMillis;
+} SupervisedEndpoint;
+
+typedef struct LinkSupervisor {     // non-blocking reconnect, at most one command started per tick
+    SupervisorState state;
+    bool isCommandPending;
+    uint8_t joinAttempt;
+    uint8_t nextNetwork;            // known network for next full join
+    uint8_t nextEndpoint;           // round robin endpoint check
+    uint32_t retryAtMillis;
+    uint32_t jitterSeed;
+    uint32_t joinCount;             // successful joins after link loss
+    uint32_t reopenCount;           // successfully reopened endpoints
+    SupervisedEndpoint endpoints[ESP8266_CONNECTION_COUNT];
+} LinkSupervisor;
+
+typedef enum SleepMode {
+    ESP8266_SLEEP_DISABLED = 0,
+    ESP8266_SLEEP_LIGHT = 1,        // needs wake up GPIO (AT+WAKEUPGPIO) for commands
+    ESP8266_SLEEP_MODEM = 2         // commands are accepted at any time
+} SleepMode;
+
+typedef struct PowerReport {
+    uint32_t wakeups;
+    uint32_t batchedSends;          // application sends completed in wake windows
+    uint32_t reconnects;
+    uint32_t warmWindows;           // wake windows that reused open socket
+    uint32_t awakeMillis;           // sleep disabled
+    uint32_t sleepMillis;
+    uint32_t warmSleepMillis;       // part of sleep with open socket
+    uint32_t radioOnMillisPerHour;  // estimated from awake and sleep time
+} PowerReport;
+
+typedef enum PowerWindowStep {      // next wake window command, one is queued per tick
+    ESP8266_POWER_WINDOW_IDLE = 0,  // waiting for next window
+    ESP8266_POWER_WINDOW_WAKE,
+    ESP8266_POWER_WINDOW_CONNECT,
+    ESP8266_POWER_WINDOW_OPEN,
+    ESP8266_POWER_WINDOW_SEND,
+    ESP8266_POWER_WINDOW_CLOSE,
+    ESP8266_POWER_WINDOW_SLEEP
+} PowerWindowStep;
+
+typedef struct PowerScheduler {     // batched sends, module sleeps between wake windows
+    SleepMode mode;
+    bool isActive;
+    bool isSleeping;
+    bool isCommandPending;          // window command is in command queue
+    PowerWindowStep step;
+    ConnectionID id;
+    SocketConfig endpoint;
+    char host[ESP8266_HOST_MAX_LENGTH + 1];
+    uint32_t wakeIntervalMillis;
+    uint32_t nextWakeMillis;
+    uint32_t stateStartMillis;      // start of current sleep or awake period
+    uint32_t reconnectMillis;       // smoothed socket open time, for keep warm decision
+    uint32_t lastWakeMillis;
+    uint32_t windowGapMillis;       // smoothed time between wake windows, shorter than interval when batch fills up
+    uint32_t connectStartMillis;
+    SendSegment batch[ESP8266_POWER_BATCH_SIZE];
+    uint8_t batchSize;
+    uint8_t sendingCount;           // batch segments of AT+CIPSEND in progress
+    PowerReport report;
+} PowerScheduler;
+
+typedef struct PingStatistics {     // updated as probes complete, samples are not stored
+    uint16_t sent;
+    uint16_t received;
+    uint16_t lost;                  // "+timeout", error or no response
+    uint8_t lossPercent;
+    int32_t lastMillis;             // last probe round trip, ESP8266_PING_PACKET_TIMEOUT_VALUE if lost
+    uint32_t minMillis;
+    uint32_t maxMillis;
+    uint32_t avgMillis;
+    uint32_t jitterMillis;          // mean difference between consecutive round trips
+    bool isComplete;
+} PingStatistics;
+
+typedef struct PingEngine {
+    char host[ESP8266_HOST_MAX_LENGTH + 1];
+    uint16_t probeCount;
+    uint16_t intervalMillis;
+    uint32_t nextProbeMillis;
+    uint32_t totalMillis;           // sum of received round trips
+    uint32_t totalDeltaMillis;      // sum of differences between consecutive received round trips
+    int32_t previousMillis;         // last received round trip, for jitter
+    bool isActive;
+    bool isProbePending;
+    uint16_t generation;            // run number passed to probe callback, probe of stopped run is not counted
+    PingStatistics statistics;
+} PingEngine;
+
+typedef struct InitProgress {   // cooperative initialization state
+    InitPhase phase;
+    bool isCommandSent;
+    uint8_t attempt;
+    uint32_t phaseStartMillis;
+    uint32_t retryAtMillis;
+    uint32_t phaseTimeMillis[ESP8266_INIT_READY];   // time spent in each phase, for cold start measurement
+} InitProgress;
+
+#if defined(ESP8266_ENABLE_METRICS)
+typedef enum ESP8266CommandType {
+    ESP8266_COMMAND_OTHER,
+    ESP8266_COMMAND_SEND,       // AT+CIPSEND handshake until ">" prompt
+    ESP8266_COMMAND_CONNECT,
+    ESP8266_COMMAND_STATUS,
+    ESP8266_COMMAND_JOIN,
+    ESP8266_COMMAND_SCAN,
+    ESP8266_COMMAND_PING,
+    ESP8266_COMMAND_TYPE_COUNT
+} CommandType;
+
+typedef struct LatencyHistogram {
+    uint32_t buckets[ESP8266_LATENCY_BUCKET_COUNT];  // bucket n counts latencies in [2^n, 2^(n+1)) cycles
+    uint32_t count;
+    uint32_t maxCycles;
+} LatencyHistogram;
+
+typedef struct WiFiMetrics {
+    LatencyHistogram latency[ESP8266_COMMAND_TYPE_COUNT];
+    uint32_t polls;             // readResponseESP8266() calls
+    uint32_t timeouts;
+    uint32_t errors;
+    uint32_t retries;
+    uint32_t txBytes;
+    uint32_t rxBytes;
+    uint32_t rxHighWaterMark;   // max pending bytes in RX buffer
+    uint32_t fastJoins;         // successful joins with cached bssid
+    uint32_t fastJoinFailures;
+    uint32_t fastJoinMillis;    // total time of successful fast joins
+    uint32_t fullJoins;         // successful joins after scan
+    uint32_t fullJoinMillis;    // total time of successful full joins, including scan
+    uint32_t sends;             // payloads handed to DMA after ">" prompt
+    uint32_t sendCycles;        // total send latency, from send call to payload DMA start
+    uint32_t maxSendCycles;
+    uint32_t sendStartCycles;
+    CommandType commandType;    // command in flight
+    uint32_t commandStartCycles;
+    bool isCommandMeasured;
+} WiFiMetrics;
+#endif
+
+#if defined(ESP8266_ENABLE_TRACE)
+typedef enum ESP8266TraceDirection {
+    ESP8266_TRACE_TX = 0,
+    ESP8266_TRACE_RX = 1
+} TraceDirection;
+
+typedef struct TraceRing {  // variable length records, oldest are dropped when full
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t droppedRecords;
+    char buffer[ESP8266_TRACE_BUFFER_SIZE];
+} TraceRing;
+
+typedef void (*TraceWriter)(const char *data, uint32_t length, void *context);  // debug port output
+#endif
+
 typedef struct WiFi {
+    USART_DMA *USARTDma;
+    bool isStaticallyAllocated;
     RequestData *request;
     ResponseData *response;
     bool isNeedToSaveCredentials;
     ConnectionMode connectionMode;
+    IPDFramer framer;
+    ReceiveQueue receiveQueue[ESP8266_CONNECTION_COUNT];
+    TransparentStream stream;
+    bool isSendPending;             // datagram sent without waiting for "SEND OK"
+    ResponseStatus lastSendStatus;  // result of last pending send
+    ServerState server;
+    CommandQueue commandQueue;
+    InitProgress init;
+    UrcDispatcher urc;
+    LinkState link;
+    ScanParser scan;
+    KnownNetworkTable knownNetworks;
+    SoftApClientTable softApClients;
+    LinkSupervisor supervisor;
+    PingEngine ping;
+    PowerScheduler power;
+    char commandLane[ESP8266_COMMAND_MAX_LENGTH];   // blocking commands are built here, TX buffer is left to request body
+#if defined(ESP8266_ENABLE_METRICS)
+    WiFiMetrics metrics;
+#endif
+#if defined(ESP8266_ENABLE_TRACE)
+    TraceRing trace;
+#endif
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    RxRing rxRing;
+#endif
 } WiFi;
 
+typedef struct WiFiStaticStorage {  // caller provided memory of whole instance, USART_DMA transport and DMA buffers included
+    WiFi wifi;
+    RequestData request;
+    ResponseData response;
+    USART_DMA USARTDma;
+    USART_DMA_Data rxData;
+    USART_DMA_Data txData;
+    char rxBuffer[ESP8266_STATIC_RX_BUFFER_SIZE];
+    char txBuffer[ESP8266_STATIC_TX_BUFFER_SIZE];
+} WiFiStaticStorage;
+
+#if defined(ESP8266_STATIC_RAM_LIMIT)   // fail build when enabled features don't fit to RAM budget
+ESP8266_STATIC_ASSERT(sizeof(struct WiFiStaticStorage) <= ESP8266_STATIC_RAM_LIMIT, esp8266StaticStorageExceedsRamLimit);
+#endif
+
+typedef struct MemoryFootprint {    // RAM bytes used by each part of instance, parts sum up to staticStorage
+    uint32_t controlBlock;      // request, response, USART_DMA and state not listed below
+    uint32_t dmaBuffers;        // static RX and TX DMA buffers
+    uint32_t receiveQueues;
+    uint32_t commandQueue;
+    uint32_t commandLane;
+    uint32_t urcDispatcher;
+    uint32_t server;
+    uint32_t knownNetworks;
+    uint32_t softApClients;
+    uint32_t supervisor;
+    uint32_t ping;
+    uint32_t power;
+    uint32_t metrics;           // 0 without ESP8266_ENABLE_METRICS
+    uint32_t trace;             // 0 without ESP8266_ENABLE_TRACE
+    uint32_t rxRing;            // 0 without ESP8266_RX_CIRCULAR_MODE
+    uint32_t staticStorage;     // total size of WiFiStaticStorage
+} MemoryFootprint;
+
 
 WiFi *initWifiESP8266(USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream, uint32_t rxBufferSize, uint32_t txBufferSize);
+WiFi *createWifiESP8266(USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream, uint32_t rxBufferSize, uint32_t txBufferSize);  // no module interaction, use initStepESP8266()
+WiFi *initStaticWifiESP8266(WiFiStaticStorage *storage, USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream);  // no heap, transport is set up in storage
+WiFi *createStaticWifiESP8266(WiFiStaticStorage *storage, USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream);
+void getMemoryFootprintESP8266(MemoryFootprint *footprint);
+#if defined(ESP8266_ENABLE_METRICS)
+void getMetricsESP8266(WiFi *wifi, WiFiMetrics *snapshot);
+void resetMetricsESP8266(WiFi *wifi);
+#endif
+#if defined(ESP8266_ENABLE_TRACE)
+void dumpTraceESP8266(WiFi *wifi, TraceWriter writer, void *context);  // "ESPT", version, cycles per second, then records
+void clearTraceESP8266(WiFi *wifi);
+ResponseStatus replayTraceESP8266(WiFi *wifi, const char *trace, uint32_t length);   // feed captured RX records to parser
+#endif
+InitPhase initStepESP8266(WiFi *wifi);  // non-blocking initialization, call until ESP8266_INIT_READY or ESP8266_INIT_FAILED
 APConnectionStatus beginESP8266(WiFi *wifi, char *ssid, char *password);    // connect to AP
 ResponseStatus readResponseESP8266(WiFi *wifi);    // non-blocking response read
 ResponseStatus waitForResponseESP8266(WiFi *wifi); // blocking wait
 void setResponseTimeout(WiFi *wifi, uint32_t responseTimeoutMs); // set waiting timeout
 
+// Non-blocking command queue, callback is called from pollESP8266() when command completes
+bool enqueueCommandESP8266(WiFi *wifi, CommandCallback callback, void *context, const char *ATCommand);    // without line end, copied to queue slot
+void pollESP8266(WiFi *wifi);
+void flushCommandQueueESP8266(WiFi *wifi);  // blocking wait for all queued commands
+void setUrcHandlerESP8266(WiFi *wifi, UrcType type, UrcHandler handler, void *context);   // called from pollESP8266() or any response read
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+void rxEventCallbackESP8266(WiFi *wifi);   // call from USART idle line and RX DMA half/full transfer interrupts
+#endif
+
 // Common commands
 ResponseStatus healthCheckESP8266(WiFi *wifi);
 ResponseStatus restartWifiESP8266(WiFi *wifi);
@@ -140,7 +719,8 @@ ResponseStatus resetConfigurationESP8266(WiFi *wifi);   // drop all configuratio
 ResponseStatus setWifiModeESP8266(WiFi *wifi, WiFiMode wifiMod);
 ResponseStatus setConnectionModeESP8266(WiFi *wifi, ConnectionMode connectionMode);
 ResponseStatus setApplicationModeESP8266(WiFi *wifi, TransferMode transferMode);
-ResponseStatus enableDeepSleepModeESP8266(WiFi *wifi, uint16_t timeToSleepMs);
+ResponseStatus enableDeepSleepModeESP8266(WiFi *wifi, uint32_t timeToSleepMs);
+ResponseStatus setSleepModeESP8266(WiFi *wifi, SleepMode mode);    // station only, link to access point is kept
 
 ConnectionStatus getConnectionStatusESP8266(WiFi *wifi);    // get current connection status
 
@@ -148,16 +728,52 @@ void connectToAccessPointESP8266(WiFi *wifi, char *ssid, char *password); // Con
 APConnectionStatus getAccessPointConnectionStatusESP8266(WiFi *wifi);
 ResponseStatus disconnectFromAccessPointESP8266(WiFi *wifi);
 
+// Known networks reconnect
+bool addKnownNetworkESP8266(WiFi *wifi, const char *ssid, const char *password);   // updates password if already known
+void clearKnownNetworksESP8266(WiFi *wifi);
+APConnectionStatus connectKnownNetworkESP8266(WiFi *wifi);  // cached bssid first, then scan and join strongest known network
+
+// Link supervisor, rejoins known networks and reopens registered endpoints
+void startSupervisorESP8266(WiFi *wifi);
+void stopSupervisorESP8266(WiFi *wifi);
+bool superviseEndpointESP8266(WiFi *wifi, ConnectionID id, const SocketConfig *config);  // id is ignored for single connection
+void releaseEndpointESP8266(WiFi *wifi, ConnectionID id);   // stop reopening, connection is not closed
+SupervisorState superviseESP8266(WiFi *wifi);   // call periodically instead of pollESP8266()
+
 // Connect to server
 ResponseStatus connectESP8266(WiFi *wifi, char *host, uint16_t port);
 ResponseStatus multipleConnectESP8266(WiFi *wifi, ConnectionID id, char *host, char *port);
+ResponseStatus connectSocketESP8266(WiFi *wifi, ConnectionID id, const SocketConfig *config);  // id is ignored for single connection
 ResponseStatus checkForConnectionESP8266(WiFi *wifi);
 ResponseStatus closeConnectionESP8266(WiFi *wifi);
 ResponseStatus closeConnectionByIdESP8266(WiFi *wifi, ConnectionID id);
 
 ResponseStatus sendESP8266(WiFi *wifi, char *data);
+ResponseStatus sendDataESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length);    // binary safe, id is ignored for single connection
 ResponseStatus sendRequestBodyESP8266(WiFi *wifi);
 ResponseStatus sendRequestBodyByIdESP8266(WiFi *wifi, ConnectionID id);
+ResponseStatus sendVectorESP8266(WiFi *wifi, ConnectionID id, const SendSegment *segments, uint8_t segmentCount);  // id is ignored for single connection
+ResponseStatus sendLargeESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length, StreamSendReport *report);  // any length, report can be NULL
+ResponseStatus sendStreamESP8266(WiFi *wifi, ConnectionID id, PayloadProducer producer, void *context,
+                                 char *workBuffer, uint32_t workBufferLength, StreamSendReport *report);  // next chunk is produced while current is sent
+ResponseStatus sendDatagramESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length);    // returns after data is sent to module, "SEND OK" is collected before next command
+
+// Transparent transmission, single connection only
+ResponseStatus beginTransparentStreamESP8266(WiFi *wifi);
+uint32_t writeTransparentStreamESP8266(WiFi *wifi, const char *data, uint32_t length);  // non-blocking, returns number of accepted bytes
+ResponseStatus endTransparentStreamESP8266(WiFi *wifi);     // blocks for ESP8266_TRANSPARENT_PACKET_GAP_MS + ESP8266_TRANSPARENT_EXIT_GUARD_MS and AT+CIPMODE=0
+
+// Server, requires multiple connections. Accepted and closed connections are reported by unsolicited result codes
+ResponseStatus startServerESP8266(WiFi *wifi, uint16_t port, uint16_t timeoutSeconds);    // timeout 0 - 7200 s, 0 - never
+ResponseStatus stopServerESP8266(WiFi *wifi);    // started send continues until response timeout, then rest is dropped
+bool writeServerConnectionESP8266(WiFi *wifi, ConnectionID id, const char *data, uint32_t length);  // false if previous data is not sent yet
+uint32_t pendingServerDataESP8266(WiFi *wifi, ConnectionID id);
+void closeServerConnectionESP8266(WiFi *wifi, ConnectionID id);    // after pending data is sent
+void serveESP8266(WiFi *wifi);     // call periodically instead of pollESP8266(), sends one chunk at a time
+
+// Received data, for single connection use CONNECTION_ID_0
+uint32_t availableDataByIdESP8266(WiFi *wifi, ConnectionID id);
+uint32_t readDataByIdESP8266(WiFi *wifi, ConnectionID id, char *buffer, uint32_t length);   // returns number of copied bytes
 
 // Local IP and MAC
 void getLocalInfoESP8266(WiFi *wifi, LocalInfo *localInfo);
@@ -165,17 +781,30 @@ void getLocalInfoESP8266(WiFi *wifi, LocalInfo *localInfo);
 // Network scan
 void requestAvailableAccessPointsESP8266(WiFi *wifi);
 AccessPointList getAvailableAccessPointsESP8266(WiFi *wifi);
+ResponseStatus scanAccessPointsESP8266(WiFi *wifi, AccessPointList *list, AccessPointCallback callback, void *context);  // list or callback can be NULL
 
 // Soft AP
 ResponseStatus enableSoftApESP8266(WiFi *wifi, char *ssid, char *password, uint8_t channel, WifiEncryptionType encryption);
 ResponseStatus enableOpenSoftApESP8266(WiFi *wifi, char *ssid, uint8_t channel);
-uint8_t numberOfConnectedClientsESP8266(WiFi *wifi);
-SoftAPClient getSoftApClientInfo(WiFi *wifi, uint8_t clientNumber);
+ResponseStatus refreshSoftApClientsESP8266(WiFi *wifi);   // single AT+CWLIF, result and changes in wifi->softApClients
+uint8_t numberOfConnectedClientsESP8266(WiFi *wifi);    // refreshes client table
+SoftAPClient getSoftApClientInfo(WiFi *wifi, uint8_t clientNumber);     // from last refreshed table
 void setSoftApIP(WiFi *wifi, char *ipAddress);
 
+// Power scheduler, application sends are batched into wake windows
+bool startPowerSchedulerESP8266(WiFi *wifi, SleepMode mode, uint32_t wakeIntervalMillis, ConnectionID id, const SocketConfig *endpoint);     // modem sleep or disabled, false for light sleep
+void stopPowerSchedulerESP8266(WiFi *wifi);     // sleep is disabled, unsent data is dropped
+bool queuePowerSendESP8266(WiFi *wifi, const char *data, uint32_t length);     // data must stay valid until sent, false if batch is full
+void schedulePowerESP8266(WiFi *wifi);  // call periodically instead of pollESP8266(), wake window commands go through command queue
+PowerReport getPowerReportESP8266(WiFi *wifi);
+
 // Ping
 void pingPacketESP8266(WiFi *wifi, char *host);
-int32_t getPacketPingTimeESP8266();
+int32_t getPacketPingTimeESP8266(WiFi *wifi);   // round trip of last AT+PING in ms, ESP8266_PING_PACKET_TIMEOUT_VALUE if lost
+bool startPingESP8266(WiFi *wifi, const char *host, uint16_t probeCount, uint16_t intervalMillis);  // false if host is too long or ping is running
+void stopPingESP8266(WiFi *wifi);   // probe in flight is still completed, but not counted
+bool pollPingESP8266(WiFi *wifi);   // call periodically instead of pollESP8266(), true when all probes are completed
+PingStatistics getPingStatisticsESP8266(WiFi *wifi);
 
 void deleteESP8266(WiFi *wifi);
 
@@ -0,0 +1,265 @@
+#include "TestSupport.h"
+
+static void testInitSequence(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_EQ(5, simulator.commandCount);   // AT, ATE0, AT+CWMODE, AT+CIPMUX, AT+CIPMODE
+    ASSERT_STR_EQ("AT+CIPMODE=0", simulator.lastCommand);
+    ASSERT_TRUE(!simulator.isEchoEnabled);
+    ASSERT_EQ(ESP8266_INIT_READY, wifi->init.phase);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testJoinAccessPoint(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_STR_EQ("AT+CWJAP_CUR=\"home\",\"secret\"", simulator.lastCommand);
+    ASSERT_EQ(ESP8266_CONNECTED_TO_AP, getConnectionStatusESP8266(wifi));
+
+    connectToAccessPointESP8266(wifi, "home", "wrong");
+    APConnectionStatus status;
+    do {
+        status = getAccessPointConnectionStatusESP8266(wifi);
+    } while (status == ESP8266_WIFI_WAITING_FOR_CONNECTION);
+    ASSERT_EQ(ESP8266_WRONG_PASSWORD, status);
+
+    connectToAccessPointESP8266(wifi, "office", "secret");
+    ASSERT_TRUE(isResponseStatusError(waitForResponseESP8266(wifi)));
+    ASSERT_EQ(ESP8266_NOT_FOUND_TARGET_AP, getAccessPointConnectionStatusESP8266(wifi));
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testConnectAndSend(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+    ASSERT_STR_EQ("AT+CIPSTART=\"TCP\",\"example.com\",80", simulator.lastCommand);
+    ASSERT_TRUE(isResponseStatusError(connectESP8266(wifi, "example.com", 80)));   // ALREADY CONNECTED
+
+    simulator.isPayloadEchoed = true;   // server replies with same data
+    ResponseStatus status = sendESP8266(wifi, "hello");
+    if (isResponseStatusWaiting(status)) {
+        status = waitForResponseESP8266(wifi);
+    }
+    ASSERT_TRUE(isResponseStatusSuccess(status));
+    ASSERT_EQ(1, simulator.sendCount);
+    ASSERT_EQ(7, simulator.payloadLength);
+    ASSERT_MEM_EQ("hello\r\n", simulator.payload, 7);
+
+    char buffer[16] = {0};
+    ASSERT_EQ(7, availableDataByIdESP8266(wifi, CONNECTION_ID_0));
+    ASSERT_EQ(7, readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));
+    ASSERT_STR_EQ("hello\r\n", buffer);
+    ASSERT_TRUE(isResponseStatusSuccess(closeConnectionESP8266(wifi)));
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testQuotedArguments(void) {     // host text can't end quoted argument or add arguments
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "a\"b,c\\d", 80)));
+    ASSERT_STR_EQ("AT+CIPSTART=\"TCP\",\"a\\\"b\\,c\\\\d\",80", simulator.lastCommand);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testUnsolicitedData(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+
+    sendSimulatorData(&simulator, CONNECTION_ID_0, "push", 4);
+    for (uint32_t i = 0; i < 1000 && availableDataByIdESP8266(wifi, CONNECTION_ID_0) == 0; i++) {
+        pollTestWifi(wifi);
+    }
+    char buffer[8] = {0};
+    ASSERT_EQ(4, readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));
+    ASSERT_STR_EQ("push", buffer);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testScanAccessPoints(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    addTestAccessPoint(&simulator, "weak", "1", -85);
+    addTestAccessPoint(&simulator, "strong", "2", -40);
+    addTestAccessPoint(&simulator, "with \"quote\"", "3", -60);
+
+    AccessPointList list = {0};
+    ASSERT_TRUE(isResponseStatusSuccess(scanAccessPointsESP8266(wifi, &list, NULL, NULL)));
+    ASSERT_EQ(3, list.size);
+    ASSERT_STR_EQ("strong", list.accessPointArray[0].ssid);
+    ASSERT_EQ(-40, list.accessPointArray[0].signalStrength);
+    ASSERT_STR_EQ("with \"quote\"", list.accessPointArray[1].ssid);
+    ASSERT_STR_EQ("weak", list.accessPointArray[2].ssid);
+    ASSERT_EQ(6, list.accessPointArray[2].channel);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testScanOptionsAfterRestart(void) {    // module forgets AT+CWLAPOPT, it is sent again
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    addTestAccessPoint(&simulator, "weak", "1", -85);
+    addTestAccessPoint(&simulator, "strong", "2", -40);
+    AccessPointList list = {0};
+    ASSERT_TRUE(isResponseStatusSuccess(scanAccessPointsESP8266(wifi, &list, NULL, NULL)));
+    uint32_t commandCount = simulator.commandCount;
+    ASSERT_TRUE(isResponseStatusSuccess(scanAccessPointsESP8266(wifi, &list, NULL, NULL)));
+    ASSERT_EQ(commandCount + 1, simulator.commandCount);  // only AT+CWLAP
+
+    ASSERT_TRUE(isResponseStatusSuccess(restartWifiESP8266(wifi)));
+    ASSERT_TRUE(!simulator.isScanSorted);
+    advanceTimeHost(SIMULATOR_RESTART_US + 1000);
+    ASSERT_TRUE(isResponseStatusSuccess(scanAccessPointsESP8266(wifi, &list, NULL, NULL)));
+    ASSERT_TRUE(simulator.isScanSorted);
+    ASSERT_STR_EQ("strong", list.accessPointArray[0].ssid);
+
+    ASSERT_TRUE(isResponseStatusSuccess(resetConfigurationESP8266(wifi)));
+    advanceTimeHost(SIMULATOR_RESTART_US + 1000);
+    ASSERT_TRUE(isResponseStatusSuccess(scanAccessPointsESP8266(wifi, &list, NULL, NULL)));
+    ASSERT_TRUE(simulator.isScanSorted);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testPing(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.pingMillis = 23;
+    pingPacketESP8266(wifi, "8.8.8.8");
+    ASSERT_TRUE(isResponseStatusSuccess(waitForResponseESP8266(wifi)));
+    ASSERT_EQ(23, getPacketPingTimeESP8266(wifi));
+
+    simulator.pingMillis = 0;
+    pingPacketESP8266(wifi, "8.8.8.8");
+    ASSERT_TRUE(isResponseStatusError(waitForResponseESP8266(wifi)));
+    ASSERT_EQ(ESP8266_PING_PACKET_TIMEOUT_VALUE, getPacketPingTimeESP8266(wifi));
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testPingRestartDuringProbe(void) {     // probe of stopped run completes in new run, it is not counted
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.pingMillis = 80;
+    ASSERT_TRUE(startPingESP8266(wifi, "8.8.8.8", 3, 100));
+    for (uint32_t i = 0; i < 1000 && getPingStatisticsESP8266(wifi).sent == 0; i++) {
+        pollTimeHost();
+        pollPingESP8266(wifi);
+    }
+    ASSERT_EQ(1, getPingStatisticsESP8266(wifi).sent);
+    stopPingESP8266(wifi);
+    ASSERT_TRUE(startPingESP8266(wifi, "8.8.8.8", 2, 10));
+    simulator.pingMillis = 20;
+
+    bool isComplete = false;
+    for (uint32_t i = 0; i < 100000 && !isComplete; i++) {
+        pollTimeHost();
+        isComplete = pollPingESP8266(wifi);
+    }
+    ASSERT_TRUE(isComplete);
+    PingStatistics statistics = getPingStatisticsESP8266(wifi);
+    ASSERT_EQ(2, statistics.sent);
+    ASSERT_EQ(2, statistics.received);
+    ASSERT_EQ(0, statistics.lost);
+    ASSERT_EQ(20, statistics.maxMillis);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testPowerSchedulerMode(void) {     // module in light sleep doesn't take commands without wake up GPIO
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    SocketConfig collector = {.type = ESP8266_SOCKET_TCP, .host = "192.168.1.10", .port = 5000};
+    uint32_t commandCount = simulator.commandCount;
+    ASSERT_TRUE(!startPowerSchedulerESP8266(wifi, ESP8266_SLEEP_LIGHT, 30000, CONNECTION_ID_0, &collector));
+    ASSERT_EQ(commandCount, simulator.commandCount);
+    ASSERT_TRUE(!wifi->power.isActive);
+
+    ASSERT_TRUE(startPowerSchedulerESP8266(wifi, ESP8266_SLEEP_MODEM, 30000, CONNECTION_ID_0, &collector));
+    ASSERT_STR_EQ("AT+SLEEP=2", simulator.lastCommand);
+    ASSERT_TRUE(wifi->power.isActive);
+    stopPowerSchedulerESP8266(wifi);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testPowerWindowThroughQueue(void) {    // wake window advances over ticks, no tick waits for module response
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    SocketConfig collector = {.type = ESP8266_SOCKET_TCP, .host = "192.168.1.10", .port = 5000};
+    ASSERT_TRUE(!startPowerSchedulerESP8266(wifi, ESP8266_SLEEP_MODEM, 1000, CONNECTION_ID_0, NULL));
+    ASSERT_TRUE(startPowerSchedulerESP8266(wifi, ESP8266_SLEEP_MODEM, 1000, CONNECTION_ID_0, &collector));
+    ASSERT_TRUE(!startPowerSchedulerESP8266(wifi, ESP8266_SLEEP_MODEM, 1000, CONNECTION_ID_0, &collector));
+    simulator.connectMicros = 300000;
+    simulator.sendAckMicros = 100000;
+    ASSERT_TRUE(queuePowerSendESP8266(wifi, "first", 5));
+    ASSERT_TRUE(queuePowerSendESP8266(wifi, "second", 6));
+    ASSERT_TRUE(!queuePowerSendESP8266(wifi, NULL, 6));
+
+    uint64_t longestTickMicros = 0;
+    uint64_t endMicros = getMicrosHost() + 3000000;
+    while (getMicrosHost() < endMicros) {
+        pollTimeHost();
+        uint64_t startMicros = getMicrosHost();
+        schedulePowerESP8266(wifi);
+        uint64_t tickMicros = getMicrosHost() - startMicros;
+        if (tickMicros > longestTickMicros) {
+            longestTickMicros = tickMicros;
+        }
+    }
+    ASSERT_TRUE(longestTickMicros < 50000);     // shorter than socket open or send acknowledge
+    PowerReport report = getPowerReportESP8266(wifi);
+    ASSERT_EQ(1, report.wakeups);
+    ASSERT_EQ(1, report.reconnects);
+    ASSERT_EQ(2, report.batchedSends);
+    ASSERT_EQ(1, simulator.sendCount);  // stream socket sends share AT+CIPSEND
+    ASSERT_EQ(11, simulator.payloadLength);
+    ASSERT_MEM_EQ("firstsecond", simulator.payload, 11);
+    ASSERT_STR_EQ("AT+SLEEP=2", simulator.lastCommand);
+    ASSERT_TRUE(wifi->power.isSleeping);
+    ASSERT_EQ(ESP8266_POWER_WINDOW_IDLE, wifi->power.step);
+    stopPowerSchedulerESP8266(wifi);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testCommandTimeout(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    scriptSimulatorResponse(&simulator, "AT+CIPSTATUS", NULL, 1);   // module doesn't answer
+    setResponseTimeout(wifi, 200);
+    uint64_t startMicros = getMicrosHost();
+    ASSERT_EQ(ESP8266_CONNECT_UNKNOWN_ERROR, getConnectionStatusESP8266(wifi));
+    uint64_t elapsedMicros = getMicrosHost() - startMicros;
+    ASSERT_TRUE(elapsedMicros >= 199000 && elapsedMicros < 201000);     // millisecond clock resolution
+    ASSERT_EQ(ESP8266_NOT_CONNECTED_TO_AP, getConnectionStatusESP8266(wifi));
+    deleteTestWifi(wifi, &simulator);
+}
+
+int main(void) {
+    RUN_TEST(testInitSequence);
+    RUN_TEST(testJoinAccessPoint);
+    RUN_TEST(testConnectAndSend);
+    RUN_TEST(testQuotedArguments);
+    RUN_TEST(testUnsolicitedData);
+    RUN_TEST(testScanAccessPoints);
+    RUN_TEST(testScanOptionsAfterRestart);
+    RUN_TEST(testPing);
+    RUN_TEST(testPingRestartDuringProbe);
+    RUN_TEST(testPowerSchedulerMode);
+    RUN_TEST(testPowerWindowThroughQueue);
+    RUN_TEST(testCommandTimeout);
+    return finishTests();
+}
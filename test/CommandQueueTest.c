@@ -0,0 +1,218 @@
+#include "TestSupport.h"
+
+typedef struct Completion {
+    ESP8266Simulator *simulator;
+    ResponseStatus statuses[ESP8266_COMMAND_QUEUE_SIZE * 2];
+    char commands[ESP8266_COMMAND_QUEUE_SIZE * 2][SIMULATOR_LINE_LENGTH];
+    uint32_t completedMicros[ESP8266_COMMAND_QUEUE_SIZE * 2];
+    uint32_t count;
+} Completion;
+
+static void onCommand(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) wifi;
+    Completion *completion = context;
+    completion->statuses[completion->count] = status;
+    strcpy(completion->commands[completion->count], completion->simulator->lastCommand);  // next command isn't sent yet
+    completion->completedMicros[completion->count] = (uint32_t) getMicrosHost();
+    completion->count++;
+}
+
+static void waitForCompletions(WiFi *wifi, Completion *completion, uint32_t count) {
+    for (uint32_t i = 0; i < 100000 && completion->count < count; i++) {
+        pollTestWifi(wifi);
+    }
+}
+
+static void testOrderAndPipelining(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    Completion completion = {.simulator = &simulator};
+    uint32_t commandCount = simulator.commandCount;
+    uint32_t transmitCalls = TEST_USART->transmitCalls;
+
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CWMODE=1"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPSTATUS"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPMUX=0"));
+    ASSERT_TRUE(!enqueueCommandESP8266(wifi, onCommand, &completion, "AT"));     // queue is full
+    ASSERT_EQ(transmitCalls + 1, TEST_USART->transmitCalls);   // only first command is on the line
+
+    waitForCompletions(wifi, &completion, 4);
+    ASSERT_EQ(4, completion.count);
+    ASSERT_STR_EQ("AT", completion.commands[0]);
+    ASSERT_STR_EQ("AT+CWMODE=1", completion.commands[1]);
+    ASSERT_STR_EQ("AT+CIPSTATUS", completion.commands[2]);
+    ASSERT_STR_EQ("AT+CIPMUX=0", completion.commands[3]);
+    for (uint32_t i = 0; i < 4; i++) {
+        ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, completion.statuses[i]);
+    }
+    uint32_t roundTripMicros = getTransferMicrosHost(TEST_USART, 20) + simulator.latencyMicros;
+    for (uint32_t i = 1; i < 4; i++) {      // next command leaves in same poll as previous OK, no idle round
+        ASSERT_TRUE(completion.completedMicros[i] - completion.completedMicros[i - 1] < 2 * roundTripMicros);
+    }
+    ASSERT_EQ(commandCount + 4, simulator.commandCount);
+    ASSERT_TRUE(!wifi->commandQueue.isInFlight);
+    ASSERT_TRUE(isResponseStatusSuccess(healthCheckESP8266(wifi)));   // blocking API works after queue is drained
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testErrorPropagation(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    Completion completion = {.simulator = &simulator};
+    scriptSimulatorResponse(&simulator, "AT+CIPCLOSE", "\r\nERROR\r\n", 1);
+    scriptSimulatorResponse(&simulator, "AT+CIPSTART", "\r\nbusy p...\r\n\r\nFAIL\r\n", 1);
+
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPCLOSE"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPSTART=\"TCP\",\"example.com\",80"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT"));
+    waitForCompletions(wifi, &completion, 3);
+    ASSERT_EQ(3, completion.count);
+    ASSERT_EQ(ESP8266_RESPONSE_ERROR, completion.statuses[0]);
+    ASSERT_EQ(ESP8266_RESPONSE_ERROR, completion.statuses[1]);
+    ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, completion.statuses[2]);   // failed command doesn't stall queue
+    ASSERT_STR_EQ("AT", completion.commands[2]);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testBusyInterimStatus(void) {  // "busy p..." is followed by command's own final status
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    Completion completion = {.simulator = &simulator};
+    simulator.chunkLength = 13;    // "busy p..." line arrives before final status
+    simulator.chunkGapMicros = 2000;
+    scriptSimulatorResponse(&simulator, "AT+CIPMUX", "\r\nbusy p...\r\n\r\nOK\r\n", 1);
+    scriptSimulatorResponse(&simulator, "AT+CIPCLOSE", "\r\nERROR\r\n", 1);
+
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPMUX=0"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPCLOSE"));
+    waitForCompletions(wifi, &completion, 2);
+    ASSERT_EQ(2, completion.count);
+    ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, completion.statuses[0]);
+    ASSERT_STR_EQ("AT+CIPMUX=0", completion.commands[0]);
+    ASSERT_EQ(ESP8266_RESPONSE_ERROR, completion.statuses[1]);     // late "OK" isn't credited to next command
+
+    scriptSimulatorResponse(&simulator, "AT+CWMODE", "\r\nbusy p...\r\n\r\nOK\r\n", 1);
+    ASSERT_TRUE(isResponseStatusSuccess(setWifiModeESP8266(wifi, ESP8266_STATION)));
+    ASSERT_TRUE(isResponseStatusSuccess(healthCheckESP8266(wifi)));
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testTimeout(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    Completion completion = {.simulator = &simulator};
+    scriptSimulatorResponse(&simulator, "AT+CIPSTATUS", NULL, 1);   // module doesn't answer
+
+    setResponseTimeout(wifi, 150);      // timeout is taken at enqueue
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPSTATUS"));
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT"));
+    uint32_t startMicros = (uint32_t) getMicrosHost();
+    waitForCompletions(wifi, &completion, 2);
+    ASSERT_EQ(2, completion.count);
+    ASSERT_EQ(ESP8266_RESPONSE_TIMEOUT, completion.statuses[0]);
+    uint32_t elapsedMicros = completion.completedMicros[0] - startMicros;
+    ASSERT_TRUE(elapsedMicros >= 149000 && elapsedMicros < 151000);    // millisecond clock resolution
+    ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, completion.statuses[1]);    // late or missing answer doesn't shift responses
+    ASSERT_STR_EQ("AT", completion.commands[1]);
+    ASSERT_EQ(150, wifi->response->timeout);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testFlushAndReuse(void) {    // slots are reused after queue wraps
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    Completion completion = {.simulator = &simulator};
+    char command[] = "AT+CWMODE=1";
+    for (uint32_t i = 0; i < ESP8266_COMMAND_QUEUE_SIZE; i++) {
+        command[sizeof(command) - 2] = (char) ('1' + i % 3);   // slot keeps its own copy
+        ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, command));
+    }
+    flushCommandQueueESP8266(wifi);
+    ASSERT_EQ(ESP8266_COMMAND_QUEUE_SIZE, completion.count);
+    ASSERT_EQ(0, wifi->commandQueue.size);
+    for (uint32_t i = 0; i < ESP8266_COMMAND_QUEUE_SIZE; i++) {
+        ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, completion.statuses[i]);
+    }
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT"));
+    flushCommandQueueESP8266(wifi);
+    ASSERT_EQ(ESP8266_COMMAND_QUEUE_SIZE + 1, completion.count);
+    ASSERT_STR_EQ("AT", completion.commands[ESP8266_COMMAND_QUEUE_SIZE]);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testCommandLength(void) {      // longest command fits slot with line end, longer one is rejected
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    Completion completion = {.simulator = &simulator};
+    char command[ESP8266_COMMAND_MAX_LENGTH];
+    memset(command, 'A', sizeof(command));
+    memcpy(command, "AT+", 3);
+    command[sizeof(command) - 1] = '\0';
+
+    ASSERT_TRUE(!enqueueCommandESP8266(wifi, onCommand, &completion, command));
+    ASSERT_EQ(0, wifi->commandQueue.size);
+    command[sizeof(command) - 2] = '\0';
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, command));
+    waitForCompletions(wifi, &completion, 1);
+    ASSERT_EQ(1, completion.count);
+    ASSERT_STR_EQ(command, completion.commands[0]);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testQueuedAfterPayload(void) {  // command queued behind server chunk waits for "SEND OK" in later polls, not inside one
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(setConnectionModeESP8266(wifi, ESP8266_CONNECTION_MULTIPLE)));
+    ASSERT_TRUE(isResponseStatusSuccess(startServerESP8266(wifi, 80, 10)));
+    acceptSimulatorClient(&simulator, CONNECTION_ID_0);
+    for (uint32_t i = 0; i < 1000 && !(wifi->link.openSockets & (1U << CONNECTION_ID_0)); i++) {
+        pollTestWifi(wifi);
+    }
+
+    static char page[256];
+    memset(page, 'p', sizeof(page));
+    ASSERT_TRUE(writeServerConnectionESP8266(wifi, CONNECTION_ID_0, page, sizeof(page)));
+    simulator.sendAckMicros = 200000;
+    serveESP8266(wifi);     // AT+CIPSEND is queued, payload follows prompt in its callback
+    Completion completion = {.simulator = &simulator};
+    ASSERT_TRUE(enqueueCommandESP8266(wifi, onCommand, &completion, "AT+CIPSTATUS"));
+
+    uint64_t longestPollMicros = 0;
+    for (uint32_t i = 0; i < 100000 && completion.count < 1; i++) {
+        pollTimeHost();
+        uint64_t startMicros = getMicrosHost();
+        serveESP8266(wifi);
+        uint64_t pollMicros = getMicrosHost() - startMicros;
+        if (pollMicros > longestPollMicros) {
+            longestPollMicros = pollMicros;
+        }
+    }
+    ASSERT_EQ(1, completion.count);
+    ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, completion.statuses[0]);
+    ASSERT_STR_EQ("AT+CIPSTATUS", completion.commands[0]);
+    ASSERT_TRUE(longestPollMicros < simulator.sendAckMicros / 4);
+    ASSERT_EQ(ESP8266_RESPONSE_SUCCESS, wifi->lastSendStatus);
+    ASSERT_EQ(sizeof(page), simulator.payloadLength);
+    ASSERT_EQ(0, pendingServerDataESP8266(wifi, CONNECTION_ID_0));
+    deleteTestWifi(wifi, &simulator);
+}
+
+int main(void) {
+    RUN_TEST(testOrderAndPipelining);
+    RUN_TEST(testErrorPropagation);
+    RUN_TEST(testBusyInterimStatus);
+    RUN_TEST(testTimeout);
+    RUN_TEST(testFlushAndReuse);
+    RUN_TEST(testCommandLength);
+    RUN_TEST(testQueuedAfterPayload);
+    return finishTests();
+}
@@ -0,0 +1,223 @@
+#include "TestSupport.h"
+
+static WiFi *createConnectedWifi(ESP8266Simulator *simulator) {
+    WiFi *wifi = createTestWifi(simulator);
+    if (wifi == NULL) return NULL;
+    if (!joinTestAccessPoint(wifi, simulator) || !isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80))) {
+        deleteTestWifi(wifi, simulator);
+        return NULL;
+    }
+    simulator->isPayloadEchoed = true;
+    clearSimulatorPayload(simulator);
+    return wifi;
+}
+
+static ResponseStatus completeSend(WiFi *wifi, ResponseStatus status) {
+    return isResponseStatusWaiting(status) ? waitForResponseESP8266(wifi) : status;
+}
+
+static void testVectorSendWithoutCopy(void) {   // segments go to DMA straight from caller memory
+    ESP8266Simulator simulator;
+    WiFi *wifi = createConnectedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    static const char header[] = "POST /data HTTP/1.1\r\nContent-Length: 5\r\n\r\n";
+    static const char body[] = "12345";
+    SendSegment segments[] = {
+            {header, sizeof(header) - 1},
+            {NULL, 0},      // empty segment is skipped
+            {body, sizeof(body) - 1}
+    };
+    memset(wifi->request->requestBody, '#', wifi->request->bufferSize);
+    uint32_t transmitCalls = TEST_USART->transmitCalls;
+    uint32_t txBytes = TEST_USART->txBytes;
+
+    ASSERT_TRUE(isResponseStatusSuccess(completeSend(wifi, sendVectorESP8266(wifi, CONNECTION_ID_0, segments, 3))));
+    ASSERT_EQ(3, TEST_USART->transmitCalls - transmitCalls);    // AT+CIPSEND and two segments
+    ASSERT_TRUE(getRecentTransmit(1) == header);
+    ASSERT_TRUE(getRecentTransmit(0) == body);
+    ASSERT_EQ(strlen("AT+CIPSEND=47\r\n") + 47, TEST_USART->txBytes - txBytes);
+    ASSERT_STR_EQ("AT+CIPSEND=47", simulator.lastCommand);
+    ASSERT_EQ(47, simulator.payloadLength);
+    ASSERT_MEM_EQ(header, simulator.payload, sizeof(header) - 1);
+    ASSERT_MEM_EQ(body, &simulator.payload[sizeof(header) - 1], sizeof(body) - 1);
+    for (uint32_t i = 0; i < wifi->request->bufferSize; i++) {
+        ASSERT_EQ('#', wifi->request->requestBody[i]);     // TX buffer is not used as staging copy
+    }
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testVectorSendLimits(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createConnectedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    static char large[1200];
+    SendSegment empty = {NULL, 0};
+    SendSegment tooLong[] = {{large, sizeof(large)}, {large, sizeof(large)}};   // over AT+CIPSEND limit
+    uint32_t transmitCalls = TEST_USART->transmitCalls;
+    ASSERT_TRUE(isResponseStatusError(sendVectorESP8266(wifi, CONNECTION_ID_0, &empty, 1)));
+    ASSERT_TRUE(isResponseStatusError(sendVectorESP8266(wifi, CONNECTION_ID_0, tooLong, 2)));
+    ASSERT_EQ(transmitCalls, TEST_USART->transmitCalls);   // rejected before module interaction
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void fillRandom(char *data, uint32_t length, uint32_t *seed) {
+    for (uint32_t i = 0; i < length; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        data[i] = (char) (*seed >> 16);
+    }
+}
+
+static void testBinaryRoundTrip(void) {     // random blobs with NUL bytes are echoed back by simulated server
+    ESP8266Simulator simulator;
+    WiFi *wifi = createConnectedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    static const uint32_t LENGTHS[] = {1, 2, 17, 255, ESP8266_RECEIVE_QUEUE_SIZE - 1};  // echo fits receive queue
+    char data[ESP8266_RECEIVE_QUEUE_SIZE];
+    char buffer[sizeof(data)];
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < sizeof(LENGTHS) / sizeof(LENGTHS[0]); i++) {
+        uint32_t length = LENGTHS[i];
+        fillRandom(data, length, &seed);
+        data[0] = '\0';
+        data[length / 2] = '\0';
+        clearSimulatorPayload(&simulator);
+        ASSERT_TRUE(isResponseStatusSuccess(completeSend(wifi, sendDataESP8266(wifi, CONNECTION_ID_0, data, length))));
+        ASSERT_EQ(length, simulator.payloadLength);
+        ASSERT_MEM_EQ(data, simulator.payload, length);
+
+        for (uint32_t j = 0; j < 1000 && availableDataByIdESP8266(wifi, CONNECTION_ID_0) < length; j++) {
+            pollESP8266(wifi);
+        }
+        ASSERT_EQ(length, readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));
+        ASSERT_MEM_EQ(data, buffer, length);
+    }
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testBinaryUnsolicitedData(void) {  // "\r\nOK\r\n" and NUL inside payload are not taken as response
+    ESP8266Simulator simulator;
+    WiFi *wifi = createConnectedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    static const char payload[] = "\0\r\nOK\r\n\0+IPD,0,3:\0\r\nERROR\r\n";
+    sendSimulatorData(&simulator, CONNECTION_ID_0, payload, sizeof(payload) - 1);
+    for (uint32_t i = 0; i < 1000 && availableDataByIdESP8266(wifi, CONNECTION_ID_0) < sizeof(payload) - 1; i++) {
+        pollESP8266(wifi);
+    }
+    char buffer[sizeof(payload)];
+    ASSERT_EQ(sizeof(payload) - 1, readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));
+    ASSERT_MEM_EQ(payload, buffer, sizeof(payload) - 1);
+    ASSERT_EQ(ESP8266_CREATED_TRANSMISSION, getConnectionStatusESP8266(wifi));
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testChunkBusyRetry(void) {     // ignored AT+CIPSEND is sent again, "busy" doesn't fail other commands
+    ESP8266Simulator simulator;
+    WiFi *wifi = createConnectedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.isPayloadEchoed = false;
+    static char data[3000];
+    uint32_t seed = 7;
+    fillRandom(data, sizeof(data), &seed);
+    scriptSimulatorResponse(&simulator, "AT+CIPSEND", "\r\nbusy s...\r\n", 2);
+
+    StreamSendReport report;
+    ASSERT_TRUE(isResponseStatusSuccess(sendLargeESP8266(wifi, CONNECTION_ID_0, data, sizeof(data), &report)));
+    ASSERT_EQ(sizeof(data), simulator.payloadLength);
+    ASSERT_MEM_EQ(data, simulator.payload, sizeof(data));
+    ASSERT_EQ(2, report.chunks);
+    ASSERT_EQ(0, report.retransmits);   // payload wasn't sent for ignored command
+    ASSERT_EQ(2, simulator.sendCount);
+    ASSERT_TRUE(isResponseStatusSuccess(healthCheckESP8266(wifi)));
+    deleteTestWifi(wifi, &simulator);
+}
+
+typedef struct StreamSource {
+    ESP8266Simulator *simulator;
+    uint32_t remaining;
+    uint32_t calls;
+    uint32_t commandCountAtSecondCall;
+} StreamSource;
+
+static uint32_t produceStream(char *buffer, uint32_t length, void *context) {
+    StreamSource *source = context;
+    if (++source->calls == 2) {
+        source->commandCountAtSecondCall = source->simulator->commandCount;
+    }
+    length = (length < source->remaining) ? length : source->remaining;
+    memset(buffer, 's', length);
+    source->remaining -= length;
+    return length;
+}
+
+static void testStreamBusyBackoff(void) {    // producer runs while busy retry is due, caller isn't stalled in delay
+    ESP8266Simulator simulator;
+    WiFi *wifi = createConnectedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.isPayloadEchoed = false;
+    scriptSimulatorResponse(&simulator, "AT+CIPSEND", "\r\nbusy s...\r\n", 3);
+    StreamSource source = {.simulator = &simulator, .remaining = 3000};
+    static char workBuffer[2 * 2048];
+
+    uint32_t commandCount = simulator.commandCount;
+    uint64_t startMicros = getMicrosHost();
+    StreamSendReport report;
+    ASSERT_TRUE(isResponseStatusSuccess(sendStreamESP8266(wifi, CONNECTION_ID_0, produceStream, &source, workBuffer, sizeof(workBuffer), &report)));
+    uint32_t backoffMillis = ESP8266_BUSY_RETRY_DELAY_MS * (1 + 2 + 4);
+    ASSERT_TRUE(getMicrosHost() - startMicros >= (uint64_t) backoffMillis * 1000);
+    ASSERT_EQ(commandCount + 1, source.commandCountAtSecondCall);    // next chunk was produced during first backoff
+    ASSERT_EQ(3000, simulator.payloadLength);
+    ASSERT_EQ(2, report.chunks);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testStopServerDeadline(void) {    // slow acknowledges, stop doesn't wait for all pending chunks
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(setConnectionModeESP8266(wifi, ESP8266_CONNECTION_MULTIPLE)));
+    ASSERT_TRUE(isResponseStatusSuccess(startServerESP8266(wifi, 80, 10)));
+    acceptSimulatorClient(&simulator, CONNECTION_ID_1);
+    for (uint32_t i = 0; i < 1000 && !(wifi->link.openSockets & (1U << CONNECTION_ID_1)); i++) {
+        pollTestWifi(wifi);
+    }
+
+    static char page[3 * ESP8266_SERVER_CHUNK_LENGTH];
+    memset(page, 'p', sizeof(page));
+    ASSERT_TRUE(writeServerConnectionESP8266(wifi, CONNECTION_ID_1, page, sizeof(page)));
+    ASSERT_TRUE(!writeServerConnectionESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT, page, sizeof(page)));
+    setResponseTimeout(wifi, 300);
+    simulator.sendAckMicros = 200000;   // each chunk is within timeout, all of them are not
+    for (uint32_t i = 0; i < 1000 && !wifi->isSendPending; i++) {
+        pollTimeHost();
+        serveESP8266(wifi);
+    }
+    ASSERT_TRUE(wifi->isSendPending);
+
+    uint64_t startMicros = getMicrosHost();
+    stopServerESP8266(wifi);
+    ASSERT_TRUE(getMicrosHost() - startMicros < 2 * 300 * 1000 + 100000);   // started send and stop command, each within timeout
+    ASSERT_TRUE(!wifi->server.isListening);
+    ASSERT_EQ(-1, wifi->server.sendingId);
+    ASSERT_EQ(0, pendingServerDataESP8266(wifi, CONNECTION_ID_1));
+    ASSERT_TRUE(simulator.payloadLength < sizeof(page));
+    ASSERT_EQ(ESP8266_RESPONSE_TIMEOUT, wifi->lastSendStatus);
+
+    ASSERT_EQ(0, pendingServerDataESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT));
+    char buffer[4];
+    ASSERT_EQ(0, availableDataByIdESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT));
+    ASSERT_EQ(0, readDataByIdESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT, buffer, sizeof(buffer)));
+    closeServerConnectionESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT);
+    deleteTestWifi(wifi, &simulator);
+}
+
+int main(void) {
+    RUN_TEST(testVectorSendWithoutCopy);
+    RUN_TEST(testVectorSendLimits);
+    RUN_TEST(testBinaryRoundTrip);
+    RUN_TEST(testBinaryUnsolicitedData);
+    RUN_TEST(testChunkBusyRetry);
+    RUN_TEST(testStreamBusyBackoff);
+    RUN_TEST(testStopServerDeadline);
+    return finishTests();
+}
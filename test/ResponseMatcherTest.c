@@ -0,0 +1,149 @@
+#include "TestSupport.h"
+
+static void testChunkedResponse(void) {     // each chunk ends with idle line and RX DMA re-arm
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.chunkLength = 3;
+    simulator.chunkGapMicros = 300;
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_EQ(ESP8266_CONNECTED_TO_AP, getConnectionStatusESP8266(wifi));
+    ASSERT_STR_EQ("STATUS:2\r\n\r\nOK\r\n", wifi->response->responseBody);
+    ASSERT_EQ(0, TEST_USART->droppedRxBytes);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testPatternSplitAcrossBursts(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.chunkLength = 1;
+    simulator.chunkGapMicros = 1000;    // longer than poll step, every byte is scanned after separate re-arm
+    scriptSimulatorResponse(&simulator, "AT", "\r\nERR\r\nOK\r\n", 1);
+    ASSERT_TRUE(isResponseStatusSuccess(healthCheckESP8266(wifi)));
+    ASSERT_STR_EQ("\r\nERR\r\nOK\r\n", wifi->response->responseBody);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testLongResponseOverflow(void) {    // text longer than RX buffer keeps its head, rest is only scanned for status
+    static char response[3 * TEST_RX_BUFFER_SIZE];
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.chunkLength = 100;
+    response[0] = '\0';
+    for (uint32_t i = 2; strlen(response) < 2 * TEST_RX_BUFFER_SIZE; i++) {
+        char line[48];
+        sprintf(line, "192.168.4.%u,a0:b1:c2:d3:e4:%02x\r\n", (unsigned) i, (unsigned) i);
+        strcat(response, line);
+    }
+    strcat(response, "\r\nOK\r\n");
+    scriptSimulatorResponse(&simulator, "AT+CWLIF", response, 1);
+    ASSERT_TRUE(isResponseStatusSuccess(refreshSoftApClientsESP8266(wifi)));
+    ASSERT_TRUE(wifi->response->matcher.isOverflowed);
+    ASSERT_EQ((TEST_RX_BUFFER_SIZE - 1) / 2, wifi->response->responseLength);
+    ASSERT_MEM_EQ(response, wifi->response->responseBody, wifi->response->responseLength);     // head isn't overwritten
+    ASSERT_EQ(ESP8266_SOFT_AP_CLIENT_COUNT, wifi->softApClients.size);
+    ASSERT_EQ(2, wifi->softApClients.clients[0].clientIP.octets[3]);
+
+    ASSERT_EQ(ESP8266_NOT_CONNECTED_TO_AP, getConnectionStatusESP8266(wifi));
+    ASSERT_TRUE(!wifi->response->matcher.isOverflowed);
+    ASSERT_STR_EQ("STATUS:5\r\n\r\nOK\r\n", wifi->response->responseBody);    // no text left from longer response
+    deleteTestWifi(wifi, &simulator);
+}
+
+typedef struct Transcript {     // module output recorded on AT 1.x firmware, echo off
+    const char *command;
+    const char *response;
+    ResponseStatus status;
+} Transcript;
+
+static const Transcript TRANSCRIPTS[] = {
+        {"AT+CWJAP_CUR=\"home\",\"secret\"", "WIFI DISCONNECT\r\nWIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CWJAP_CUR=\"home\",\"wrong\"", "WIFI DISCONNECT\r\n+CWJAP:2\r\n\r\nFAIL\r\n", ESP8266_RESPONSE_ERROR},
+        {"AT+CWLAP", "+CWLAP:(3,\"home\",-55,\"a0:20:a6:00:00:01\",6)\r\n+CWLAP:(4,\"office\",-71,\"a0:20:a6:00:00:02\",11)\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CIPSTART=\"TCP\",\"example.com\",80", "CONNECT\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CIPSTART=\"TCP\",\"example.com\",80", "ALREADY CONNECTED\r\n\r\nERROR\r\n", ESP8266_RESPONSE_ERROR},
+        {"AT+CIPSTART=\"TCP\",\"10.0.0.9\",8080", "\r\nERROR\r\nCLOSED\r\n", ESP8266_RESPONSE_ERROR},
+        {"AT+CIPSTATUS", "STATUS:3\r\n+CIPSTATUS:0,\"TCP\",\"93.184.216.34\",80,50012,0\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CIFSR", "+CIFSR:STAIP,\"192.168.1.34\"\r\n+CIFSR:STAMAC,\"a0:20:a6:11:22:33\"\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CIPSEND=5", "\r\nOK\r\n> ", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CIPMUX=1", "\r\nbusy p...\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+CIPMUX=1", "link is builded\r\n\r\nERROR\r\n", ESP8266_RESPONSE_ERROR},
+        {"AT+CIPCLOSE", "CLOSED\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},
+        {"AT+PING=\"10.0.0.1\"", "+timeout\r\n\r\nERROR\r\n", ESP8266_RESPONSE_ERROR},
+        {"AT", "\r\n+IPD,9:\r\nERROR\r\n\r\nOK\r\n", ESP8266_RESPONSE_SUCCESS},    // status text inside unsolicited payload
+};
+
+static void onTranscriptCommand(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) wifi;
+    *(ResponseStatus *) context = status;
+}
+
+static ResponseStatus replayTranscript(WiFi *wifi, const Transcript *transcript, uint32_t *seed) {  // response in random bursts with idle line after each
+    ResponseStatus status = ESP8266_RESPONSE_WAITING;
+    if (!enqueueCommandESP8266(wifi, onTranscriptCommand, &status, transcript->command)) return ESP8266_RESPONSE_TIMEOUT;
+    pollTestWifi(wifi);
+
+    uint32_t length = strlen(transcript->response);
+    for (uint32_t offset = 0; offset < length;) {
+        *seed = *seed * 1103515245 + 12345;
+        uint32_t chunkLength = 1 + (*seed >> 16) % 24;
+        chunkLength = (chunkLength < length - offset) ? chunkLength : length - offset;
+        queueReceiveHost(TEST_USART, 200 + (*seed >> 8) % 800, &transcript->response[offset], chunkLength);
+        offset += chunkLength;
+    }
+    for (uint32_t i = 0; i < 100000 && (isResponseStatusWaiting(status) || getMicrosHost() <= TEST_USART->rxLineFreeMicros); i++) {
+        pollTestWifi(wifi);     // status can be matched before last burst, like "OK" before "> " prompt
+    }
+
+    char payload[16];
+    while (readDataByIdESP8266(wifi, CONNECTION_ID_0, payload, sizeof(payload)) > 0);
+    return status;
+}
+
+static void testRecordedTranscriptsRandomSplits(void) {     // same status for every split of recorded module output
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    deleteSimulator(&simulator);    // module is silent, only replayed output is received
+    uint32_t seed = 20261016;
+    for (uint32_t i = 0; i < sizeof(TRANSCRIPTS) / sizeof(TRANSCRIPTS[0]); i++) {
+        for (uint32_t round = 0; round < 40; round++) {
+            ResponseStatus status = replayTranscript(wifi, &TRANSCRIPTS[i], &seed);
+            if (status != TRANSCRIPTS[i].status) {
+                printf("    %s, round %u\n", TRANSCRIPTS[i].command, (unsigned) round);
+            }
+            ASSERT_EQ(TRANSCRIPTS[i].status, status);
+        }
+    }
+    deleteESP8266(wifi);
+}
+
+static void testUnsolicitedLinesBetweenCommands(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+
+    sendSimulatorData(&simulator, CONNECTION_ID_0, "first", 5);
+    sendSimulatorText(&simulator, "\r\n");
+    sendSimulatorData(&simulator, CONNECTION_ID_0, "second", 6);
+    for (uint32_t i = 0; i < 1000 && availableDataByIdESP8266(wifi, CONNECTION_ID_0) < 11; i++) {
+        pollTestWifi(wifi);
+    }
+    char buffer[16] = {0};
+    ASSERT_EQ(11, readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));
+    ASSERT_STR_EQ("firstsecond", buffer);
+    deleteTestWifi(wifi, &simulator);
+}
+
+int main(void) {
+    RUN_TEST(testChunkedResponse);
+    RUN_TEST(testPatternSplitAcrossBursts);
+    RUN_TEST(testLongResponseOverflow);
+    RUN_TEST(testRecordedTranscriptsRandomSplits);
+    RUN_TEST(testUnsolicitedLinesBetweenCommands);
+    return finishTests();
+}
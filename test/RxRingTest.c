@@ -0,0 +1,103 @@
+#include "TestSupport.h"
+
+#if !defined(ESP8266_RX_CIRCULAR_MODE)
+#error "RxRingTest requires circular RX mode driver"
+#endif
+
+static void testRingWrap(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.chunkLength = 7;  // idle line events at every position, also next to ring end
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    for (uint32_t i = 0; i < 50; i++) {
+        ASSERT_EQ(ESP8266_CONNECTED_TO_AP, getConnectionStatusESP8266(wifi));
+        ASSERT_STR_EQ("STATUS:2\r\n\r\nOK\r\n", wifi->response->responseBody);
+    }
+    ASSERT_TRUE(wifi->rxRing.receivedBytes > 3 * ESP8266_RX_RING_SIZE);
+    ASSERT_EQ(wifi->rxRing.receivedBytes, wifi->rxRing.consumedBytes);
+    ASSERT_EQ(0, wifi->rxRing.overrunCount);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testFrameAcrossRingEnd(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+
+    char payload[100];
+    char buffer[sizeof(payload)];
+    for (uint32_t round = 0; round < 10; round++) {    // frames start at different ring positions
+        for (uint32_t i = 0; i < sizeof(payload); i++) {
+            payload[i] = (char) (round * 31 + i);
+        }
+        sendSimulatorData(&simulator, CONNECTION_ID_0, payload, sizeof(payload));
+        for (uint32_t i = 0; i < 1000 && availableDataByIdESP8266(wifi, CONNECTION_ID_0) < sizeof(payload); i++) {
+            pollTestWifi(wifi);
+        }
+        ASSERT_EQ(sizeof(payload), readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));
+        ASSERT_MEM_EQ(payload, buffer, sizeof(payload));
+    }
+    ASSERT_EQ(0, wifi->rxRing.overrunCount);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testOverrun(void) {     // parser doesn't run while more than ring size arrives
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+
+    static char payload[3 * ESP8266_RX_RING_SIZE / 2];
+    memset(payload, 'x', sizeof(payload));
+    sendSimulatorData(&simulator, CONNECTION_ID_0, payload, sizeof(payload));
+    advanceTimeHost(getTransferMicrosHost(TEST_USART, sizeof(payload) + 16) + 1000);
+    pollESP8266(wifi);
+    ASSERT_EQ(1, wifi->rxRing.overrunCount);
+    ASSERT_EQ(wifi->rxRing.receivedBytes, wifi->rxRing.consumedBytes);
+
+    ASSERT_EQ(ESP8266_CREATED_TRANSMISSION, getConnectionStatusESP8266(wifi));    // parser is in sync after lost span
+    sendSimulatorData(&simulator, CONNECTION_ID_0, "next", 4);
+    uint32_t available = availableDataByIdESP8266(wifi, CONNECTION_ID_0);
+    for (uint32_t i = 0; i < 1000 && availableDataByIdESP8266(wifi, CONNECTION_ID_0) < available + 4; i++) {
+        pollTestWifi(wifi);
+    }
+    char buffer[sizeof(payload)];
+    uint32_t length = readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer));
+    ASSERT_TRUE(length >= 4);
+    ASSERT_MEM_EQ("next", &buffer[length - 4], 4);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testOverrunInsideFrame(void) {  // frame header is parsed, rest of payload is lost
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+
+    static char payload[3 * ESP8266_RX_RING_SIZE];
+    memset(payload, 'y', sizeof(payload));
+    simulator.chunkLength = 64;
+    sendSimulatorData(&simulator, CONNECTION_ID_0, payload, sizeof(payload));
+    advanceTimeHost(getTransferMicrosHost(TEST_USART, 128));
+    pollESP8266(wifi);
+    ASSERT_EQ(IPD_FRAME_PAYLOAD, wifi->framer.state);
+    advanceTimeHost(getTransferMicrosHost(TEST_USART, sizeof(payload)) + 10000);
+    pollESP8266(wifi);
+    ASSERT_EQ(1, wifi->rxRing.overrunCount);
+
+    ASSERT_EQ(ESP8266_CREATED_TRANSMISSION, getConnectionStatusESP8266(wifi));    // response isn't taken as lost payload
+    deleteTestWifi(wifi, &simulator);
+}
+
+int main(void) {
+    RUN_TEST(testRingWrap);
+    RUN_TEST(testFrameAcrossRingEnd);
+    RUN_TEST(testOverrun);
+    RUN_TEST(testOverrunInsideFrame);
+    return finishTests();
+}
@@ -0,0 +1,76 @@
+#include "TestSupport.h"
+
+static WiFiStaticStorage storage;
+
+static void testStaticInstance(void) {  // whole instance with transport and DMA buffers lives in storage, heap isn't touched
+    ESP8266Simulator simulator;
+    initSimulator(&simulator, TEST_USART);
+    WiFi *wifi = initStaticWifiESP8266(&storage, TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM);
+    ASSERT_TRUE(wifi == &storage.wifi);
+    ASSERT_EQ(0, getHeapCallsHost());
+    ASSERT_TRUE(wifi->request == &storage.request && wifi->response == &storage.response);
+    ASSERT_TRUE(wifi->USARTDma == &storage.USARTDma);
+    ASSERT_TRUE(wifi->response->responseBody == storage.rxBuffer);
+    ASSERT_EQ(ESP8266_STATIC_RX_BUFFER_SIZE, wifi->response->bufferSize);
+    ASSERT_TRUE(wifi->request->requestBody == storage.txBuffer);
+    ASSERT_EQ(ESP8266_STATIC_TX_BUFFER_SIZE, wifi->request->bufferSize);
+
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+    simulator.isPayloadEchoed = true;
+    ResponseStatus status = sendDataESP8266(wifi, CONNECTION_ID_0, "static", 6);
+    ASSERT_TRUE(isResponseStatusSuccess(isResponseStatusWaiting(status) ? waitForResponseESP8266(wifi) : status));
+    char buffer[8];
+    ASSERT_EQ(6, readDataByIdESP8266(wifi, CONNECTION_ID_0, buffer, sizeof(buffer)));   // RX reached storage transport
+    ASSERT_MEM_EQ("static", buffer, 6);
+
+    deleteESP8266(wifi);    // storage is reused by re-init
+    wifi = initStaticWifiESP8266(&storage, TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(isResponseStatusSuccess(healthCheckESP8266(wifi)));
+    deleteESP8266(wifi);
+    ASSERT_EQ(0, getHeapCallsHost());
+    deleteSimulator(&simulator);
+}
+
+static void testHeapInstanceIsCounted(void) {   // counter sees driver allocations
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_EQ(3, getHeapCallsHost());
+    deleteTestWifi(wifi, &simulator);
+    ASSERT_EQ(6, getHeapCallsHost());
+}
+
+static void testMissingArguments(void) {
+    ASSERT_TRUE(createStaticWifiESP8266(NULL, TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM) == NULL);
+    ASSERT_TRUE(createStaticWifiESP8266(&storage, NULL, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM) == NULL);
+    ASSERT_TRUE(createStaticWifiESP8266(&storage, TEST_USART, NULL, TEST_RX_STREAM, TEST_TX_STREAM) == NULL);
+    ASSERT_TRUE(initStaticWifiESP8266(NULL, TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM) == NULL);
+    ASSERT_TRUE(initStaticWifiESP8266(&storage, NULL, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM) == NULL);
+    ASSERT_EQ(0, TEST_USART->transmitCalls);
+}
+
+static void testMemoryFootprint(void) {
+    MemoryFootprint footprint;
+    getMemoryFootprintESP8266(&footprint);
+    ASSERT_EQ(sizeof(storage), footprint.staticStorage);
+    uint32_t parts = footprint.controlBlock + footprint.dmaBuffers + footprint.receiveQueues + footprint.commandQueue + footprint.commandLane
+                     + footprint.urcDispatcher + footprint.server + footprint.knownNetworks + footprint.softApClients
+                     + footprint.supervisor + footprint.ping + footprint.power + footprint.metrics + footprint.trace
+                     + footprint.rxRing;
+    ASSERT_EQ(footprint.staticStorage, parts);
+    ASSERT_TRUE(footprint.controlBlock >= sizeof(RequestData) + sizeof(ResponseData) + sizeof(USART_DMA));
+    ASSERT_EQ(ESP8266_STATIC_RX_BUFFER_SIZE + ESP8266_STATIC_TX_BUFFER_SIZE, footprint.dmaBuffers);
+    ASSERT_EQ(ESP8266_CONNECTION_COUNT * sizeof(ReceiveQueue), footprint.receiveQueues);
+    ASSERT_EQ(ESP8266_COMMAND_MAX_LENGTH, footprint.commandLane);
+    ASSERT_EQ(0, footprint.metrics + footprint.trace + footprint.rxRing);  // features not compiled in take no RAM
+}
+
+int main(void) {
+    RUN_TEST(testStaticInstance);
+    RUN_TEST(testHeapInstanceIsCounted);
+    RUN_TEST(testMissingArguments);
+    RUN_TEST(testMemoryFootprint);
+    return finishTests();
+}
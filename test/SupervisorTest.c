@@ -0,0 +1,145 @@
+#include "TestSupport.h"
+
+static void superviseForMillis(WiFi *wifi, uint32_t millis) {
+    uint64_t endMicros = getMicrosHost() + (uint64_t) millis * 1000;
+    while (getMicrosHost() < endMicros) {
+        pollTimeHost();
+        superviseESP8266(wifi);
+    }
+}
+
+static bool superviseUntilOnline(WiFi *wifi, uint32_t maxMillis) {
+    uint64_t endMicros = getMicrosHost() + (uint64_t) maxMillis * 1000;
+    while (getMicrosHost() < endMicros) {
+        pollTimeHost();
+        if (superviseESP8266(wifi) == ESP8266_SUPERVISOR_ONLINE) return true;
+    }
+    return false;
+}
+
+static WiFi *createSupervisedWifi(ESP8266Simulator *simulator) {
+    WiFi *wifi = createTestWifi(simulator);
+    if (wifi == NULL) return NULL;
+    addTestAccessPoint(simulator, "home", "secret", -55);
+    addKnownNetworkESP8266(wifi, "home", "secret");
+    return wifi;
+}
+
+static void testJoinFailuresBackOff(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createSupervisedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    scriptSimulatorResponse(&simulator, "AT+CWJAP", "+CWJAP:3\r\n\r\nFAIL\r\n", 2);
+
+    uint64_t startMicros = getMicrosHost();
+    startSupervisorESP8266(wifi);
+    ASSERT_TRUE(superviseUntilOnline(wifi, 10000));
+    uint32_t elapsedMillis = (uint32_t) ((getMicrosHost() - startMicros) / 1000);
+    uint32_t minBackoffMillis = ESP8266_SUPERVISOR_BACKOFF_MIN_MS / 2 + ESP8266_SUPERVISOR_BACKOFF_MIN_MS;   // fixed halves of two delays
+    ASSERT_TRUE(elapsedMillis >= minBackoffMillis);
+    ASSERT_EQ(0, wifi->supervisor.joinAttempt);
+    ASSERT_EQ(1, wifi->supervisor.joinCount);
+
+    dropSimulatorAccessPoint(&simulator);
+    superviseForMillis(wifi, 10);
+    ASSERT_EQ(ESP8266_SUPERVISOR_BACKOFF, wifi->supervisor.state);
+    ASSERT_TRUE(superviseUntilOnline(wifi, 10000));
+    ASSERT_EQ(2, wifi->supervisor.joinCount);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testEndpointReopenAfterClose(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createSupervisedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    SocketConfig config = {.type = ESP8266_SOCKET_TCP, .host = "example.com", .port = 80};
+    ASSERT_TRUE(superviseEndpointESP8266(wifi, CONNECTION_ID_0, &config));
+    scriptSimulatorResponse(&simulator, "AT+CIPSTART", "\r\nERROR\r\nCLOSED\r\n", 1);    // first attempt fails
+
+    startSupervisorESP8266(wifi);
+    ASSERT_TRUE(superviseUntilOnline(wifi, 5000));
+    superviseForMillis(wifi, 5000);
+    ASSERT_TRUE(wifi->link.openSockets & (1U << CONNECTION_ID_0));
+    ASSERT_TRUE(simulator.openSockets & (1U << CONNECTION_ID_0));
+    ASSERT_EQ(1, wifi->supervisor.reopenCount);
+    ASSERT_EQ(0, wifi->supervisor.endpoints[CONNECTION_ID_0].attempt);
+
+    closeSimulatorSocket(&simulator, CONNECTION_ID_0);
+    superviseForMillis(wifi, 100);
+    ASSERT_TRUE(wifi->link.openSockets & (1U << CONNECTION_ID_0));
+    ASSERT_EQ(2, wifi->supervisor.reopenCount);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testSslBufferError(void) {  // socket isn't started with default buffer after buffer size error
+    ESP8266Simulator simulator;
+    WiFi *wifi = createSupervisedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    SocketConfig config = {.type = ESP8266_SOCKET_SSL, .host = "example.com", .port = 443, .sslBufferSize = 4096};
+    ASSERT_TRUE(superviseEndpointESP8266(wifi, CONNECTION_ID_0, &config));
+    scriptSimulatorResponse(&simulator, "AT+CIPSSLSIZE", "\r\nERROR\r\n", 1);
+
+    startSupervisorESP8266(wifi);
+    ASSERT_TRUE(superviseUntilOnline(wifi, 5000));
+    uint32_t commandCount = simulator.commandCount;
+    superviseForMillis(wifi, ESP8266_SUPERVISOR_BACKOFF_MIN_MS / 2 - 100);   // buffer size fails, retry is not due yet
+    ASSERT_EQ(commandCount + 1, simulator.commandCount);
+    ASSERT_TRUE(strncmp(simulator.lastCommand, "AT+CIPSSLSIZE", 13) == 0);
+    ASSERT_EQ(0, simulator.openSockets);
+    ASSERT_EQ(1, wifi->supervisor.endpoints[CONNECTION_ID_0].attempt);
+
+    superviseForMillis(wifi, ESP8266_SUPERVISOR_BACKOFF_MIN_MS);
+    ASSERT_TRUE(wifi->link.openSockets & (1U << CONNECTION_ID_0));
+    ASSERT_EQ(commandCount + 3, simulator.commandCount);
+    ASSERT_EQ(0, wifi->supervisor.endpoints[CONNECTION_ID_0].attempt);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testMissedConnect(void) {   // "ALREADY CONNECTED" error means socket is open
+    ESP8266Simulator simulator;
+    WiFi *wifi = createSupervisedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    SocketConfig config = {.type = ESP8266_SOCKET_TCP, .host = "example.com", .port = 80};
+    ASSERT_TRUE(superviseEndpointESP8266(wifi, CONNECTION_ID_0, &config));
+    startSupervisorESP8266(wifi);
+    ASSERT_TRUE(superviseUntilOnline(wifi, 5000));
+    superviseForMillis(wifi, 100);
+    ASSERT_EQ(1, wifi->supervisor.reopenCount);
+
+    wifi->link.openSockets = 0;     // "CONNECT" line was lost
+    superviseForMillis(wifi, 100);
+    ASSERT_STR_EQ("ALREADY CONNECTED\r\n\r\nERROR\r\n", wifi->response->responseBody);
+    ASSERT_TRUE(wifi->link.openSockets & (1U << CONNECTION_ID_0));
+    ASSERT_EQ(2, wifi->supervisor.reopenCount);
+    ASSERT_EQ(0, wifi->supervisor.endpoints[CONNECTION_ID_0].attempt);
+
+    scriptSimulatorResponse(&simulator, "AT+CIPSTART", "\r\nERROR\r\n", 1);    // flag doesn't leak into next socket start
+    closeSimulatorSocket(&simulator, CONNECTION_ID_0);
+    superviseForMillis(wifi, 100);
+    ASSERT_TRUE(!(wifi->link.openSockets & (1U << CONNECTION_ID_0)));
+    ASSERT_EQ(1, wifi->supervisor.endpoints[CONNECTION_ID_0].attempt);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void testEndpointArguments(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createSupervisedWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    ASSERT_TRUE(isResponseStatusSuccess(setConnectionModeESP8266(wifi, ESP8266_CONNECTION_MULTIPLE)));
+    SocketConfig config = {.type = ESP8266_SOCKET_TCP, .host = "example.com", .port = 80};
+    LinkSupervisor before = wifi->supervisor;
+    ASSERT_TRUE(!superviseEndpointESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT, &config));
+    ASSERT_TRUE(!superviseEndpointESP8266(wifi, CONNECTION_ID_1, NULL));
+    releaseEndpointESP8266(wifi, (ConnectionID) ESP8266_CONNECTION_COUNT);
+    ASSERT_MEM_EQ(&before, &wifi->supervisor, sizeof(LinkSupervisor));     // nothing written past endpoint table
+    deleteTestWifi(wifi, &simulator);
+}
+
+int main(void) {
+    RUN_TEST(testJoinFailuresBackOff);
+    RUN_TEST(testEndpointReopenAfterClose);
+    RUN_TEST(testSslBufferError);
+    RUN_TEST(testMissedConnect);
+    RUN_TEST(testEndpointArguments);
+    return finishTests();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "ESP8266WiFi.h"
+#include "ESP8266Simulator.h"
+
+// Minimal test runner for host build. Failed assertion ends current test, each test starts from fresh virtual time.
+
+#define TEST_USART              USART1
+#define TEST_DMA                DMA2
+#define TEST_RX_STREAM          LL_DMA_STREAM_2
+#define TEST_TX_STREAM          LL_DMA_STREAM_7
+#define TEST_RX_BUFFER_SIZE     1024
+#define TEST_TX_BUFFER_SIZE     512
+
+#define ASSERT_TRUE(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+        testFailures++; \
+        return; \
+    } \
+} while (0)
+
+#define ASSERT_EQ(expected, actual) do { \
+    long long expectedValue = (long long) (expected); \
+    long long actualValue = (long long) (actual); \
+    if (expectedValue != actualValue) { \
+        fprintf(stderr, "%s:%d: %s expected %lld, got %lld\n", __FILE__, __LINE__, #actual, expectedValue, actualValue); \
+        testFailures++; \
+        return; \
+    } \
+} while (0)
+
+#define ASSERT_STR_EQ(expected, actual) do { \
+    const char *expectedText = (expected); \
+    const char *actualText = (actual); \
+    if (strcmp(expectedText, actualText) != 0) { \
+        fprintf(stderr, "%s:%d: %s expected \"%s\", got \"%s\"\n", __FILE__, __LINE__, #actual, expectedText, actualText); \
+        testFailures++; \
+        return; \
+    } \
+} while (0)
+
+#define ASSERT_MEM_EQ(expected, actual, length) do { \
+    if (memcmp((expected), (actual), (length)) != 0) { \
+        fprintf(stderr, "%s:%d: %s differs in first %u bytes\n", __FILE__, __LINE__, #actual, (unsigned) (length)); \
+        testFailures++; \
+        return; \
+    } \
+} while (0)
+
+#define RUN_TEST(test) runTest(#test, test)
+
+static uint32_t testFailures;
+static uint32_t testCount;
+
+static inline void runTest(const char *name, void (*test)(void)) {
+    uint32_t failures = testFailures;
+    resetHost();
+    test();
+    for (uint32_t i = 0; i < HOST_USART_COUNT; i++) {   // real TX DMA stream doesn't queue transfer behind running one
+        if (hostUSART[i].overlappedTransmits > 0) {
+            fprintf(stderr, "%s: %" PRIu32 " transmits started before previous TX DMA completed on USART%" PRIu32 "\n", name, hostUSART[i].overlappedTransmits, i + 1);
+            testFailures++;
+        }
+    }
+    testCount++;
+    printf("%s %s\n", (testFailures == failures) ? "PASS" : "FAIL", name);
+}
+
+static inline int finishTests(void) {
+    printf("%" PRIu32 " tests, %" PRIu32 " failed\n", testCount, testFailures);
+    return (testFailures == 0) ? 0 : 1;
+}
+
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+static inline void onTestRxEvent(void *context) {     // USART idle line and RX DMA half/full transfer interrupts
+    rxEventCallbackESP8266(context);
+}
+#endif
+
+static inline WiFi *createTestWifiOn(ESP8266Simulator *simulator, USART_TypeDef *USARTx, DMA_TypeDef *DMAx,
+                                     uint32_t rxStream, uint32_t txStream) {    // simulator attached to USART, module initialized
+    initSimulator(simulator, USARTx);
+    WiFi *wifi = createWifiESP8266(USARTx, DMAx, rxStream, txStream, TEST_RX_BUFFER_SIZE, TEST_TX_BUFFER_SIZE);
+    if (wifi == NULL) return NULL;
+#if defined(ESP8266_RX_CIRCULAR_MODE)
+    setUsartIrqHandlerHost(USARTx, onTestRxEvent, wifi);
+    setDmaIrqHandlerHost(DMAx, rxStream, onTestRxEvent, wifi);
+#endif
+
+    InitPhase phase;
+    do {
+        phase = initStepESP8266(wifi);
+    } while (phase != ESP8266_INIT_READY && phase != ESP8266_INIT_FAILED);
+    if (phase == ESP8266_INIT_FAILED) {
+        deleteESP8266(wifi);
+        return NULL;
+    }
+    return wifi;
+}
+
+static inline WiFi *createTestWifi(ESP8266Simulator *simulator) {
+    return createTestWifiOn(simulator, TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM);
+}
+
+static inline void deleteTestWifi(WiFi *wifi, ESP8266Simulator *simulator) {
+    deleteESP8266(wifi);
+    deleteSimulator(simulator);
+}
+
+static inline void pollTestWifi(WiFi *wifi) {   // circular mode poll doesn't read time, virtual clock is advanced here
+    pollTimeHost();
+    pollESP8266(wifi);
+}
+
+static inline const char *getRecentTransmit(uint32_t age) {    // source pointer of transmit, 0 - last one
+    return TEST_USART->transmitLog[(TEST_USART->transmitCalls - 1 - age) % HOST_TRANSMIT_LOG_SIZE];
+}
+
+static inline void addTestAccessPoint(ESP8266Simulator *simulator, const char *ssid, const char *password, int8_t signalStrength) {
+    SimulatorAccessPoint accessPoint = {.ssid = ssid, .password = password, .signalStrength = signalStrength, .channel = 6, .encryption = ESP8266_ENCRYPTION_WPA2_PSK};
+    snprintf(accessPoint.bssid, sizeof(accessPoint.bssid), "a0:b1:c2:d3:e4:%02x", simulator->accessPointCount);
+    addSimulatorAccessPoint(simulator, &accessPoint);
+}
+
+static inline bool joinTestAccessPoint(WiFi *wifi, ESP8266Simulator *simulator) {
+    addTestAccessPoint(simulator, "home", "secret", -55);
+    connectToAccessPointESP8266(wifi, "home", "secret");
+    return isResponseStatusSuccess(waitForResponseESP8266(wifi));
+}
@@ -0,0 +1,80 @@
+#include "TestSupport.h"
+#include "TraceReplay.h"
+
+#if !defined(ESP8266_ENABLE_TRACE)
+#error "TraceReplayTest requires trace enabled driver"
+#endif
+
+typedef struct DumpBuffer {
+    char data[ESP8266_TRACE_BUFFER_SIZE + 64];
+    uint32_t length;
+} DumpBuffer;
+
+static DumpBuffer dump;
+
+static void writeDump(const char *data, uint32_t length, void *context) {
+    DumpBuffer *buffer = context;
+    memcpy(&buffer->data[buffer->length], data, length);
+    buffer->length += length;
+}
+
+static void captureSession(WiFi *wifi, ESP8266Simulator *simulator) {     // commands with success, error, slow join and received data
+    clearTraceESP8266(wifi);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+    ASSERT_TRUE(isResponseStatusError(connectESP8266(wifi, "example.com", 80)));
+    simulator->isPayloadEchoed = true;
+    ResponseStatus status = sendDataESP8266(wifi, CONNECTION_ID_0, "ping\0pong", 9);
+    ASSERT_TRUE(isResponseStatusSuccess(isResponseStatusWaiting(status) ? waitForResponseESP8266(wifi) : status));
+    ASSERT_EQ(ESP8266_CREATED_TRANSMISSION, getConnectionStatusESP8266(wifi));
+    dump.length = 0;
+    dumpTraceESP8266(wifi, writeDump, &dump);
+}
+
+static void testReplayReproducesSession(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    captureSession(wifi, &simulator);
+    ASSERT_EQ(0, wifi->trace.droppedRecords);
+    ASSERT_MEM_EQ("ESPT", dump.data, 4);
+    char liveData[16];
+    ASSERT_EQ(9, readDataByIdESP8266(wifi, CONNECTION_ID_0, liveData, sizeof(liveData)));
+    deleteTestWifi(wifi, &simulator);
+
+    resetHost();    // replay runs without module, only captured RX traffic answers
+    WiFi *replayWifi = createWifiESP8266(TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM, TEST_RX_BUFFER_SIZE, TEST_TX_BUFFER_SIZE);
+    ASSERT_TRUE(replayWifi != NULL);
+    TraceReplayReport report;
+    ASSERT_TRUE(replayTraceHost(replayWifi, dump.data, dump.length, &report));
+    ASSERT_EQ(5, report.commands);     // CWJAP, 2x CIPSTART, CIPSEND, CIPSTATUS
+    ASSERT_EQ(1, report.payloadRecords);
+    ASSERT_EQ(report.commands, report.completed);
+    ASSERT_EQ(1, report.errors);       // ALREADY CONNECTED
+    ASSERT_EQ(0, report.timeouts);
+    ASSERT_STR_EQ("AT+CWJAP_CUR=\"home\",\"secret\"", report.slowestCommand);
+    ASSERT_TRUE(report.maxLatencyMicros >= simulator.joinMicros);  // join time of capture is reproduced
+    ASSERT_TRUE(report.maxLatencyMicros < simulator.joinMicros + 10000);
+
+    char replayData[16];
+    ASSERT_EQ(9, readDataByIdESP8266(replayWifi, CONNECTION_ID_0, replayData, sizeof(replayData)));
+    ASSERT_MEM_EQ(liveData, replayData, 9);
+    deleteESP8266(replayWifi);
+}
+
+static void testInvalidDump(void) {
+    WiFi *wifi = createWifiESP8266(TEST_USART, TEST_DMA, TEST_RX_STREAM, TEST_TX_STREAM, TEST_RX_BUFFER_SIZE, TEST_TX_BUFFER_SIZE);
+    ASSERT_TRUE(wifi != NULL);
+    TraceReplayReport report;
+    ASSERT_TRUE(!replayTraceHost(wifi, "ESPX\1\0\0\0\1", 9, &report));
+    ASSERT_TRUE(!replayTraceHost(wifi, "ESPT", 4, &report));
+    ASSERT_TRUE(replayTraceHost(wifi, "ESPT\1\0\0\0\1" "\0\0\0\0\1\5\0OK", 18, &report));  // truncated record is ignored
+    ASSERT_EQ(0, report.records);
+    deleteESP8266(wifi);
+}
+
+int main(void) {
+    RUN_TEST(testReplayReproducesSession);
+    RUN_TEST(testInvalidDump);
+    return finishTests();
+}
@@ -0,0 +1,107 @@
+#include "TestSupport.h"
+
+// Uplink on USART1, soft AP module on USART2, each with own RX interrupt context
+
+#define SECOND_USART        USART2
+#define SECOND_DMA          DMA1
+#define SECOND_RX_STREAM    LL_DMA_STREAM_5
+#define SECOND_TX_STREAM    LL_DMA_STREAM_6
+
+typedef struct ModuleTrace {
+    WiFi *wifi;
+    uint32_t completions;
+    bool isOtherInstance;   // callback got WiFi of other module
+} ModuleTrace;
+
+static void onQueuedCommand(WiFi *wifi, ResponseStatus status, void *context) {
+    ModuleTrace *trace = context;
+    trace->isOtherInstance |= (wifi != trace->wifi);
+    trace->completions += isResponseStatusSuccess(status);
+}
+
+static ResponseStatus sendAndWait(WiFi *wifi, const char *data, uint32_t length) {
+    ResponseStatus status = sendDataESP8266(wifi, CONNECTION_ID_0, data, length);
+    return isResponseStatusWaiting(status) ? waitForResponseESP8266(wifi) : status;
+}
+
+static void testInterleavedTraffic(void) {
+    ESP8266Simulator uplinkSimulator;
+    ESP8266Simulator localSimulator;
+    WiFi *uplink = createTestWifi(&uplinkSimulator);
+    WiFi *local = createTestWifiOn(&localSimulator, SECOND_USART, SECOND_DMA, SECOND_RX_STREAM, SECOND_TX_STREAM);
+    ASSERT_TRUE(uplink != NULL && local != NULL);
+    ASSERT_TRUE(joinTestAccessPoint(uplink, &uplinkSimulator));
+    ASSERT_TRUE(joinTestAccessPoint(local, &localSimulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(uplink, "example.com", 80)));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(local, "192.168.4.2", 8080)));
+    uplinkSimulator.isPayloadEchoed = true;
+    localSimulator.isPayloadEchoed = true;
+
+    char uplinkData[64];
+    char localData[64];
+    char buffer[64];
+    for (uint32_t round = 0; round < 20; round++) {     // echo of one module arrives while other is sending
+        memset(uplinkData, 'u', sizeof(uplinkData));
+        memset(localData, 'l', sizeof(localData));
+        uplinkData[0] = localData[0] = (char) round;
+        clearSimulatorPayload(&uplinkSimulator);
+        clearSimulatorPayload(&localSimulator);
+        ASSERT_TRUE(isResponseStatusSuccess(sendAndWait(uplink, uplinkData, sizeof(uplinkData))));
+        ASSERT_TRUE(isResponseStatusSuccess(sendAndWait(local, localData, sizeof(localData))));
+        ASSERT_MEM_EQ(uplinkData, uplinkSimulator.payload, sizeof(uplinkData));
+        ASSERT_MEM_EQ(localData, localSimulator.payload, sizeof(localData));
+
+        ASSERT_EQ(sizeof(uplinkData), readDataByIdESP8266(uplink, CONNECTION_ID_0, buffer, sizeof(buffer)));
+        ASSERT_MEM_EQ(uplinkData, buffer, sizeof(uplinkData));
+        ASSERT_EQ(sizeof(localData), readDataByIdESP8266(local, CONNECTION_ID_0, buffer, sizeof(buffer)));
+        ASSERT_MEM_EQ(localData, buffer, sizeof(localData));
+    }
+
+    uplinkSimulator.pingMillis = 23;
+    localSimulator.pingMillis = 4;
+    pingPacketESP8266(uplink, "8.8.8.8");
+    pingPacketESP8266(local, "192.168.4.2");
+    ASSERT_TRUE(isResponseStatusSuccess(waitForResponseESP8266(uplink)));
+    ASSERT_TRUE(isResponseStatusSuccess(waitForResponseESP8266(local)));
+    ASSERT_EQ(23, getPacketPingTimeESP8266(uplink));
+    ASSERT_EQ(4, getPacketPingTimeESP8266(local));
+    ASSERT_EQ(0, uplink->rxRing.overrunCount + local->rxRing.overrunCount);
+    deleteTestWifi(local, &localSimulator);
+    deleteTestWifi(uplink, &uplinkSimulator);
+}
+
+static void testConcurrentQueues(void) {    // both modules have command in flight at same time
+    ESP8266Simulator uplinkSimulator;
+    ESP8266Simulator localSimulator;
+    WiFi *uplink = createTestWifi(&uplinkSimulator);
+    WiFi *local = createTestWifiOn(&localSimulator, SECOND_USART, SECOND_DMA, SECOND_RX_STREAM, SECOND_TX_STREAM);
+    ASSERT_TRUE(uplink != NULL && local != NULL);
+    localSimulator.latencyMicros = 3000;    // slower module doesn't hold back faster one
+    ModuleTrace uplinkTrace = {.wifi = uplink};
+    ModuleTrace localTrace = {.wifi = local};
+    for (uint32_t i = 0; i < ESP8266_COMMAND_QUEUE_SIZE; i++) {
+        ASSERT_TRUE(enqueueCommandESP8266(uplink, onQueuedCommand, &uplinkTrace, "AT"));
+        ASSERT_TRUE(enqueueCommandESP8266(local, onQueuedCommand, &localTrace, "AT+CWMODE=3"));
+    }
+    for (uint32_t i = 0; i < 100000 && uplinkTrace.completions < ESP8266_COMMAND_QUEUE_SIZE; i++) {
+        pollTestWifi(uplink);
+        pollESP8266(local);
+    }
+    ASSERT_EQ(ESP8266_COMMAND_QUEUE_SIZE, uplinkTrace.completions);
+    ASSERT_TRUE(localTrace.completions < ESP8266_COMMAND_QUEUE_SIZE);
+    for (uint32_t i = 0; i < 100000 && localTrace.completions < ESP8266_COMMAND_QUEUE_SIZE; i++) {
+        pollTestWifi(local);
+    }
+    ASSERT_EQ(ESP8266_COMMAND_QUEUE_SIZE, localTrace.completions);
+    ASSERT_TRUE(!uplinkTrace.isOtherInstance && !localTrace.isOtherInstance);
+    ASSERT_STR_EQ("AT", uplinkSimulator.lastCommand);
+    ASSERT_STR_EQ("AT+CWMODE=3", localSimulator.lastCommand);
+    deleteTestWifi(local, &localSimulator);
+    deleteTestWifi(uplink, &uplinkSimulator);
+}
+
+int main(void) {
+    RUN_TEST(testInterleavedTraffic);
+    RUN_TEST(testConcurrentQueues);
+    return finishTests();
+}
@@ -0,0 +1,345 @@
+#include "ESP8266WiFi.c"    // white box, internal builder and matcher are timed directly
+#include "TestSupport.h"
+
+// Driver benchmarks against simulated module. Virtual rates include simulated UART and module latency,
+// host cycles show driver CPU cost only. Usage: ESP8266Benchmark [iterations]
+
+#define BENCHMARK_DEFAULT_ITERATIONS    1000
+#define BENCHMARK_SEND_LENGTH           (16 * 1024)
+#define BENCHMARK_PACKET_LENGTH         256
+#define BENCHMARK_SEND_ACK_MICROS       5000    // remote TCP acknowledge on local network
+#define BENCHMARK_SSL_RECORD_MICROS     1500    // module encrypts SSL record before it is sent
+
+static uint32_t iterations = BENCHMARK_DEFAULT_ITERATIONS;
+
+static double perSecond(uint64_t count, uint64_t micros) {
+    return (micros > 0) ? (double) count * 1000000.0 / (double) micros : 0.0;
+}
+
+static void benchmarkCommandRate(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(wifi != NULL);
+    simulator.latencyMicros = 100;
+
+    uint64_t startMicros = getMicrosHost();
+    uint64_t startCycles = readCycleCounterHost();
+    for (uint32_t i = 0; i < iterations; i++) {
+        ASSERT_TRUE(isResponseStatusSuccess(healthCheckESP8266(wifi)));
+    }
+    uint64_t cycles = readCycleCounterHost() - startCycles;
+    uint64_t micros = getMicrosHost() - startMicros;
+    printf("  commands: %" PRIu32 ", %.0f commands/s virtual, %.0f host cycles/command\n",
+           iterations, perSecond(iterations, micros), (double) cycles / iterations);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void benchmarkChunkedResponse(void) {   // idle line every 4 bytes, linear RX DMA is re-armed after each burst
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    simulator.chunkLength = 4;
+    simulator.chunkGapMicros = 100;
+
+    uint32_t rxBytes = TEST_USART->rxBytes;
+    uint64_t startMicros = getMicrosHost();
+    uint64_t startCycles = readCycleCounterHost();
+    for (uint32_t i = 0; i < iterations; i++) {
+        ASSERT_EQ(ESP8266_CONNECTED_TO_AP, getConnectionStatusESP8266(wifi));
+    }
+    uint64_t cycles = readCycleCounterHost() - startCycles;
+    uint64_t micros = getMicrosHost() - startMicros;
+    rxBytes = TEST_USART->rxBytes - rxBytes;
+    printf("  chunked responses: %" PRIu32 ", %.0f commands/s virtual, %.0f host cycles/command, %.2f host cycles/RX byte\n",
+           iterations, perSecond(iterations, micros), (double) cycles / iterations, (double) cycles / rxBytes);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void benchmarkSendThroughput(void) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+    setBaudRateHost(TEST_USART, 921600);
+
+    static char payload[BENCHMARK_SEND_LENGTH];
+    for (uint32_t i = 0; i < BENCHMARK_SEND_LENGTH; i++) {
+        payload[i] = (char) i;
+    }
+    uint32_t rounds = (iterations / 100 > 0) ? iterations / 100 : 1;
+    uint64_t startMicros = getMicrosHost();
+    uint64_t startCycles = readCycleCounterHost();
+    for (uint32_t i = 0; i < rounds; i++) {
+        clearSimulatorPayload(&simulator);
+        StreamSendReport report;
+        ASSERT_TRUE(isResponseStatusSuccess(sendLargeESP8266(wifi, CONNECTION_ID_0, payload, BENCHMARK_SEND_LENGTH, &report)));
+        ASSERT_EQ(BENCHMARK_SEND_LENGTH, report.bytesSent);
+    }
+    uint64_t cycles = readCycleCounterHost() - startCycles;
+    uint64_t micros = getMicrosHost() - startMicros;
+    uint64_t bytes = (uint64_t) rounds * BENCHMARK_SEND_LENGTH;
+    ASSERT_MEM_EQ(payload, simulator.payload, BENCHMARK_SEND_LENGTH);
+    printf("  send: %" PRIu64 " bytes at 921600 baud, %.0f bytes/s virtual, %.2f host cycles/byte\n",
+           bytes, perSecond(bytes, micros), (double) cycles / (double) bytes);
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void benchmarkTransparentStream(void) {  // passthrough against one AT+CIPSEND per packet, same data and baud rate
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+    ASSERT_TRUE(isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80)));
+    setBaudRateHost(TEST_USART, 921600);
+    simulator.sendAckMicros = BENCHMARK_SEND_ACK_MICROS;
+
+    static char payload[BENCHMARK_SEND_LENGTH];
+    for (uint32_t i = 0; i < BENCHMARK_SEND_LENGTH; i++) {
+        payload[i] = (char) (i * 7);
+    }
+    uint64_t startMicros = getMicrosHost();
+    for (uint32_t position = 0; position < BENCHMARK_SEND_LENGTH; position += BENCHMARK_PACKET_LENGTH) {
+        ASSERT_TRUE(isResponseStatusSuccess(sendLargeESP8266(wifi, CONNECTION_ID_0, &payload[position], BENCHMARK_PACKET_LENGTH, NULL)));
+    }
+    uint64_t packetMicros = getMicrosHost() - startMicros;
+    ASSERT_MEM_EQ(payload, simulator.payload, BENCHMARK_SEND_LENGTH);
+
+    clearSimulatorPayload(&simulator);
+    startMicros = getMicrosHost();
+    uint64_t startCycles = readCycleCounterHost();
+    ASSERT_TRUE(isResponseStatusSuccess(beginTransparentStreamESP8266(wifi)));
+    uint32_t written = 0;
+    while (written < BENCHMARK_SEND_LENGTH) {
+        written += writeTransparentStreamESP8266(wifi, &payload[written], BENCHMARK_SEND_LENGTH - written);
+    }
+    while (!isTransferCompleteUSART_DMA(wifi->USARTDma->txData)) {}
+    uint64_t cycles = readCycleCounterHost() - startCycles;
+    uint64_t streamMicros = getMicrosHost() - startMicros;
+    ASSERT_TRUE(isResponseStatusSuccess(endTransparentStreamESP8266(wifi)));   // +++ exit with guard time, not part of rate
+    uint64_t exitMicros = getMicrosHost() - startMicros - streamMicros;
+
+    ASSERT_TRUE(exitMicros >= (uint64_t) (ESP8266_TRANSPARENT_PACKET_GAP_MS + ESP8266_TRANSPARENT_EXIT_GUARD_MS) * 1000);
+    ASSERT_EQ(BENCHMARK_SEND_LENGTH, simulator.payloadLength);
+    ASSERT_MEM_EQ(payload, simulator.payload, BENCHMARK_SEND_LENGTH);
+    ASSERT_TRUE(!simulator.isPassthrough && !simulator.isTransparentMode);
+    ASSERT_TRUE(streamMicros < packetMicros);
+    printf("  transparent stream: %u bytes at 921600 baud, %.0f bytes/s virtual, %.2f host cycles/byte, exit %" PRIu64 " us; "
+           "AT+CIPSEND per %u bytes: %.0f bytes/s virtual\n",
+           BENCHMARK_SEND_LENGTH, perSecond(BENCHMARK_SEND_LENGTH, streamMicros), (double) cycles / BENCHMARK_SEND_LENGTH,
+           exitMicros, BENCHMARK_PACKET_LENGTH, perSecond(BENCHMARK_SEND_LENGTH, packetMicros));
+    deleteTestWifi(wifi, &simulator);
+}
+
+static void benchmarkSocketTypes(void) {    // same packets over each socket type, UDP send doesn't wait for "SEND OK"
+    static const char *NAMES[] = {"TCP", "UDP", "SSL"};
+    static char payload[BENCHMARK_SEND_LENGTH];
+    for (uint32_t i = 0; i < BENCHMARK_SEND_LENGTH; i++) {
+        payload[i] = (char) (i * 13);
+    }
+    double rates[3];
+    for (SocketType type = ESP8266_SOCKET_TCP; type <= ESP8266_SOCKET_SSL; type++) {
+        ESP8266Simulator simulator;
+        WiFi *wifi = createTestWifi(&simulator);
+        ASSERT_TRUE(joinTestAccessPoint(wifi, &simulator));
+        SocketConfig config = {.type = type, .host = "example.com", .port = 5000, .sslBufferSize = (type == ESP8266_SOCKET_SSL) ? 4096 : 0};
+        ASSERT_TRUE(isResponseStatusSuccess(connectSocketESP8266(wifi, CONNECTION_ID_0, &config)));
+        setBaudRateHost(TEST_USART, 921600);
+        simulator.sendAckMicros = BENCHMARK_SEND_ACK_MICROS;
+        simulator.sslRecordMicros = BENCHMARK_SSL_RECORD_MICROS;
+
+        uint64_t startMicros = getMicrosHost();
+        uint64_t startCycles = readCycleCounterHost();
+        for (uint32_t position = 0; position < BENCHMARK_SEND_LENGTH; position += BENCHMARK_PACKET_LENGTH) {
+            ResponseStatus status = (type == ESP8266_SOCKET_UDP)
+                    ? sendDatagramESP8266(wifi, CONNECTION_ID_0, &payload[position], BENCHMARK_PACKET_LENGTH)
+                    : sendLargeESP8266(wifi, CONNECTION_ID_0, &payload[position], BENCHMARK_PACKET_LENGTH, NULL);
+            ASSERT_TRUE(isResponseStatusSuccess(status));
+        }
+        for (uint32_t i = 0; i < 100000 && wifi->isSendPending; i++) {   // last datagram status
+            pollTestWifi(wifi);
+        }
+        uint64_t cycles = readCycleCounterHost() - startCycles;
+        uint64_t micros = getMicrosHost() - startMicros;
+        ASSERT_TRUE(!wifi->isSendPending && isResponseStatusSuccess(wifi->lastSendStatus));
+        ASSERT_EQ(BENCHMARK_SEND_LENGTH / BENCHMARK_PACKET_LENGTH, simulator.sendCount);
+        ASSERT_MEM_EQ(payload, simulator.payload, BENCHMARK_SEND_LENGTH);
+
+        rates[type] = perSecond(BENCHMARK_SEND_LENGTH, micros);
+        printf("  %s socket: %u bytes in %u byte packets at 921600 baud, %.0f bytes/s virtual, %.2f host cycles/byte\n",
+               NAMES[type], BENCHMARK_SEND_LENGTH, BENCHMARK_PACKET_LENGTH, rates[type], (double) cycles / BENCHMARK_SEND_LENGTH);
+        deleteTestWifi(wifi, &simulator);
+    }
+    ASSERT_TRUE(rates[ESP8266_SOCKET_UDP] > rates[ESP8266_SOCKET_TCP]);
+    ASSERT_TRUE(rates[ESP8266_SOCKET_TCP] > rates[ESP8266_SOCKET_SSL]);
+}
+
+typedef ResponseStatus (*SendPath)(WiFi *wifi, const char *data, uint32_t length);
+
+typedef struct SendLatency {
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint64_t hostCycles;
+    uint32_t addressConfigs;    // TX stream reconfigurations
+    uint32_t lineMicros;        // command and prompt on line, module answer delay
+} SendLatency;
+
+static void setDMATransmitBufferAddress(USART_DMA *USARTDmaInstance, char *bufferPointer, uint32_t bufferSize) {  // removed driver code, kept as baseline
+    USARTDmaInstance->txData->bufferSize = bufferSize;
+    USARTDmaInstance->txData->bufferPointer = bufferPointer;
+
+    LL_DMA_DisableStream(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream);
+    uint32_t dataRegisterAddress = LL_USART_DMA_GetRegAddr(USARTDmaInstance->USARTx);
+    uint32_t txDataTransferDirection = LL_DMA_GetDataTransferDirection(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream);
+    LL_DMA_ConfigAddresses(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream, (uint32_t) (uintptr_t) bufferPointer, dataRegisterAddress, txDataTransferDirection);
+    enableDMAStream(USARTDmaInstance->DMAx, USARTDmaInstance->txData->stream);
+    LL_USART_EnableDMAReq_TX(USARTDmaInstance->USARTx);
+    LL_USART_EnableDMAReq_RX(USARTDmaInstance->USARTx);
+}
+
+static ResponseStatus sendWithBufferSwap(WiFi *wifi, const char *data, uint32_t length) {  // before command lane, AT prefix built in stack buffer set as TX DMA address
+    char tmpBuffer[20];
+    uint32_t savedBufferSize = wifi->USARTDma->txData->bufferSize;
+    char *savedTxBuffer = wifi->USARTDma->txData->bufferPointer;
+    METRICS_START_SEND(wifi);
+    setDMATransmitBufferAddress(wifi->USARTDma, tmpBuffer, sizeof(tmpBuffer));
+
+    CommandBuilder command = beginCommand(tmpBuffer, sizeof(tmpBuffer), AT_SOCKET_SEND);
+    appendNumber(&command, length);
+    sendATCommand(wifi, &command);
+    ResponseStatus status = waitForResponseESP8266(wifi);
+    setDMATransmitBufferAddress(wifi->USARTDma, savedTxBuffer, savedBufferSize);
+    if (!isResponseStatusSuccess(status)) return status;
+
+    SendSegment segment = {.data = data, .length = length};
+    transmitPayload(wifi, &segment, 1, false);
+    return waitForResponseESP8266(wifi);
+}
+
+static ResponseStatus sendWithCommandLane(WiFi *wifi, const char *data, uint32_t length) {
+    return sendLargeESP8266(wifi, CONNECTION_ID_0, data, length, NULL);
+}
+
+static bool measureSendLatency(SendPath send, SendLatency *latency) {
+    ESP8266Simulator simulator;
+    WiFi *wifi = createTestWifi(&simulator);
+    if (wifi == NULL || !joinTestAccessPoint(wifi, &simulator) || !isResponseStatusSuccess(connectESP8266(wifi, "example.com", 80))) return false;
+    setBaudRateHost(TEST_USART, 921600);
+
+    static const char PACKET[64] = "telemetry";
+    *latency = (SendLatency) {.minCycles = UINT32_MAX};
+    uint32_t addressConfigs = TEST_DMA->streams[TEST_TX_STREAM].addressConfigs;
+    uint32_t sends = wifi->metrics.sends;
+    bool isSent = true;
+    for (uint32_t i = 0; i < iterations && isSent; i++) {
+        uint32_t sendCycles = wifi->metrics.sendCycles;
+        uint64_t startCycles = readCycleCounterHost();
+        isSent = isResponseStatusSuccess(send(wifi, PACKET, sizeof(PACKET)));
+        latency->hostCycles += readCycleCounterHost() - startCycles;
+        uint32_t cycles = wifi->metrics.sendCycles - sendCycles;
+        latency->minCycles = (cycles < latency->minCycles) ? cycles : latency->minCycles;
+        latency->maxCycles = (cycles > latency->maxCycles) ? cycles : latency->maxCycles;
+        latency->totalCycles += cycles;
+    }
+    latency->addressConfigs = TEST_DMA->streams[TEST_TX_STREAM].addressConfigs - addressConfigs;
+    latency->lineMicros = getTransferMicrosHost(TEST_USART, strlen("AT+CIPSEND=64\r\n") + strlen("\r\nOK\r\n> ")) + simulator.latencyMicros;
+    isSent = isSent && wifi->metrics.sends - sends == iterations && simulator.sendCount >= iterations;
+    deleteTestWifi(wifi, &simulator);
+    return isSent;
+}
+
+static void printSendLatency(const char *name, const SendLatency *latency) {
+    double cyclesPerMicro = SystemCoreClock / 1000000.0;
+    printf("  send latency %s: min %.0f, avg %.0f, max %.0f us virtual, %.0f host cycles/send, %" PRIu32 " TX stream reconfigurations\n",
+           name, latency->minCycles / cyclesPerMicro, (double) latency->totalCycles / iterations / cyclesPerMicro,
+           latency->maxCycles / cyclesPerMicro, (double) latency->hostCycles / iterations, latency->addressConfigs);
+}
+
+static void benchmarkSendLatency(void) {    // send call to payload DMA start from driver metrics, DWT follows virtual time, before and after command lane
+    SendLatency before;
+    SendLatency after;
+    ASSERT_TRUE(measureSendLatency(sendWithBufferSwap, &before));
+    ASSERT_TRUE(measureSendLatency(sendWithCommandLane, &after));
+
+    double cyclesPerMicro = SystemCoreClock / 1000000.0;
+    ASSERT_TRUE(after.minCycles / cyclesPerMicro >= after.lineMicros);
+    ASSERT_EQ(2 * iterations, before.addressConfigs);   // swap to stack buffer and back on every send
+    ASSERT_EQ(0, after.addressConfigs);
+    ASSERT_TRUE(after.totalCycles <= before.totalCycles);
+    printf("  %" PRIu32 " sends of 64 bytes at 921600 baud, line and module %" PRIu32 " us\n", iterations, after.lineMicros);
+    printSendLatency("before (TX buffer swap)", &before);
+    printSendLatency("after (command lane)", &after);
+}
+
+static void benchmarkCommandBuilder(void) {     // AT+CIPSEND and AT+CWJAP_CUR pair, builder against snprintf of same text
+    static const char SSID[] = "home network";
+    static const char PASSWORD[] = "correct horse battery";
+    char builderBuffer[ESP8266_COMMAND_MAX_LENGTH];
+    char printfBuffer[ESP8266_COMMAND_MAX_LENGTH];
+    volatile uint32_t sink = 0;     // lengths are used, loops are not removed by optimizer
+
+    uint64_t startCycles = readCycleCounterHost();
+    for (uint32_t i = 0; i < iterations; i++) {
+        CommandBuilder send = beginCommand(builderBuffer, sizeof(builderBuffer), AT_SOCKET_SEND);
+        appendNumber(&send, i % ESP8266_CONNECTION_COUNT);
+        appendNumber(&send, 512 + i % 1024);
+        sink += finishCommand(&send);
+        CommandBuilder join = beginCommand(builderBuffer, sizeof(builderBuffer), AT_JOIN_CURRENT);
+        appendQuoted(&join, SSID);
+        appendQuoted(&join, PASSWORD);
+        sink += finishCommand(&join);
+    }
+    uint64_t builderCycles = readCycleCounterHost() - startCycles;
+
+    startCycles = readCycleCounterHost();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += snprintf(printfBuffer, sizeof(printfBuffer), "AT+CIPSEND=%" PRIu32 ",%" PRIu32 "\r\n", i % ESP8266_CONNECTION_COUNT, 512 + i % 1024);
+        sink += snprintf(printfBuffer, sizeof(printfBuffer), "AT+CWJAP_CUR=\"%s\",\"%s\"\r\n", SSID, PASSWORD);
+    }
+    uint64_t printfCycles = readCycleCounterHost() - startCycles;
+    (void) sink;
+
+    uint32_t length = 0;
+    CommandBuilder join = beginCommand(builderBuffer, sizeof(builderBuffer), AT_JOIN_CURRENT);
+    appendQuoted(&join, SSID);
+    appendQuoted(&join, PASSWORD);
+    length = finishCommand(&join);
+    ASSERT_EQ(strlen(printfBuffer), length);    // same text, plain ssid needs no escape
+    ASSERT_MEM_EQ(printfBuffer, builderBuffer, length);
+    printf("  command builder: %" PRIu32 " command pairs, %.0f host cycles/pair; snprintf: %.0f host cycles/pair\n",
+           iterations, (double) builderCycles / iterations, (double) printfCycles / iterations);
+}
+
+static void benchmarkMatcher(void) {
+    static const char RESPONSE[] = "+CWLAP:(3,\"home\",-55,\"a0:b1:c2:d3:e4:00\",6)\r\n"
+                                   "+CWLAP:(4,\"office\",-71,\"a0:b1:c2:d3:e4:01\",11)\r\n"
+                                   "STATUS:2\r\n\r\nRecv 512 bytes\r\n\r\nSEND OK\r\n\r\nOK\r\n";
+    ResponseMatcher matcher = {0};
+    uint64_t bytes = 0;
+    uint64_t startCycles = readCycleCounterHost();
+    for (uint32_t i = 0; i < iterations; i++) {
+        memset(&matcher, 0, sizeof(struct ResponseMatcher));
+        for (uint32_t j = 0; j < sizeof(RESPONSE) - 1; j++) {
+            feedResponseMatcher(&matcher, RESPONSE[j]);
+        }
+        bytes += sizeof(RESPONSE) - 1;
+    }
+    uint64_t cycles = readCycleCounterHost() - startCycles;
+    ASSERT_TRUE(matcher.matchedPatterns & PATTERN_BIT(OK_PATTERN));
+    printf("  matcher: %" PRIu64 " bytes, %.2f host cycles/byte\n", bytes, (double) cycles / (double) bytes);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 10);
+        iterations = (iterations > 0) ? iterations : 1;
+    }
+    RUN_TEST(benchmarkCommandRate);
+    RUN_TEST(benchmarkChunkedResponse);
+    RUN_TEST(benchmarkSendThroughput);
+    RUN_TEST(benchmarkTransparentStream);
+    RUN_TEST(benchmarkSocketTypes);
+    RUN_TEST(benchmarkSendLatency);
+    RUN_TEST(benchmarkCommandBuilder);
+    RUN_TEST(benchmarkMatcher);
+    return finishTests();
+}
@@ -0,0 +1,23 @@
+#include "DWT_Delay.h"
+
+#include "HostPlatform.h"
+
+DWT_Type hostDWT;
+uint32_t SystemCoreClock = HOST_CORE_CLOCK_HZ;
+
+
+void dwtDelayInit(void) {
+}
+
+void delay_us(uint32_t us) {
+    advanceTimeHost(us);
+}
+
+void delay_ms(uint32_t ms) {
+    advanceTimeHost((uint64_t) ms * 1000);
+}
+
+uint32_t currentMilliSeconds(void) {
+    pollTimeHost();
+    return (uint32_t) (getMicrosHost() / 1000);
+}
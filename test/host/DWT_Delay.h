@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for DWTDelay, cycle counter follows virtual clock from HostPlatform.h
+
+typedef struct DWT_Type {
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+extern DWT_Type hostDWT;
+extern uint32_t SystemCoreClock;
+
+#define DWT (&hostDWT)
+
+void dwtDelayInit(void);
+void delay_us(uint32_t us);
+void delay_ms(uint32_t ms);
+uint32_t currentMilliSeconds(void);     // each call is one poll step of virtual time
@@ -0,0 +1,121 @@
+#include "HostPlatform.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "USART_DMA.h"
+#include "DWT_Delay.h"
+
+typedef struct HostEvent {
+    uint64_t atMicros;
+    HostEventHandler handler;
+    void *context;
+    uint32_t length;
+    struct HostEvent *next;
+    char data[];
+} HostEvent;
+
+static uint64_t currentMicros;
+static uint32_t pollStepMicros = HOST_DEFAULT_POLL_STEP_US;
+static HostEvent *pendingEvents;     // sorted by time, same time events keep scheduling order
+static uint32_t heapCalls;
+
+static void runDueEvents(uint64_t untilMicros);
+static void updateCycleCounter(void);
+
+
+uint64_t getMicrosHost(void) {
+    return currentMicros;
+}
+
+void advanceTimeHost(uint64_t micros) {
+    uint64_t targetMicros = currentMicros + micros;
+    runDueEvents(targetMicros);
+    currentMicros = targetMicros;
+    updateCycleCounter();
+}
+
+void pollTimeHost(void) {
+    advanceTimeHost(pollStepMicros);
+}
+
+void setPollStepHost(uint32_t micros) {
+    pollStepMicros = (micros > 0) ? micros : 1;
+}
+
+void scheduleEventHost(uint64_t atMicros, HostEventHandler handler, void *context, const char *data, uint32_t length) {
+    HostEvent *event = malloc(sizeof(struct HostEvent) + length);
+    if (event == NULL) abort();
+    event->atMicros = atMicros;
+    event->handler = handler;
+    event->context = context;
+    event->length = length;
+    if (length > 0) {
+        memcpy(event->data, data, length);
+    }
+
+    HostEvent **link = &pendingEvents;
+    while (*link != NULL && (*link)->atMicros <= atMicros) {
+        link = &(*link)->next;
+    }
+    event->next = *link;
+    *link = event;
+}
+
+void resetHost(void) {
+    while (pendingEvents != NULL) {
+        HostEvent *event = pendingEvents;
+        pendingEvents = event->next;
+        free(event);
+    }
+    currentMicros = 0;
+    heapCalls = 0;
+    pollStepMicros = HOST_DEFAULT_POLL_STEP_US;
+    updateCycleCounter();
+    resetPeripheralsHost();
+}
+
+uint64_t readCycleCounterHost(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;    // nanoseconds, close to cycles at 1 GHz
+#endif
+}
+
+void *mallocHost(size_t size) {
+    heapCalls++;
+    return malloc(size);
+}
+
+void freeHost(void *pointer) {
+    heapCalls++;
+    free(pointer);
+}
+
+uint32_t getHeapCallsHost(void) {
+    return heapCalls;
+}
+
+static void runDueEvents(uint64_t untilMicros) {
+    while (pendingEvents != NULL && pendingEvents->atMicros <= untilMicros) {
+        HostEvent *event = pendingEvents;
+        pendingEvents = event->next;    // handler can schedule new events
+        if (event->atMicros > currentMicros) {
+            currentMicros = event->atMicros;
+            updateCycleCounter();
+        }
+        event->handler(event->context, event->data, event->length);
+        free(event);
+    }
+}
+
+static void updateCycleCounter(void) {
+    DWT->CYCCNT = (uint32_t) (currentMicros * (SystemCoreClock / 1000000));
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Virtual time for host build. Clock advances only when driver reads time or hardware status,
+// so simulated module latency and UART timing are reproducible and independent from host speed.
+
+#define HOST_DEFAULT_POLL_STEP_US   50      // virtual time of one status read, like busy loop on target
+#define HOST_CORE_CLOCK_HZ          168000000
+
+typedef void (*HostEventHandler)(void *context, const char *data, uint32_t length);
+
+uint64_t getMicrosHost(void);
+void advanceTimeHost(uint64_t micros);     // due events are run in time order
+void pollTimeHost(void);                   // single poll step
+void setPollStepHost(uint32_t micros);
+void scheduleEventHost(uint64_t atMicros, HostEventHandler handler, void *context, const char *data, uint32_t length);  // data is copied
+void resetHost(void);                      // drop pending events, reset peripherals and restart clock from zero
+
+uint64_t readCycleCounterHost(void);
+void *mallocHost(size_t size);             // counted heap for ESP8266_MALLOC/ESP8266_FREE, driver allocations can be asserted
+void freeHost(void *pointer);
+uint32_t getHeapCallsHost(void);            // mallocHost() and freeHost() calls since reset        // host CPU timestamp counter, for benchmarks only
@@ -0,0 +1,38 @@
+#include "IPAddress.h"
+
+#include <string.h>
+
+static bool parseIPv4Address(const char *ipAddress, IPAddress *result);
+
+
+IPAddress ipAddressFromString(const char *ipAddress) {
+    IPAddress result = {0};
+    if (!parseIPv4Address(ipAddress, &result)) {
+        memset(&result, 0, sizeof(struct IPAddress));
+    }
+    return result;
+}
+
+bool isIPv4AddressValid(const char *ipAddress) {
+    IPAddress result;
+    return parseIPv4Address(ipAddress, &result);
+}
+
+static bool parseIPv4Address(const char *ipAddress, IPAddress *result) {
+    if (ipAddress == NULL || strlen(ipAddress) > IP_ADDRESS_LENGTH) return false;
+    for (uint8_t i = 0; i < 4; i++) {
+        uint16_t octet = 0;
+        uint8_t digitCount = 0;
+        while (*ipAddress >= '0' && *ipAddress <= '9' && digitCount < 3) {
+            octet = (octet * 10) + (*ipAddress++ - '0');
+            digitCount++;
+        }
+        if (digitCount == 0 || octet > 255) return false;
+        result->octets[i] = octet;
+
+        char expected = (i < 3) ? '.' : '\0';
+        if (*ipAddress != expected) return false;
+        ipAddress++;
+    }
+    return true;
+}
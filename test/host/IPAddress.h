@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host stand-in for Ethernet IPAddress, only calls used by driver
+
+#define IP_ADDRESS_LENGTH 15    // "255.255.255.255"
+
+typedef struct IPAddress {
+    uint8_t octets[4];
+} IPAddress;
+
+IPAddress ipAddressFromString(const char *ipAddress);  // zero address if not valid
+bool isIPv4AddressValid(const char *ipAddress);
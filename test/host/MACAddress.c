@@ -0,0 +1,31 @@
+#include "MACAddress.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+static int8_t parseHexDigit(char symbol);
+
+
+MACAddress macAddressFromString(const char *macAddress) {
+    MACAddress result = {0};
+    if (macAddress == NULL || strlen(macAddress) != MAC_ADDRESS_LENGTH) return result;
+
+    for (uint8_t i = 0; i < 6; i++) {
+        const char *octet = &macAddress[i * 3];
+        int8_t high = parseHexDigit(octet[0]);
+        int8_t low = parseHexDigit(octet[1]);
+        bool isSeparatorValid = (i == 5) || octet[2] == ':' || octet[2] == '-';
+        if (high < 0 || low < 0 || !isSeparatorValid) {
+            return (MACAddress) {0};
+        }
+        result.octets[i] = (high << 4) | low;
+    }
+    return result;
+}
+
+static int8_t parseHexDigit(char symbol) {
+    if (symbol >= '0' && symbol <= '9') return symbol - '0';
+    if (symbol >= 'a' && symbol <= 'f') return symbol - 'a' + 10;
+    if (symbol >= 'A' && symbol <= 'F') return symbol - 'A' + 10;
+    return -1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for Ethernet MACAddress, only calls used by driver
+
+#define MAC_ADDRESS_LENGTH 17   // "aa:bb:cc:dd:ee:ff"
+
+typedef struct MACAddress {
+    uint8_t octets[6];
+} MACAddress;
+
+MACAddress macAddressFromString(const char *macAddress);   // zero address if not valid
@@ -0,0 +1,393 @@
+#include "USART_DMA.h"
+
+#include "HostPlatform.h"
+
+#define USART_DMA_REGISTRY_SIZE 4
+#define USART_DATA_REGISTER_ADDRESS 0x40011004U
+
+USART_TypeDef hostUSART[HOST_USART_COUNT];
+DMA_TypeDef hostDMA[HOST_DMA_COUNT];
+
+static USART_DMA *registry[USART_DMA_REGISTRY_SIZE];   // instances reachable from interrupt callbacks
+
+static void registerUSART_DMA(USART_DMA *USARTDma);
+static void unregisterUSART_DMA(USART_DMA *USARTDma);
+static USART_DMA *findByUSART(USART_TypeDef *USARTx);
+static USART_DMA *findByStream(DMA_TypeDef *DMAx, uint32_t stream);
+static uint32_t toAddress(const void *pointer);
+static void onTransmitComplete(void *context, const char *data, uint32_t length);
+static void onReceiveBurst(void *context, const char *data, uint32_t length);
+static void receiveSymbol(USART_TypeDef *USARTx, char symbol);
+static void raiseUsartInterrupt(USART_TypeDef *USARTx);
+static void raiseDmaInterrupt(DMA_TypeDef *DMAx, uint32_t stream);
+
+
+USART_DMA *initUSART_DMA(USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream, uint32_t rxBufferSize, uint32_t txBufferSize) {
+    USART_DMA *USARTDma = malloc(sizeof(struct USART_DMA));
+    USART_DMA_Data *rxData = malloc(sizeof(struct USART_DMA_Data));
+    USART_DMA_Data *txData = malloc(sizeof(struct USART_DMA_Data));
+    char *rxBuffer = calloc(rxBufferSize, 1);
+    char *txBuffer = calloc(txBufferSize, 1);
+    if (USARTDma == NULL || rxData == NULL || txData == NULL || rxBuffer == NULL || txBuffer == NULL) {
+        free(USARTDma);
+        free(rxData);
+        free(txData);
+        free(rxBuffer);
+        free(txBuffer);
+        return NULL;
+    }
+
+    *rxData = (USART_DMA_Data) {.stream = rxStream, .bufferPointer = rxBuffer, .bufferSize = rxBufferSize};
+    *txData = (USART_DMA_Data) {.stream = txStream, .bufferPointer = txBuffer, .bufferSize = txBufferSize};
+    initStaticUSART_DMA(USARTDma, USARTx, DMAx, rxData, txData);
+    return USARTDma;
+}
+
+void initStaticUSART_DMA(USART_DMA *USARTDma, USART_TypeDef *USARTx, DMA_TypeDef *DMAx, USART_DMA_Data *rxData, USART_DMA_Data *txData) {
+    USARTDma->USARTx = USARTx;
+    USARTDma->DMAx = DMAx;
+    USARTDma->rxData = rxData;
+    USARTDma->txData = txData;
+    rxData->isTransferComplete = false;
+    txData->isTransferComplete = true;
+
+    USARTx->DMAx = DMAx;
+    USARTx->rxStream = rxData->stream;
+    USARTx->txStream = txData->stream;
+    LL_DMA_ConfigAddresses(DMAx, rxData->stream, LL_USART_DMA_GetRegAddr(USARTx), toAddress(rxData->bufferPointer), LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetDataLength(DMAx, rxData->stream, rxData->bufferSize);
+    LL_DMA_ConfigAddresses(DMAx, txData->stream, toAddress(txData->bufferPointer), LL_USART_DMA_GetRegAddr(USARTx), LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_EnableIT_TC(DMAx, rxData->stream);
+    LL_DMA_EnableIT_TC(DMAx, txData->stream);
+    LL_USART_EnableDMAReq_RX(USARTx);
+    LL_USART_EnableDMAReq_TX(USARTx);
+    LL_USART_EnableIT_IDLE(USARTx);
+    registerUSART_DMA(USARTDma);
+}
+
+void transmitUSART_DMA(USART_DMA *USARTDma, char *data, uint16_t length) {
+    USART_TypeDef *USARTx = USARTDma->USARTx;
+    if (USARTx->pendingTransmits > 0) {
+        USARTx->overlappedTransmits++;
+    }
+    USARTDma->txData->isTransferComplete = false;
+    USARTx->transmitLog[USARTx->transmitCalls % HOST_TRANSMIT_LOG_SIZE] = data;
+    USARTx->transmitCalls++;
+
+    uint64_t startMicros = getMicrosHost();     // queued after transfer in progress
+    if (USARTx->txLineFreeMicros > startMicros) {
+        startMicros = USARTx->txLineFreeMicros;
+    }
+    USARTx->txLineFreeMicros = startMicros + getTransferMicrosHost(USARTx, length);
+    USARTx->pendingTransmits++;
+    scheduleEventHost(USARTx->txLineFreeMicros, onTransmitComplete, USARTx, data, length);
+}
+
+void transmitTxBufferUSART_DMA(USART_DMA *USARTDma) {
+    transmitUSART_DMA(USARTDma, USARTDma->txData->bufferPointer, strlen(USARTDma->txData->bufferPointer));
+}
+
+void receiveRxBufferUSART_DMA(USART_DMA *USARTDma) {
+    USART_DMA_Data *rxData = USARTDma->rxData;
+    LL_DMA_DisableStream(USARTDma->DMAx, rxData->stream);
+    rxData->isTransferComplete = false;
+    LL_DMA_SetMemoryAddress(USARTDma->DMAx, rxData->stream, toAddress(rxData->bufferPointer));
+    LL_DMA_SetDataLength(USARTDma->DMAx, rxData->stream, rxData->bufferSize);
+    enableDMAStream(USARTDma->DMAx, rxData->stream);
+}
+
+bool isTransferCompleteUSART_DMA(USART_DMA_Data *data) {
+    pollTimeHost();
+    return data->isTransferComplete;
+}
+
+void enableDMAStream(DMA_TypeDef *DMAx, uint32_t stream) {
+    DMAx->streams[stream].isHalfTransferFlag = false;
+    DMAx->streams[stream].isTransferCompleteFlag = false;
+    LL_DMA_EnableStream(DMAx, stream);
+}
+
+void interruptCallbackUSART(USART_TypeDef *USARTx) {    // idle line ends RX transfer
+    if (!LL_USART_IsActiveFlag_IDLE(USARTx)) return;
+    LL_USART_ClearFlag_IDLE(USARTx);
+    USART_DMA *USARTDma = findByUSART(USARTx);
+    if (USARTDma != NULL) {
+        LL_DMA_DisableStream(USARTDma->DMAx, USARTDma->rxData->stream);
+    }
+}
+
+void transferCompleteCallbackUSART_DMA(DMA_TypeDef *DMAx, uint32_t stream) {
+    HostDmaStream *dmaStream = &DMAx->streams[stream];
+    dmaStream->isHalfTransferFlag = false;
+    if (!dmaStream->isTransferCompleteFlag) return;
+    dmaStream->isTransferCompleteFlag = false;
+
+    USART_DMA *USARTDma = findByStream(DMAx, stream);
+    if (USARTDma == NULL) return;
+    if (USARTDma->rxData->stream == stream) {
+        USARTDma->rxData->isTransferComplete = true;
+    } else if (USARTDma->USARTx->pendingTransmits == 0) {   // all queued transmits left TX line
+        USARTDma->txData->isTransferComplete = true;
+    }
+}
+
+void releaseUSART_DMA(USART_DMA *USARTDma) {
+    if (USARTDma == NULL) return;
+    unregisterUSART_DMA(USARTDma);
+    LL_DMA_DisableStream(USARTDma->DMAx, USARTDma->rxData->stream);
+}
+
+void deleteUSART_DMA(USART_DMA *USARTDma) {
+    if (USARTDma == NULL) return;
+    releaseUSART_DMA(USARTDma);
+    free(USARTDma->rxData->bufferPointer);
+    free(USARTDma->txData->bufferPointer);
+    free(USARTDma->rxData);
+    free(USARTDma->txData);
+    free(USARTDma);
+}
+
+void LL_DMA_EnableStream(DMA_TypeDef *DMAx, uint32_t stream) {
+    DMAx->streams[stream].isEnabled = true;
+}
+
+void LL_DMA_DisableStream(DMA_TypeDef *DMAx, uint32_t stream) {
+    HostDmaStream *dmaStream = &DMAx->streams[stream];
+    if (!dmaStream->isEnabled) return;
+    dmaStream->isEnabled = false;
+    dmaStream->isTransferCompleteFlag = true;
+    if (dmaStream->isTransferCompleteInterruptEnabled) {
+        raiseDmaInterrupt(DMAx, stream);
+    }
+}
+
+void LL_DMA_SetMode(DMA_TypeDef *DMAx, uint32_t stream, uint32_t mode) {
+    DMAx->streams[stream].mode = mode;
+}
+
+uint32_t LL_DMA_GetDataTransferDirection(DMA_TypeDef *DMAx, uint32_t stream) {
+    return DMAx->streams[stream].direction;
+}
+
+void LL_DMA_ConfigAddresses(DMA_TypeDef *DMAx, uint32_t stream, uint32_t sourceAddress, uint32_t destinationAddress, uint32_t direction) {
+    HostDmaStream *dmaStream = &DMAx->streams[stream];
+    dmaStream->addressConfigs++;
+    dmaStream->direction = direction;
+    dmaStream->memoryAddress = (direction == LL_DMA_DIRECTION_PERIPH_TO_MEMORY) ? destinationAddress : sourceAddress;
+}
+
+void LL_DMA_SetMemoryAddress(DMA_TypeDef *DMAx, uint32_t stream, uint32_t memoryAddress) {
+    DMAx->streams[stream].memoryAddress = memoryAddress;
+}
+
+void LL_DMA_SetDataLength(DMA_TypeDef *DMAx, uint32_t stream, uint32_t length) {
+    DMAx->streams[stream].dataLength = length;
+    DMAx->streams[stream].reloadLength = length;
+}
+
+uint32_t LL_DMA_GetDataLength(DMA_TypeDef *DMAx, uint32_t stream) {
+    return DMAx->streams[stream].dataLength;
+}
+
+void LL_DMA_EnableIT_HT(DMA_TypeDef *DMAx, uint32_t stream) {
+    DMAx->streams[stream].isHalfTransferInterruptEnabled = true;
+}
+
+void LL_DMA_EnableIT_TC(DMA_TypeDef *DMAx, uint32_t stream) {
+    DMAx->streams[stream].isTransferCompleteInterruptEnabled = true;
+}
+
+void LL_DMA_DisableIT_HT(DMA_TypeDef *DMAx, uint32_t stream) {
+    DMAx->streams[stream].isHalfTransferInterruptEnabled = false;
+}
+
+void LL_DMA_DisableIT_TC(DMA_TypeDef *DMAx, uint32_t stream) {
+    DMAx->streams[stream].isTransferCompleteInterruptEnabled = false;
+}
+
+uint32_t LL_USART_DMA_GetRegAddr(USART_TypeDef *USARTx) {
+    return USART_DATA_REGISTER_ADDRESS + (uint32_t) (USARTx - hostUSART) * 0x400U;
+}
+
+void LL_USART_EnableDMAReq_RX(USART_TypeDef *USARTx) {
+    USARTx->isRxDmaRequestEnabled = true;
+}
+
+void LL_USART_EnableDMAReq_TX(USART_TypeDef *USARTx) {
+    USARTx->isTxDmaRequestEnabled = true;
+}
+
+void LL_USART_EnableIT_IDLE(USART_TypeDef *USARTx) {
+    USARTx->isIdleInterruptEnabled = true;
+}
+
+uint32_t LL_USART_IsActiveFlag_IDLE(USART_TypeDef *USARTx) {
+    return USARTx->isIdleFlag;
+}
+
+void LL_USART_ClearFlag_IDLE(USART_TypeDef *USARTx) {
+    USARTx->isIdleFlag = false;
+}
+
+void setTransmitSinkHost(USART_TypeDef *USARTx, HostTransmitSink sink, void *context) {
+    USARTx->transmitSink = sink;
+    USARTx->transmitContext = context;
+}
+
+void queueReceiveHost(USART_TypeDef *USARTx, uint32_t delayMicros, const char *data, uint32_t length) {
+    uint64_t startMicros = getMicrosHost();
+    if (USARTx->rxLineFreeMicros > startMicros) {
+        startMicros = USARTx->rxLineFreeMicros;
+    }
+    USARTx->rxLineFreeMicros = startMicros + delayMicros + getTransferMicrosHost(USARTx, length);
+    scheduleEventHost(USARTx->rxLineFreeMicros, onReceiveBurst, USARTx, data, length);  // delivered when last byte is on line
+}
+
+void setUsartIrqHandlerHost(USART_TypeDef *USARTx, HostIrqHandler handler, void *context) {
+    USARTx->irqHandler = handler;
+    USARTx->irqContext = context;
+}
+
+void setDmaIrqHandlerHost(DMA_TypeDef *DMAx, uint32_t stream, HostIrqHandler handler, void *context) {
+    DMAx->streams[stream].irqHandler = handler;
+    DMAx->streams[stream].irqContext = context;
+}
+
+void setBaudRateHost(USART_TypeDef *USARTx, uint32_t baudRate) {
+    USARTx->baudRate = baudRate;
+}
+
+uint64_t getTransferMicrosHost(USART_TypeDef *USARTx, uint32_t length) {    // start, 8 data and stop bit per symbol
+    uint32_t baudRate = (USARTx->baudRate > 0) ? USARTx->baudRate : HOST_DEFAULT_BAUD_RATE;
+    return ((uint64_t) length * 10 * 1000000 + baudRate - 1) / baudRate;
+}
+
+void resetPeripheralsHost(void) {
+    memset(hostUSART, 0, sizeof(hostUSART));
+    memset(hostDMA, 0, sizeof(hostDMA));
+    memset(registry, 0, sizeof(registry));
+}
+
+static void registerUSART_DMA(USART_DMA *USARTDma) {
+    unregisterUSART_DMA(USARTDma);  // static transport is registered again on each re-init
+    for (uint8_t i = 0; i < USART_DMA_REGISTRY_SIZE; i++) {
+        if (registry[i] == NULL) {
+            registry[i] = USARTDma;
+            return;
+        }
+    }
+    fprintf(stderr, "USART_DMA registry is full\n");
+    abort();
+}
+
+static void unregisterUSART_DMA(USART_DMA *USARTDma) {
+    for (uint8_t i = 0; i < USART_DMA_REGISTRY_SIZE; i++) {
+        if (registry[i] == USARTDma) {
+            registry[i] = NULL;
+        }
+    }
+}
+
+static USART_DMA *findByUSART(USART_TypeDef *USARTx) {
+    for (uint8_t i = 0; i < USART_DMA_REGISTRY_SIZE; i++) {
+        if (registry[i] != NULL && registry[i]->USARTx == USARTx) {
+            return registry[i];
+        }
+    }
+    return NULL;
+}
+
+static USART_DMA *findByStream(DMA_TypeDef *DMAx, uint32_t stream) {
+    for (uint8_t i = 0; i < USART_DMA_REGISTRY_SIZE; i++) {
+        USART_DMA *USARTDma = registry[i];
+        if (USARTDma != NULL && USARTDma->DMAx == DMAx && (USARTDma->rxData->stream == stream || USARTDma->txData->stream == stream)) {
+            return USARTDma;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t toAddress(const void *pointer) {
+    uintptr_t address = (uintptr_t) pointer;
+    if (address > UINT32_MAX) {
+        fprintf(stderr, "DMA buffer %p is out of 32 bit address space, link host executable without PIE\n", pointer);
+        abort();
+    }
+    return (uint32_t) address;
+}
+
+static void onTransmitComplete(void *context, const char *data, uint32_t length) {
+    USART_TypeDef *USARTx = context;
+    USARTx->txBytes += length;
+    USARTx->pendingTransmits--;
+    if (USARTx->transmitSink != NULL) {
+        USARTx->transmitSink(data, length, USARTx->transmitContext);
+    }
+
+    HostDmaStream *dmaStream = &USARTx->DMAx->streams[USARTx->txStream];
+    dmaStream->isTransferCompleteFlag = true;
+    if (dmaStream->isTransferCompleteInterruptEnabled) {
+        raiseDmaInterrupt(USARTx->DMAx, USARTx->txStream);
+    }
+}
+
+static void onReceiveBurst(void *context, const char *data, uint32_t length) {
+    USART_TypeDef *USARTx = context;
+    for (uint32_t i = 0; i < length; i++) {
+        receiveSymbol(USARTx, data[i]);
+    }
+    USARTx->isIdleFlag = true;
+    if (USARTx->isIdleInterruptEnabled) {
+        raiseUsartInterrupt(USARTx);
+    }
+}
+
+static void receiveSymbol(USART_TypeDef *USARTx, char symbol) {
+    HostDmaStream *dmaStream = (USARTx->DMAx != NULL) ? &USARTx->DMAx->streams[USARTx->rxStream] : NULL;
+    if (!USARTx->isRxDmaRequestEnabled || dmaStream == NULL || !dmaStream->isEnabled || dmaStream->dataLength == 0) {
+        USARTx->droppedRxBytes++;   // overrun, no one reads data register
+        return;
+    }
+
+    char *memory = (char *) (uintptr_t) dmaStream->memoryAddress;
+    memory[dmaStream->reloadLength - dmaStream->dataLength] = symbol;
+    dmaStream->dataLength--;
+    USARTx->rxBytes++;
+
+    bool isHalfTransfer = dmaStream->mode == LL_DMA_MODE_CIRCULAR && dmaStream->dataLength == dmaStream->reloadLength / 2;
+    if (isHalfTransfer) {
+        dmaStream->isHalfTransferFlag = true;
+        if (dmaStream->isHalfTransferInterruptEnabled) {
+            raiseDmaInterrupt(USARTx->DMAx, USARTx->rxStream);
+        }
+    }
+
+    if (dmaStream->dataLength == 0) {
+        if (dmaStream->mode == LL_DMA_MODE_CIRCULAR) {
+            dmaStream->dataLength = dmaStream->reloadLength;
+        } else {
+            dmaStream->isEnabled = false;
+        }
+        dmaStream->isTransferCompleteFlag = true;
+        if (dmaStream->isTransferCompleteInterruptEnabled) {
+            raiseDmaInterrupt(USARTx->DMAx, USARTx->rxStream);
+        }
+    }
+}
+
+static void raiseUsartInterrupt(USART_TypeDef *USARTx) {
+    if (USARTx->irqHandler != NULL) {
+        USARTx->irqHandler(USARTx->irqContext);
+    } else {
+        interruptCallbackUSART(USARTx);
+    }
+}
+
+static void raiseDmaInterrupt(DMA_TypeDef *DMAx, uint32_t stream) {
+    HostDmaStream *dmaStream = &DMAx->streams[stream];
+    if (dmaStream->irqHandler != NULL) {
+        dmaStream->irqHandler(dmaStream->irqContext);
+    } else {
+        transferCompleteCallbackUSART_DMA(DMAx, stream);
+    }
+}
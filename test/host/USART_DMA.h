@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "HostPlatform.h"
+
+// Host stand-in for STM32Core USART_DMA and used LL DMA/USART calls. Peripherals are modelled in software:
+// RX bytes are written through DMA stream registers, idle line and DMA flags raise the same callbacks as interrupts on target.
+// DMA addresses are 32 bit like on target, so host executables are linked without PIE.
+
+#define HOST_USART_COUNT        3
+#define HOST_DMA_COUNT          2
+#define HOST_DMA_STREAM_COUNT   8
+#define HOST_DEFAULT_BAUD_RATE  115200
+#define HOST_TRANSMIT_LOG_SIZE  16
+
+#define LL_DMA_STREAM_0 0U
+#define LL_DMA_STREAM_1 1U
+#define LL_DMA_STREAM_2 2U
+#define LL_DMA_STREAM_3 3U
+#define LL_DMA_STREAM_4 4U
+#define LL_DMA_STREAM_5 5U
+#define LL_DMA_STREAM_6 6U
+#define LL_DMA_STREAM_7 7U
+
+#define LL_DMA_MODE_NORMAL                  0x00000000U
+#define LL_DMA_MODE_CIRCULAR                0x00000100U
+#define LL_DMA_DIRECTION_PERIPH_TO_MEMORY   0x00000000U
+#define LL_DMA_DIRECTION_MEMORY_TO_PERIPH   0x00000040U
+
+typedef void (*HostIrqHandler)(void *context);
+typedef void (*HostTransmitSink)(const char *data, uint32_t length, void *context);
+
+typedef struct HostDmaStream {
+    bool isEnabled;
+    uint32_t mode;
+    uint32_t direction;
+    uint32_t memoryAddress;
+    uint32_t dataLength;            // remaining transfers, counts down like NDTR
+    uint32_t reloadLength;          // programmed length, reloaded in circular mode
+    bool isHalfTransferInterruptEnabled;
+    bool isTransferCompleteInterruptEnabled;
+    bool isHalfTransferFlag;
+    bool isTransferCompleteFlag;
+    uint32_t addressConfigs;        // LL_DMA_ConfigAddresses() calls, stream reconfigurations
+    HostIrqHandler irqHandler;      // NULL - transferCompleteCallbackUSART_DMA()
+    void *irqContext;
+} HostDmaStream;
+
+typedef struct DMA_TypeDef {
+    HostDmaStream streams[HOST_DMA_STREAM_COUNT];
+} DMA_TypeDef;
+
+typedef struct USART_TypeDef {
+    uint32_t baudRate;
+    bool isIdleFlag;
+    bool isIdleInterruptEnabled;
+    bool isRxDmaRequestEnabled;
+    bool isTxDmaRequestEnabled;
+    DMA_TypeDef *DMAx;              // DMA request mapping, set by initUSART_DMA()
+    uint32_t rxStream;
+    uint32_t txStream;
+    uint64_t rxLineFreeMicros;      // end of last scheduled RX burst
+    uint64_t txLineFreeMicros;
+    uint32_t pendingTransmits;
+    HostTransmitSink transmitSink;  // module side of TX line
+    void *transmitContext;
+    HostIrqHandler irqHandler;      // NULL - interruptCallbackUSART()
+    void *irqContext;
+    uint32_t txBytes;
+    uint32_t rxBytes;
+    uint32_t droppedRxBytes;        // received while RX DMA was stopped or full
+    uint32_t transmitCalls;
+    uint32_t overlappedTransmits;   // started while previous TX DMA was running, real stream can't queue it
+    const char *transmitLog[HOST_TRANSMIT_LOG_SIZE];    // source pointers of transmits, transmitCalls % size is next slot
+} USART_TypeDef;
+
+extern USART_TypeDef hostUSART[HOST_USART_COUNT];
+extern DMA_TypeDef hostDMA[HOST_DMA_COUNT];
+
+#define USART1 (&hostUSART[0])
+#define USART2 (&hostUSART[1])
+#define USART3 (&hostUSART[2])
+#define DMA1   (&hostDMA[0])
+#define DMA2   (&hostDMA[1])
+
+typedef struct USART_DMA_Data {
+    uint32_t stream;
+    char *bufferPointer;
+    uint32_t bufferSize;
+    volatile bool isTransferComplete;
+} USART_DMA_Data;
+
+typedef struct USART_DMA {
+    USART_TypeDef *USARTx;
+    DMA_TypeDef *DMAx;
+    USART_DMA_Data *rxData;
+    USART_DMA_Data *txData;
+} USART_DMA;
+
+// STM32Core API
+USART_DMA *initUSART_DMA(USART_TypeDef *USARTx, DMA_TypeDef *DMAx, uint32_t rxStream, uint32_t txStream, uint32_t rxBufferSize, uint32_t txBufferSize);
+void initStaticUSART_DMA(USART_DMA *USARTDma, USART_TypeDef *USARTx, DMA_TypeDef *DMAx, USART_DMA_Data *rxData, USART_DMA_Data *txData);  // caller memory, stream and buffer are set in rxData/txData
+void transmitUSART_DMA(USART_DMA *USARTDma, char *data, uint16_t length);
+void transmitTxBufferUSART_DMA(USART_DMA *USARTDma);
+void receiveRxBufferUSART_DMA(USART_DMA *USARTDma);
+bool isTransferCompleteUSART_DMA(USART_DMA_Data *data);     // one poll step of virtual time
+void enableDMAStream(DMA_TypeDef *DMAx, uint32_t stream);
+void interruptCallbackUSART(USART_TypeDef *USARTx);
+void transferCompleteCallbackUSART_DMA(DMA_TypeDef *DMAx, uint32_t stream);
+void releaseUSART_DMA(USART_DMA *USARTDma);   // unregistered and RX stopped, memory is left to owner
+void deleteUSART_DMA(USART_DMA *USARTDma);
+
+// LL subset
+void LL_DMA_EnableStream(DMA_TypeDef *DMAx, uint32_t stream);
+void LL_DMA_DisableStream(DMA_TypeDef *DMAx, uint32_t stream);  // sets transfer complete flag like on target
+void LL_DMA_SetMode(DMA_TypeDef *DMAx, uint32_t stream, uint32_t mode);
+uint32_t LL_DMA_GetDataTransferDirection(DMA_TypeDef *DMAx, uint32_t stream);
+void LL_DMA_ConfigAddresses(DMA_TypeDef *DMAx, uint32_t stream, uint32_t sourceAddress, uint32_t destinationAddress, uint32_t direction);
+void LL_DMA_SetMemoryAddress(DMA_TypeDef *DMAx, uint32_t stream, uint32_t memoryAddress);
+void LL_DMA_SetDataLength(DMA_TypeDef *DMAx, uint32_t stream, uint32_t length);
+uint32_t LL_DMA_GetDataLength(DMA_TypeDef *DMAx, uint32_t stream);
+void LL_DMA_EnableIT_HT(DMA_TypeDef *DMAx, uint32_t stream);
+void LL_DMA_EnableIT_TC(DMA_TypeDef *DMAx, uint32_t stream);
+void LL_DMA_DisableIT_HT(DMA_TypeDef *DMAx, uint32_t stream);
+void LL_DMA_DisableIT_TC(DMA_TypeDef *DMAx, uint32_t stream);
+uint32_t LL_USART_DMA_GetRegAddr(USART_TypeDef *USARTx);
+void LL_USART_EnableDMAReq_RX(USART_TypeDef *USARTx);
+void LL_USART_EnableDMAReq_TX(USART_TypeDef *USARTx);
+void LL_USART_EnableIT_IDLE(USART_TypeDef *USARTx);
+uint32_t LL_USART_IsActiveFlag_IDLE(USART_TypeDef *USARTx);
+void LL_USART_ClearFlag_IDLE(USART_TypeDef *USARTx);
+
+// Host model control
+void setTransmitSinkHost(USART_TypeDef *USARTx, HostTransmitSink sink, void *context);     // called when each transmit leaves TX line
+void queueReceiveHost(USART_TypeDef *USARTx, uint32_t delayMicros, const char *data, uint32_t length);  // burst after line is free for delay, then idle line
+void setUsartIrqHandlerHost(USART_TypeDef *USARTx, HostIrqHandler handler, void *context);
+void setDmaIrqHandlerHost(DMA_TypeDef *DMAx, uint32_t stream, HostIrqHandler handler, void *context);
+void setBaudRateHost(USART_TypeDef *USARTx, uint32_t baudRate);
+uint64_t getTransferMicrosHost(USART_TypeDef *USARTx, uint32_t length);
+void resetPeripheralsHost(void);
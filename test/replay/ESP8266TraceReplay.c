@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include "HostPlatform.h"
+#include "TraceReplay.h"
+
+// Replays trace dump captured on target into simulated link. Usage: ESP8266TraceReplay <dump file> [baud rate]
+
+#define REPLAY_RX_BUFFER_SIZE   2048
+#define REPLAY_TX_BUFFER_SIZE   1024
+
+static char *readFile(const char *path, uint32_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    char *data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        data = (size > 0) ? malloc(size) : NULL;
+        rewind(file);
+        if (data != NULL && fread(data, 1, size, file) == (size_t) size) {
+            *length = (uint32_t) size;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <dump file> [baud rate]\n", argv[0]);
+        return 2;
+    }
+    uint32_t length = 0;
+    char *dump = readFile(argv[1], &length);
+    if (dump == NULL) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 2;
+    }
+
+    resetHost();
+    if (argc > 2) {
+        setBaudRateHost(USART1, strtoul(argv[2], NULL, 10));
+    }
+    WiFi *wifi = createWifiESP8266(USART1, DMA2, LL_DMA_STREAM_2, LL_DMA_STREAM_7, REPLAY_RX_BUFFER_SIZE, REPLAY_TX_BUFFER_SIZE);
+    TraceReplayReport report;
+    bool isReplayed = (wifi != NULL) && replayTraceHost(wifi, dump, length, &report);
+    free(dump);
+    if (!isReplayed) {
+        fprintf(stderr, "%s is not trace dump\n", argv[1]);
+        deleteESP8266(wifi);
+        return 1;
+    }
+
+    printf("records: %" PRIu32 " (%" PRIu32 " RX, %" PRIu32 " bytes), capture %.3f s at %" PRIu32 " cycles/s\n",
+           report.records, report.rxRecords, report.rxBytes, report.captureMicros / 1000000.0, report.cyclesPerSecond);
+    printf("commands: %" PRIu32 ", completed %" PRIu32 ", errors %" PRIu32 ", timeouts %" PRIu32 ", payload records skipped %" PRIu32 "\n",
+           report.commands, report.completed, report.errors, report.timeouts, report.payloadRecords);
+    printf("slowest: %s, %.3f ms\n", report.slowestCommand, report.maxLatencyMicros / 1000.0);
+    printf("host cycles: %" PRIu64 ", %.2f per RX byte\n", report.hostCycles,
+           (report.rxBytes > 0) ? (double) report.hostCycles / report.rxBytes : 0.0);
+    for (ConnectionID id = CONNECTION_ID_0; id < ESP8266_CONNECTION_COUNT; id++) {
+        uint32_t available = availableDataByIdESP8266(wifi, id);
+        if (available > 0) {
+            printf("connection %d: %" PRIu32 " bytes received\n", id, available);
+        }
+    }
+    deleteESP8266(wifi);
+    return (report.completed == report.commands) ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <string.h>
+#include "HostPlatform.h"
+#include "TraceReplay.h"
+
+#define DUMP_HEADER_LENGTH      9       // "ESPT", version, u32 cycles per second
+#define RECORD_HEADER_LENGTH    7       // u32 timestamp, u8 direction, u16 length, little endian
+#define DUMP_FORMAT_VERSION     1
+
+typedef struct ReplayState {
+    TraceReplayReport *report;
+    uint64_t startMicros[ESP8266_COMMAND_QUEUE_SIZE];   // by queue slot, commands complete in order
+    char commands[ESP8266_COMMAND_QUEUE_SIZE][ESP8266_COMMAND_MAX_LENGTH];
+    uint32_t sent;
+} ReplayState;
+
+static uint32_t readLittleEndian(const uint8_t *data, uint8_t length);
+static void replayCommand(WiFi *wifi, ReplayState *state, const char *data, uint32_t length);
+static void onReplayedCommand(WiFi *wifi, ResponseStatus status, void *context);
+static void runUntil(WiFi *wifi, uint64_t micros);
+static inline bool isCommandRecord(const char *data, uint32_t length);
+
+
+bool replayTraceHost(WiFi *wifi, const char *dump, uint32_t length, TraceReplayReport *report) {
+    const uint8_t *data = (const uint8_t *) dump;
+    memset(report, 0, sizeof(struct TraceReplayReport));
+    if (length < DUMP_HEADER_LENGTH || memcmp(data, "ESPT", 4) != 0 || data[4] != DUMP_FORMAT_VERSION) return false;
+    report->cyclesPerSecond = readLittleEndian(&data[5], 4);
+    if (report->cyclesPerSecond == 0) return false;
+
+    ReplayState state = {.report = report};
+    uint64_t startCycles = readCycleCounterHost();
+    uint64_t startMicros = getMicrosHost();
+    uint32_t firstTimestamp = 0;
+    uint32_t position = DUMP_HEADER_LENGTH;
+    while (position + RECORD_HEADER_LENGTH <= length) {
+        uint32_t timestamp = readLittleEndian(&data[position], 4);
+        uint8_t direction = data[position + 4];
+        uint32_t recordLength = readLittleEndian(&data[position + 5], 2);
+        position += RECORD_HEADER_LENGTH;
+        if (position + recordLength > length) break;   // truncated dump
+
+        if (report->records == 0) {
+            firstTimestamp = timestamp;
+        }
+        report->captureMicros = (uint64_t) (uint32_t) (timestamp - firstTimestamp) * 1000000 / report->cyclesPerSecond;
+        runUntil(wifi, startMicros + report->captureMicros);    // driver runs between records as it did during capture
+
+        const char *recordData = &dump[position];
+        if (direction == ESP8266_TRACE_RX) {
+            queueReceiveHost(wifi->USARTDma->USARTx, 0, recordData, recordLength);
+            report->rxRecords++;
+            report->rxBytes += recordLength;
+        } else if (isCommandRecord(recordData, recordLength)) {
+            replayCommand(wifi, &state, recordData, recordLength - 2);
+        } else {
+            report->payloadRecords++;
+        }
+        report->records++;
+        position += recordLength;
+    }
+
+    uint64_t flushEndMicros = getMicrosHost() + TRACE_REPLAY_FLUSH_MS * 1000ULL;
+    while (report->completed < report->commands && getMicrosHost() < flushEndMicros) {
+        pollTimeHost();
+        pollESP8266(wifi);
+    }
+    runUntil(wifi, getMicrosHost() + 1000);     // let unsolicited data after last command reach receive queues
+    report->hostCycles = readCycleCounterHost() - startCycles;
+    return true;
+}
+
+static uint32_t readLittleEndian(const uint8_t *data, uint8_t length) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        value |= (uint32_t) data[i] << (8 * i);
+    }
+    return value;
+}
+
+static void replayCommand(WiFi *wifi, ReplayState *state, const char *data, uint32_t length) {
+    while (wifi->commandQueue.size == ESP8266_COMMAND_QUEUE_SIZE) {    // capture had commands waiting for each other
+        pollTimeHost();
+        pollESP8266(wifi);
+    }
+
+    uint32_t slot = state->sent % ESP8266_COMMAND_QUEUE_SIZE;
+    uint32_t commandLength = (length < ESP8266_COMMAND_MAX_LENGTH - 2) ? length : ESP8266_COMMAND_MAX_LENGTH - 3;
+    memcpy(state->commands[slot], data, commandLength);
+    state->commands[slot][commandLength] = '\0';
+    state->startMicros[slot] = getMicrosHost();
+    if (enqueueCommandESP8266(wifi, onReplayedCommand, state, state->commands[slot])) {
+        state->sent++;
+        state->report->commands++;
+    }
+}
+
+static void onReplayedCommand(WiFi *wifi, ResponseStatus status, void *context) {
+    (void) wifi;
+    ReplayState *state = context;
+    TraceReplayReport *report = state->report;
+    uint32_t slot = report->completed % ESP8266_COMMAND_QUEUE_SIZE;
+    uint32_t latencyMicros = (uint32_t) (getMicrosHost() - state->startMicros[slot]);
+    if (latencyMicros > report->maxLatencyMicros) {
+        report->maxLatencyMicros = latencyMicros;
+        strcpy(report->slowestCommand, state->commands[slot]);
+    }
+    report->errors += isResponseStatusError(status);
+    report->timeouts += isResponseStatusTimeout(status);
+    report->completed++;
+}
+
+static void runUntil(WiFi *wifi, uint64_t micros) {
+    while (getMicrosHost() < micros) {
+        pollTimeHost();
+        pollESP8266(wifi);
+    }
+}
+
+static inline bool isCommandRecord(const char *data, uint32_t length) {
+    return length >= 4 && data[0] == 'A' && data[1] == 'T' && data[length - 2] == '\r' && data[length - 1] == '\n';
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ESP8266WiFi.h"
+
+// Replays dump of dumpTraceESP8266() into simulated link. Captured commands are sent again through command queue,
+// captured RX chunks are received on USART at their original time offsets, so parser and latency behaviour is reproduced
+// without module. Payload written after ">" prompt is not sent again.
+
+#define TRACE_REPLAY_FLUSH_MS   5000    // wait for completion of last commands
+
+typedef struct TraceReplayReport {
+    uint32_t cyclesPerSecond;   // timestamp resolution of capture
+    uint32_t records;
+    uint32_t rxRecords;
+    uint32_t rxBytes;
+    uint32_t commands;          // TX records replayed as commands
+    uint32_t payloadRecords;    // TX records with data after ">" prompt, skipped
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint32_t maxLatencyMicros;  // longest command to completion time, latency spike candidate
+    char slowestCommand[ESP8266_COMMAND_MAX_LENGTH];
+    uint64_t captureMicros;     // first to last record
+    uint64_t hostCycles;        // host CPU time of driver and link model during replay
+} TraceReplayReport;
+
+bool replayTraceHost(WiFi *wifi, const char *dump, uint32_t length, TraceReplayReport *report);  // false when dump header is invalid
@@ -0,0 +1,484 @@
+#include "ESP8266Simulator.h"
+
+#include <stdarg.h>
+
+#define OK_RESPONSE     "\r\nOK\r\n"
+#define ERROR_RESPONSE  "\r\nERROR\r\n"
+
+typedef struct SimulatorArguments {
+    char values[SIMULATOR_ARGUMENT_COUNT][SIMULATOR_LINE_LENGTH];
+    uint8_t count;
+} SimulatorArguments;
+
+static void onSimulatorTransmit(const char *data, uint32_t length, void *context);
+static void handleCommand(ESP8266Simulator *simulator, const char *command);
+static bool runScript(ESP8266Simulator *simulator, const char *command);
+static void parseArguments(const char *text, SimulatorArguments *arguments);
+static void handleRestart(ESP8266Simulator *simulator);
+static void handleScan(ESP8266Simulator *simulator);
+static void handleJoin(ESP8266Simulator *simulator, const SimulatorArguments *arguments);
+static void handleJoinQuery(ESP8266Simulator *simulator);
+static void handleStatus(ESP8266Simulator *simulator);
+static void handleSocketStart(ESP8266Simulator *simulator, const SimulatorArguments *arguments);
+static void handleSocketSend(ESP8266Simulator *simulator, const SimulatorArguments *arguments);
+static void handleSocketClose(ESP8266Simulator *simulator, const SimulatorArguments *arguments);
+static void handlePing(ESP8266Simulator *simulator);
+static void completeSend(ESP8266Simulator *simulator);
+static void appendPayload(ESP8266Simulator *simulator, const char *data, uint32_t length);
+static void appendEscapedSsid(char *buffer, uint32_t capacity, const char *ssid);
+static void respond(ESP8266Simulator *simulator, uint32_t delayMicros, const char *data, uint32_t length);
+static void respondText(ESP8266Simulator *simulator, uint32_t delayMicros, const char *text);
+static void respondFormatted(ESP8266Simulator *simulator, uint32_t delayMicros, const char *format, ...);
+
+
+void initSimulator(ESP8266Simulator *simulator, USART_TypeDef *USARTx) {
+    memset(simulator, 0, sizeof(struct ESP8266Simulator));
+    simulator->USARTx = USARTx;
+    simulator->latencyMicros = SIMULATOR_DEFAULT_LATENCY_US;
+    simulator->chunkGapMicros = 200;
+    simulator->joinMicros = 50000;
+    simulator->connectMicros = 20000;
+    simulator->pingMillis = 12;
+    simulator->isEchoEnabled = true;
+    simulator->joinedAccessPoint = -1;
+    setTransmitSinkHost(USARTx, onSimulatorTransmit, simulator);
+}
+
+void deleteSimulator(ESP8266Simulator *simulator) {
+    setTransmitSinkHost(simulator->USARTx, NULL, NULL);
+    free(simulator->payload);
+    simulator->payload = NULL;
+}
+
+void addSimulatorAccessPoint(ESP8266Simulator *simulator, const SimulatorAccessPoint *accessPoint) {
+    if (simulator->accessPointCount < SIMULATOR_ACCESS_POINT_COUNT) {
+        simulator->accessPoints[simulator->accessPointCount++] = *accessPoint;
+    }
+}
+
+void scriptSimulatorResponse(ESP8266Simulator *simulator, const char *commandPrefix, const char *response, uint16_t count) {
+    if (simulator->scriptCount < SIMULATOR_SCRIPT_COUNT) {
+        simulator->scripts[simulator->scriptCount++] = (SimulatorScript) {commandPrefix, response, count};
+    }
+}
+
+void sendSimulatorText(ESP8266Simulator *simulator, const char *text) {
+    respondText(simulator, 0, text);
+}
+
+void sendSimulatorData(ESP8266Simulator *simulator, uint8_t id, const char *data, uint32_t length) {
+    char header[32];
+    int headerLength = simulator->isMultipleConnections
+            ? snprintf(header, sizeof(header), "\r\n+IPD,%u,%u:", id, length)
+            : snprintf(header, sizeof(header), "\r\n+IPD,%u:", length);
+    char *frame = malloc(headerLength + length);
+    if (frame == NULL) abort();
+    memcpy(frame, header, headerLength);
+    memcpy(&frame[headerLength], data, length);
+    respond(simulator, 0, frame, headerLength + length);
+    free(frame);
+}
+
+void acceptSimulatorClient(ESP8266Simulator *simulator, uint8_t id) {
+    simulator->openSockets |= (1U << id);
+    respondFormatted(simulator, 0, "%u,CONNECT\r\n", id);
+}
+
+void closeSimulatorSocket(ESP8266Simulator *simulator, uint8_t id) {
+    simulator->openSockets &= ~(1U << id);
+    if (simulator->isMultipleConnections) {
+        respondFormatted(simulator, 0, "%u,CLOSED\r\n", id);
+    } else {
+        respondText(simulator, 0, "CLOSED\r\n");
+    }
+}
+
+void dropSimulatorAccessPoint(ESP8266Simulator *simulator) {
+    simulator->joinedAccessPoint = -1;
+    simulator->openSockets = 0;
+    respondText(simulator, 0, "WIFI DISCONNECT\r\n");
+}
+
+void clearSimulatorPayload(ESP8266Simulator *simulator) {
+    simulator->payloadLength = 0;
+    simulator->payloadStart = 0;
+}
+
+static void onSimulatorTransmit(const char *data, uint32_t length, void *context) {
+    ESP8266Simulator *simulator = context;
+    if (simulator->isPassthrough) {
+        if (length == 3 && memcmp(data, "+++", 3) == 0) {    // exit sequence is recognized only as separate packet
+            simulator->isPassthrough = false;
+        } else {
+            appendPayload(simulator, data, length);
+        }
+        return;
+    }
+
+    uint32_t position = 0;
+    while (position < length) {
+        if (simulator->payloadRemaining > 0) {
+            uint32_t chunkLength = length - position;
+            if (chunkLength > simulator->payloadRemaining) {
+                chunkLength = simulator->payloadRemaining;
+            }
+            appendPayload(simulator, &data[position], chunkLength);
+            position += chunkLength;
+            simulator->payloadRemaining -= chunkLength;
+            if (simulator->payloadRemaining == 0) {
+                completeSend(simulator);
+            }
+            continue;
+        }
+
+        char symbol = data[position++];
+        if (simulator->lineLength < SIMULATOR_LINE_LENGTH - 1) {
+            simulator->line[simulator->lineLength++] = symbol;
+        }
+        if (symbol == '\n' && simulator->lineLength >= 2 && simulator->line[simulator->lineLength - 2] == '\r') {
+            simulator->line[simulator->lineLength - 2] = '\0';
+            simulator->lineLength = 0;
+            handleCommand(simulator, simulator->line);
+        }
+    }
+}
+
+static void handleCommand(ESP8266Simulator *simulator, const char *command) {
+    simulator->commandCount++;
+    strcpy(simulator->lastCommand, command);
+    if (simulator->isEchoEnabled) {
+        respondFormatted(simulator, 0, "%s\r\r\n", command);
+    }
+    if (runScript(simulator, command)) return;
+
+    char name[SIMULATOR_LINE_LENGTH];
+    uint32_t nameLength = strcspn(command, "=");
+    memcpy(name, command, nameLength);
+    name[nameLength] = '\0';
+    SimulatorArguments arguments;
+    parseArguments((command[nameLength] == '=') ? &command[nameLength + 1] : "", &arguments);
+
+    static const char *const OK_COMMANDS[] = {
+            "AT", "AT+CWMODE", "AT+SLEEP", "AT+GSLP", "AT+CIPSTO", "AT+CIPSSLSIZE",
+            "AT+CIPAP", "AT+CWSAP_CUR", "AT+CWSAP_DEF", "AT+CIPDINFO", "AT+WAKEUPGPIO"
+    };
+    for (uint8_t i = 0; i < sizeof(OK_COMMANDS) / sizeof(OK_COMMANDS[0]); i++) {
+        if (strcmp(name, OK_COMMANDS[i]) == 0) {
+            respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+            return;
+        }
+    }
+
+    if (strcmp(name, "ATE0") == 0 || strcmp(name, "ATE1") == 0) {
+        simulator->isEchoEnabled = name[3] == '1';
+        respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+    } else if (strcmp(name, "AT+RST") == 0 || strcmp(name, "AT+RESTORE") == 0) {
+        handleRestart(simulator);
+    } else if (strcmp(name, "AT+CIPMUX") == 0) {
+        simulator->isMultipleConnections = strcmp(arguments.values[0], "1") == 0;
+        respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+    } else if (strcmp(name, "AT+CIPMODE") == 0) {
+        simulator->isTransparentMode = strcmp(arguments.values[0], "1") == 0;
+        respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+    } else if (strcmp(name, "AT+CWLAPOPT") == 0) {
+        simulator->isScanSorted = strcmp(arguments.values[0], "1") == 0;
+        respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+    } else if (strcmp(name, "AT+CWLAP") == 0) {
+        handleScan(simulator);
+    } else if (strcmp(name, "AT+CWJAP_CUR") == 0 || strcmp(name, "AT+CWJAP_DEF") == 0) {
+        handleJoin(simulator, &arguments);
+    } else if (strcmp(name, "AT+CWJAP_CUR?") == 0) {
+        handleJoinQuery(simulator);
+    } else if (strcmp(name, "AT+CWQAP") == 0) {
+        bool isJoined = simulator->joinedAccessPoint >= 0;
+        simulator->joinedAccessPoint = -1;
+        simulator->openSockets = 0;
+        respondText(simulator, simulator->latencyMicros, isJoined ? "WIFI DISCONNECT\r\n\r\nOK\r\n" : OK_RESPONSE);
+    } else if (strcmp(name, "AT+CIPSTATUS") == 0) {
+        handleStatus(simulator);
+    } else if (strcmp(name, "AT+CIPSTART") == 0) {
+        handleSocketStart(simulator, &arguments);
+    } else if (strcmp(name, "AT+CIPSEND") == 0) {
+        handleSocketSend(simulator, &arguments);
+    } else if (strcmp(name, "AT+CIPCLOSE") == 0) {
+        handleSocketClose(simulator, &arguments);
+    } else if (strcmp(name, "AT+CIPSERVER") == 0) {
+        if (!simulator->isMultipleConnections) {
+            respondText(simulator, simulator->latencyMicros, ERROR_RESPONSE);
+            return;
+        }
+        simulator->isServerListening = strcmp(arguments.values[0], "1") == 0;
+        respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+    } else if (strcmp(name, "AT+CIFSR") == 0) {
+        respondText(simulator, simulator->latencyMicros,
+                    "+CIFSR:APIP,\"192.168.4.1\"\r\n+CIFSR:APMAC,\"1a:fe:34:a1:b2:c3\"\r\n"
+                    "+CIFSR:STAIP,\"192.168.1.20\"\r\n+CIFSR:STAMAC,\"18:fe:34:a1:b2:c3\"\r\n\r\nOK\r\n");
+    } else if (strcmp(name, "AT+CWLIF") == 0) {
+        respondFormatted(simulator, simulator->latencyMicros, "%s\r\nOK\r\n", (simulator->softApClients != NULL) ? simulator->softApClients : "");
+    } else if (strcmp(name, "AT+CWSAP?") == 0) {
+        respondText(simulator, simulator->latencyMicros, "+CWSAP:\"ESP8266\",\"\",1,0,4,0\r\n\r\nOK\r\n");
+    } else if (strcmp(name, "AT+PING") == 0) {
+        handlePing(simulator);
+    } else {
+        respondText(simulator, simulator->latencyMicros, ERROR_RESPONSE);
+    }
+}
+
+static bool runScript(ESP8266Simulator *simulator, const char *command) {
+    for (uint8_t i = 0; i < simulator->scriptCount; i++) {
+        SimulatorScript *script = &simulator->scripts[i];
+        if (script->remainingCount > 0 && strncmp(command, script->commandPrefix, strlen(script->commandPrefix)) == 0) {
+            script->remainingCount--;
+            if (script->response != NULL) {
+                respondText(simulator, simulator->latencyMicros, script->response);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void parseArguments(const char *text, SimulatorArguments *arguments) {   // quoted values are unescaped
+    memset(arguments, 0, sizeof(struct SimulatorArguments));
+    while (*text != '\0' && arguments->count < SIMULATOR_ARGUMENT_COUNT) {
+        char *value = arguments->values[arguments->count++];
+        uint32_t length = 0;
+        if (*text == '"') {
+            text++;
+            while (*text != '\0' && *text != '"') {
+                if (*text == '\\' && text[1] != '\0') {
+                    text++;
+                }
+                if (length < SIMULATOR_LINE_LENGTH - 1) {
+                    value[length++] = *text;
+                }
+                text++;
+            }
+            if (*text == '"') {
+                text++;
+            }
+        } else {
+            while (*text != '\0' && *text != ',') {
+                if (length < SIMULATOR_LINE_LENGTH - 1) {
+                    value[length++] = *text;
+                }
+                text++;
+            }
+        }
+        value[length] = '\0';
+        if (*text == ',') {
+            text++;
+        }
+    }
+}
+
+static void handleRestart(ESP8266Simulator *simulator) {
+    simulator->isEchoEnabled = true;
+    simulator->isMultipleConnections = false;
+    simulator->isTransparentMode = false;
+    simulator->isServerListening = false;
+    simulator->isScanSorted = false;
+    simulator->joinedAccessPoint = -1;
+    simulator->openSockets = 0;
+    respondText(simulator, simulator->latencyMicros, OK_RESPONSE);
+    respondText(simulator, SIMULATOR_RESTART_US, "\r\n ets Jan  8 2013,rst cause:2, boot mode:(3,7)\r\n\r\nready\r\n");
+}
+
+static void handleScan(ESP8266Simulator *simulator) {
+    uint8_t order[SIMULATOR_ACCESS_POINT_COUNT];
+    for (uint8_t i = 0; i < simulator->accessPointCount; i++) {
+        order[i] = i;
+    }
+    if (simulator->isScanSorted) {  // strongest first
+        for (uint8_t i = 1; i < simulator->accessPointCount; i++) {
+            for (uint8_t j = i; j > 0 && simulator->accessPoints[order[j]].signalStrength > simulator->accessPoints[order[j - 1]].signalStrength; j--) {
+                uint8_t swap = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = swap;
+            }
+        }
+    }
+
+    char response[SIMULATOR_ACCESS_POINT_COUNT * 128 + 16] = {0};
+    for (uint8_t i = 0; i < simulator->accessPointCount; i++) {
+        const SimulatorAccessPoint *accessPoint = &simulator->accessPoints[order[i]];
+        char ssid[2 * 32 + 1];
+        appendEscapedSsid(ssid, sizeof(ssid), accessPoint->ssid);
+        uint32_t length = strlen(response);
+        snprintf(&response[length], sizeof(response) - length, "+CWLAP:(%u,\"%s\",%d,\"%s\",%u)\r\n",
+                 accessPoint->encryption, ssid, accessPoint->signalStrength, accessPoint->bssid, accessPoint->channel);
+    }
+    strcat(response, OK_RESPONSE);
+    respondText(simulator, simulator->latencyMicros + 100000, response);
+}
+
+static void handleJoin(ESP8266Simulator *simulator, const SimulatorArguments *arguments) {
+    const char *ssid = arguments->values[0];
+    const char *password = arguments->values[1];
+    const char *bssid = (arguments->count > 2) ? arguments->values[2] : NULL;
+    uint32_t delayMicros = simulator->latencyMicros + simulator->joinMicros;
+
+    bool isSsidFound = false;
+    for (uint8_t i = 0; i < simulator->accessPointCount; i++) {
+        const SimulatorAccessPoint *accessPoint = &simulator->accessPoints[i];
+        if (strcmp(accessPoint->ssid, ssid) != 0 || (bssid != NULL && strcmp(accessPoint->bssid, bssid) != 0)) continue;
+        isSsidFound = true;
+        if (strcmp(accessPoint->password, password) == 0) {
+            simulator->joinedAccessPoint = i;
+            respondText(simulator, delayMicros, "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+            return;
+        }
+    }
+    simulator->joinedAccessPoint = -1;
+    respondText(simulator, delayMicros, isSsidFound ? "+CWJAP:2\r\n\r\nFAIL\r\n" : "+CWJAP:3\r\n\r\nFAIL\r\n");
+}
+
+static void handleJoinQuery(ESP8266Simulator *simulator) {
+    if (simulator->joinedAccessPoint < 0) {
+        respondText(simulator, simulator->latencyMicros, "No AP\r\n\r\nOK\r\n");
+        return;
+    }
+    const SimulatorAccessPoint *accessPoint = &simulator->accessPoints[simulator->joinedAccessPoint];
+    respondFormatted(simulator, simulator->latencyMicros, "+CWJAP_CUR:\"%s\",\"%s\",%u,%d\r\n\r\nOK\r\n",
+                     accessPoint->ssid, accessPoint->bssid, accessPoint->channel, accessPoint->signalStrength);
+}
+
+static void handleStatus(ESP8266Simulator *simulator) {
+    uint8_t status = 5;
+    if (simulator->joinedAccessPoint >= 0) {
+        status = (simulator->openSockets != 0) ? 3 : 2;
+    }
+    respondFormatted(simulator, simulator->latencyMicros, "STATUS:%u\r\n\r\nOK\r\n", status);
+}
+
+static void handleSocketStart(ESP8266Simulator *simulator, const SimulatorArguments *arguments) {
+    uint8_t id = simulator->isMultipleConnections ? atoi(arguments->values[0]) : 0;
+    if (simulator->joinedAccessPoint < 0) {
+        respondText(simulator, simulator->latencyMicros, "no ip\r\n\r\nERROR\r\n");
+    } else if (id >= SIMULATOR_CONNECTION_COUNT) {
+        respondText(simulator, simulator->latencyMicros, ERROR_RESPONSE);
+    } else if (simulator->openSockets & (1U << id)) {
+        respondText(simulator, simulator->latencyMicros, "ALREADY CONNECTED\r\n\r\nERROR\r\n");
+    } else {
+        const char *type = arguments->values[simulator->isMultipleConnections ? 1 : 0];
+        simulator->openSockets |= (1U << id);
+        simulator->udpSockets = (strcmp(type, "UDP") == 0) ? (simulator->udpSockets | (1U << id)) : (simulator->udpSockets & ~(1U << id));
+        simulator->sslSockets = (strcmp(type, "SSL") == 0) ? (simulator->sslSockets | (1U << id)) : (simulator->sslSockets & ~(1U << id));
+        uint32_t delayMicros = simulator->latencyMicros + simulator->connectMicros;
+        if (simulator->isMultipleConnections) {
+            respondFormatted(simulator, delayMicros, "%u,CONNECT\r\n\r\nOK\r\n", id);
+        } else {
+            respondText(simulator, delayMicros, "CONNECT\r\n\r\nOK\r\n");
+        }
+    }
+}
+
+static void handleSocketSend(ESP8266Simulator *simulator, const SimulatorArguments *arguments) {
+    if (arguments->count == 0) {
+        if (simulator->isTransparentMode && !simulator->isMultipleConnections && (simulator->openSockets & 1U)) {
+            simulator->isPassthrough = true;
+            respondText(simulator, simulator->latencyMicros, "\r\nOK\r\n\r\n>");
+        } else {
+            respondText(simulator, simulator->latencyMicros, ERROR_RESPONSE);
+        }
+        return;
+    }
+
+    uint8_t id = simulator->isMultipleConnections ? atoi(arguments->values[0]) : 0;
+    uint32_t length = atoi(arguments->values[simulator->isMultipleConnections ? 1 : 0]);
+    if (id >= SIMULATOR_CONNECTION_COUNT || !(simulator->openSockets & (1U << id))) {
+        respondText(simulator, simulator->latencyMicros, "link is not valid\r\n\r\nERROR\r\n");
+    } else if (length == 0 || length > SIMULATOR_MAX_SEND_LENGTH) {
+        respondText(simulator, simulator->latencyMicros, ERROR_RESPONSE);
+    } else {
+        simulator->payloadId = id;
+        simulator->payloadRemaining = length;
+        simulator->payloadStart = simulator->payloadLength;
+        respondText(simulator, simulator->latencyMicros, "\r\nOK\r\n> ");
+    }
+}
+
+static void handleSocketClose(ESP8266Simulator *simulator, const SimulatorArguments *arguments) {
+    uint8_t id = (simulator->isMultipleConnections && arguments->count > 0) ? atoi(arguments->values[0]) : 0;
+    uint8_t mask = (id == SIMULATOR_CONNECTION_COUNT) ? 0x1F : (1U << id);    // id 5 closes all connections
+    if (!(simulator->openSockets & mask)) {
+        respondText(simulator, simulator->latencyMicros, "UNLINK\r\n\r\nERROR\r\n");
+        return;
+    }
+    simulator->openSockets &= ~mask;
+    if (simulator->isMultipleConnections && id < SIMULATOR_CONNECTION_COUNT) {
+        respondFormatted(simulator, simulator->latencyMicros, "%u,CLOSED\r\n\r\nOK\r\n", id);
+    } else {
+        respondText(simulator, simulator->latencyMicros, "CLOSED\r\n\r\nOK\r\n");
+    }
+}
+
+static void handlePing(ESP8266Simulator *simulator) {
+    if (simulator->pingMillis == 0) {
+        respondText(simulator, simulator->latencyMicros + 1000000, "+timeout\r\n\r\nERROR\r\n");
+    } else {
+        respondFormatted(simulator, simulator->latencyMicros + simulator->pingMillis * 1000, "+%u\r\n\r\nOK\r\n", simulator->pingMillis);
+    }
+}
+
+static void completeSend(ESP8266Simulator *simulator) {
+    uint32_t length = simulator->payloadLength - simulator->payloadStart;
+    uint32_t delayMicros = simulator->latencyMicros;
+    if (!(simulator->udpSockets & (1U << simulator->payloadId))) {     // datagram is reported sent without remote acknowledge
+        delayMicros += simulator->sendAckMicros;
+    }
+    if (simulator->sslSockets & (1U << simulator->payloadId)) {
+        delayMicros += simulator->sslRecordMicros;
+    }
+    simulator->sendCount++;
+    respondFormatted(simulator, delayMicros, "\r\nRecv %u bytes\r\n\r\nSEND OK\r\n", length);
+    if (simulator->isPayloadEchoed) {
+        sendSimulatorData(simulator, simulator->payloadId, &simulator->payload[simulator->payloadStart], length);
+    }
+}
+
+static void appendPayload(ESP8266Simulator *simulator, const char *data, uint32_t length) {
+    if (simulator->payloadLength + length > simulator->payloadCapacity) {
+        uint32_t capacity = (simulator->payloadCapacity > 0) ? simulator->payloadCapacity : 4096;
+        while (capacity < simulator->payloadLength + length) {
+            capacity *= 2;
+        }
+        simulator->payload = realloc(simulator->payload, capacity);
+        if (simulator->payload == NULL) abort();
+        simulator->payloadCapacity = capacity;
+    }
+    memcpy(&simulator->payload[simulator->payloadLength], data, length);
+    simulator->payloadLength += length;
+}
+
+static void appendEscapedSsid(char *buffer, uint32_t capacity, const char *ssid) {
+    uint32_t length = 0;
+    for (; *ssid != '\0' && length + 2 < capacity; ssid++) {
+        if (*ssid == '"' || *ssid == ',' || *ssid == '\\') {
+            buffer[length++] = '\\';
+        }
+        buffer[length++] = *ssid;
+    }
+    buffer[length] = '\0';
+}
+
+static void respond(ESP8266Simulator *simulator, uint32_t delayMicros, const char *data, uint32_t length) {
+    uint32_t chunkLength = (simulator->chunkLength > 0) ? simulator->chunkLength : length;
+    for (uint32_t position = 0; position < length; position += chunkLength) {
+        uint32_t burstLength = (length - position < chunkLength) ? length - position : chunkLength;
+        queueReceiveHost(simulator->USARTx, (position == 0) ? delayMicros : simulator->chunkGapMicros, &data[position], burstLength);
+    }
+}
+
+static void respondText(ESP8266Simulator *simulator, uint32_t delayMicros, const char *text) {
+    respond(simulator, delayMicros, text, strlen(text));
+}
+
+static void respondFormatted(ESP8266Simulator *simulator, uint32_t delayMicros, const char *format, ...) {
+    char text[SIMULATOR_LINE_LENGTH * 2];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    respondText(simulator, delayMicros, text);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "USART_DMA.h"
+#include "HostPlatform.h"
+
+// Scriptable ESP8266 AT 1.x module model on host UART. Commands are parsed from TX line,
+// responses are sent back after latency and can be split to bursts with idle line between them.
+
+#define SIMULATOR_ACCESS_POINT_COUNT    8
+#define SIMULATOR_SCRIPT_COUNT          16
+#define SIMULATOR_LINE_LENGTH           256
+#define SIMULATOR_ARGUMENT_COUNT        8
+#define SIMULATOR_CONNECTION_COUNT      5
+#define SIMULATOR_MAX_SEND_LENGTH       2048
+#define SIMULATOR_DEFAULT_LATENCY_US    500
+#define SIMULATOR_RESTART_US            200000
+
+typedef struct SimulatorAccessPoint {
+    const char *ssid;
+    const char *password;
+    char bssid[18];
+    int8_t signalStrength;
+    uint8_t channel;
+    uint8_t encryption;
+} SimulatorAccessPoint;
+
+typedef struct SimulatorScript {    // response override for commands starting with prefix
+    const char *commandPrefix;
+    const char *response;           // NULL - command is ignored, driver gets timeout
+    uint16_t remainingCount;
+} SimulatorScript;
+
+typedef struct ESP8266Simulator {
+    USART_TypeDef *USARTx;
+    uint32_t latencyMicros;         // command end to first response byte
+    uint32_t chunkLength;           // response burst length, 0 - whole response in one burst
+    uint32_t chunkGapMicros;        // idle line between bursts
+    uint32_t joinMicros;            // extra AT+CWJAP time
+    uint32_t connectMicros;         // extra AT+CIPSTART time
+    uint32_t sendAckMicros;         // extra AT+CIPSEND time, remote TCP acknowledge before "SEND OK", not on UDP
+    uint32_t sslRecordMicros;       // extra AT+CIPSEND time on SSL sockets, record encryption
+    uint32_t pingMillis;            // AT+PING round trip, 0 - "+timeout"
+    const char *softApClients;      // AT+CWLIF output lines
+    bool isEchoEnabled;
+    bool isMultipleConnections;
+    bool isTransparentMode;
+    bool isPassthrough;             // transparent data after AT+CIPSEND until "+++"
+    bool isPayloadEchoed;           // data sent with AT+CIPSEND comes back as +IPD frame
+    bool isServerListening;
+    bool isScanSorted;              // AT+CWLAPOPT received
+    int8_t joinedAccessPoint;       // -1 if not joined
+    uint8_t openSockets;            // bit per connection id
+    uint8_t udpSockets;
+    uint8_t sslSockets;
+    SimulatorAccessPoint accessPoints[SIMULATOR_ACCESS_POINT_COUNT];
+    uint8_t accessPointCount;
+    SimulatorScript scripts[SIMULATOR_SCRIPT_COUNT];
+    uint8_t scriptCount;
+    char line[SIMULATOR_LINE_LENGTH];
+    uint16_t lineLength;
+    uint32_t payloadRemaining;      // AT+CIPSEND data still expected
+    uint8_t payloadId;
+    uint32_t payloadStart;
+    char *payload;                  // all data received after ">" prompts and in passthrough
+    uint32_t payloadLength;
+    uint32_t payloadCapacity;
+    uint32_t commandCount;
+    uint32_t sendCount;             // completed AT+CIPSEND transfers
+    char lastCommand[SIMULATOR_LINE_LENGTH];
+} ESP8266Simulator;
+
+void initSimulator(ESP8266Simulator *simulator, USART_TypeDef *USARTx);
+void deleteSimulator(ESP8266Simulator *simulator);
+void addSimulatorAccessPoint(ESP8266Simulator *simulator, const SimulatorAccessPoint *accessPoint);
+void scriptSimulatorResponse(ESP8266Simulator *simulator, const char *commandPrefix, const char *response, uint16_t count);
+void sendSimulatorText(ESP8266Simulator *simulator, const char *text);  // unsolicited output
+void sendSimulatorData(ESP8266Simulator *simulator, uint8_t id, const char *data, uint32_t length);    // "+IPD" frame
+void acceptSimulatorClient(ESP8266Simulator *simulator, uint8_t id);   // "<id>,CONNECT"
+void closeSimulatorSocket(ESP8266Simulator *simulator, uint8_t id);    // remote close
+void dropSimulatorAccessPoint(ESP8266Simulator *simulator);            // "WIFI DISCONNECT", all sockets are closed
+void clearSimulatorPayload(ESP8266Simulator *simulator);